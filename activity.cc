@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "activity.h"
+#include "civil_day.h"
+
+namespace worklog {
+
+namespace {
+const char* const kWeekdays[] = {"Mon", "Tue", "Wed", "Thu",
+                                 "Fri", "Sat", "Sun"};
+const char* const kMonths[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                               "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// The heatmap characters from no logs to the busiest days.
+const char kLevels[] = ".-+*#";
+
+// Periods are numbered so the next one is the next number: the day number
+// of the Monday for weeks (in steps of 7), year * 12 + month - 1 for months
+// and the year for years.
+int64_t PeriodOf(int64_t day, RollupPeriod period) {
+  switch (period) {
+    case RollupPeriod::kDay:
+      return day;
+    case RollupPeriod::kWeek:
+      return day - Weekday(day);
+    case RollupPeriod::kMonth: {
+      CivilDate date = CivilFromDays(day);
+      return date.year * 12 + date.month - 1;
+    }
+    case RollupPeriod::kYear:
+      return CivilFromDays(day).year;
+  }
+  return day;
+}
+
+std::string PeriodLabel(int64_t key, RollupPeriod period) {
+  char label[32];
+  int size = 0;
+  switch (period) {
+    case RollupPeriod::kDay:
+      return FormatDay(key);
+    case RollupPeriod::kWeek: {
+      int64_t year = 0;
+      int week = 0;
+      IsoWeek(key, &year, &week);
+      size = std::snprintf(label, sizeof(label), "%04lld-W%02d",
+                           static_cast<long long>(year), week);
+      break;
+    }
+    case RollupPeriod::kMonth: {
+      // Floor division, for years before 0:
+      int64_t year = key >= 0 ? key / 12 : (key - 11) / 12;
+      size = std::snprintf(label, sizeof(label), "%04lld-%02d",
+                           static_cast<long long>(year),
+                           static_cast<int>(key - year * 12 + 1));
+      break;
+    }
+    case RollupPeriod::kYear:
+      size = std::snprintf(label, sizeof(label), "%lld",
+                           static_cast<long long>(key));
+      break;
+  }
+  return std::string(label, size);
+}
+}  // namespace
+
+atl::StatusOr<RollupPeriod> ParseRollupPeriod(const std::string& text) {
+  if (text == "day") {
+    return RollupPeriod::kDay;
+  } else if (text == "week") {
+    return RollupPeriod::kWeek;
+  } else if (text == "month") {
+    return RollupPeriod::kMonth;
+  } else if (text == "year") {
+    return RollupPeriod::kYear;
+  }
+  return atl::Status(atl::error::INVALID_ARGUMENT,
+                     "Unknown period: " + text +
+                         " (expected day, week, month or year)");
+}
+
+std::vector<RollupRow> ComputeRollup(const std::map<int64_t, uint64_t>& days,
+                                     RollupPeriod period, std::size_t window) {
+  std::vector<RollupRow> rows;
+  if (days.empty()) {
+    return rows;
+  }
+
+  const int64_t step = period == RollupPeriod::kWeek ? 7 : 1;
+  const int64_t first = PeriodOf(days.begin()->first, period);
+  const int64_t last = PeriodOf(days.rbegin()->first, period);
+  rows.resize((last - first) / step + 1);
+
+  // The days are sorted, so are their periods:
+  for (const auto& day : days) {
+    rows[(PeriodOf(day.first, period) - first) / step].count += day.second;
+  }
+
+  window = std::max<std::size_t>(window, 1);
+  uint64_t sum = 0;
+  for (std::size_t i = 0; i < rows.size(); i++) {
+    rows[i].period =
+        PeriodLabel(first + static_cast<int64_t>(i) * step, period);
+
+    sum += rows[i].count;
+    if (i >= window) {
+      sum -= rows[i - window].count;
+    }
+    rows[i].average = static_cast<double>(sum) / std::min(i + 1, window);
+  }
+
+  return rows;
+}
+
+std::string RenderHeatmap(const std::map<int64_t, uint64_t>& days,
+                          int64_t year) {
+  const int64_t first_day = DaysFromCivil(year, 1, 1);
+  const int64_t last_day = DaysFromCivil(year, 12, 31);
+
+  // The columns start on the Monday of the week of January 1st:
+  const int64_t start = first_day - Weekday(first_day);
+  const std::size_t num_weeks = (last_day - start) / 7 + 1;
+
+  uint64_t total = 0;
+  uint64_t busiest = 0;
+  std::size_t active_days = 0;
+  for (auto it = days.lower_bound(first_day);
+       it != days.end() && it->first <= last_day; ++it) {
+    total += it->second;
+    busiest = std::max(busiest, it->second);
+    active_days++;
+  }
+
+  // The months are named above the week of their 1st:
+  std::string months(num_weeks + 3, ' ');
+  for (int month = 1; month <= 12; month++) {
+    std::size_t week = (DaysFromCivil(year, month, 1) - start) / 7;
+    months.replace(week, 3, kMonths[month - 1]);
+  }
+  months.erase(months.find_last_not_of(' ') + 1);
+
+  std::ostringstream out;
+  out << "    " << months << "\n";
+  for (int weekday = 0; weekday < 7; weekday++) {
+    std::string line(num_weeks, ' ');
+    for (std::size_t week = 0; week < num_weeks; week++) {
+      int64_t day = start + static_cast<int64_t>(week) * 7 + weekday;
+      if (day < first_day || day > last_day) {
+        continue;
+      }
+
+      auto found = days.find(day);
+      uint64_t count = found == days.end() ? 0 : found->second;
+      // 1 to 4 in quarters of the busiest day, 0 without logs:
+      line[week] =
+          kLevels[count == 0 ? 0 : (4 * count + busiest - 1) / busiest];
+    }
+    line.erase(line.find_last_not_of(' ') + 1);
+    out << kWeekdays[weekday] << " " << line << "\n";
+  }
+
+  out << "\n"
+      << total << " log(s) on " << active_days << " day(s) in " << year
+      << ", at most " << busiest << " a day. Less " << kLevels << " More\n";
+  return out.str();
+}
+
+}  // namespace worklog
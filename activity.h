@@ -0,0 +1,47 @@
+#ifndef ACTIVITY_H_
+#define ACTIVITY_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "atl/status.h"
+#include "atl/statusor.h"
+
+namespace worklog {
+
+// The activity reports work on the logs per civil day number (see
+// civil_day.h) as maintained by the Aggregates, so they don't read any
+// logs. Days, weeks & months are derived from the day numbers with
+// arithmetic, not a time zone conversion per log.
+
+// The periods of a rollup. Weeks are ISO 8601 weeks.
+enum class RollupPeriod { kDay, kWeek, kMonth, kYear };
+
+// Parses 'day', 'week', 'month' or 'year'.
+atl::StatusOr<RollupPeriod> ParseRollupPeriod(const std::string& text);
+
+struct RollupRow {
+  std::string period;  // ie. "2017-06-24", "2017-W25", "2017-06" or "2017"
+  uint64_t count = 0;
+
+  // The moving average of the counts of the last periods up to this one.
+  double average = 0;
+};
+
+// The logs per period from the first to the last active one, including the
+// periods without logs. The moving average is over window periods, the
+// first periods average over the ones there are.
+std::vector<RollupRow> ComputeRollup(const std::map<int64_t, uint64_t>& days,
+                                     RollupPeriod period, std::size_t window);
+
+// Renders the days of the year as a calendar heatmap: a column per week
+// (Monday to Sunday), the months above and one character per day for how
+// many logs there were relative to the busiest day.
+std::string RenderHeatmap(const std::map<int64_t, uint64_t>& days,
+                          int64_t year);
+
+}  // namespace worklog
+
+#endif  // ACTIVITY_H_
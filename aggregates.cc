@@ -0,0 +1,441 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "atl/time.h"
+
+#include "aggregates.h"
+#include "civil_day.h"
+
+namespace worklog {
+
+namespace {
+// "WLAG"
+constexpr uint32_t kAggregatesMagic = 0x47414c57;
+
+// Lowers the count of the key, which goes away at 0.
+template <typename Key>
+void Decrement(std::map<Key, uint64_t>* counts, Key key) {
+  auto found = counts->find(key);
+  if (found != counts->end() && --found->second == 0) {
+    counts->erase(found);
+  }
+}
+
+// Counts which differ, by key.
+template <typename Key, typename Label>
+void DiffCounts(const std::map<Key, uint64_t>& actual,
+                const std::map<Key, uint64_t>& expected, const Label& label,
+                std::vector<std::string>* diffs) {
+  std::map<Key, std::pair<uint64_t, uint64_t>> counts;
+  for (const auto& entry : actual) {
+    counts[entry.first].first = entry.second;
+  }
+  for (const auto& entry : expected) {
+    counts[entry.first].second = entry.second;
+  }
+  for (const auto& entry : counts) {
+    if (entry.second.first != entry.second.second) {
+      diffs->push_back(label(entry.first) + ": " +
+                       std::to_string(entry.second.first) + " logs, expected " +
+                       std::to_string(entry.second.second));
+    }
+  }
+}
+
+void UseTag(uint64_t created_at, TagAggregate* tag) {
+  if (created_at > tag->last_used) {
+    tag->last_used = created_at;
+    tag->last_used_count = 1;
+  } else if (created_at == tag->last_used) {
+    tag->last_used_count++;
+  }
+}
+}  // namespace
+
+Aggregates::Aggregates(const Config& config)
+    : DerivedIndex(config.AggregatesPath(), kAggregatesMagic) {}
+
+uint32_t Aggregates::InternTag(const std::string& name) {
+  auto found = tag_lookup_.find(name);
+  if (found != tag_lookup_.end()) {
+    return found->second;
+  }
+
+  uint32_t tag = tag_names_.size();
+  tag_names_.push_back(name);
+  tag_lookup_.emplace(name, tag);
+  tags_.emplace_back();
+  return tag;
+}
+
+atl::Optional<uint32_t> Aggregates::FindTag(const std::string& name) const {
+  auto found = tag_lookup_.find(name);
+  if (found == tag_lookup_.end()) {
+    return {};
+  }
+  return found->second;
+}
+
+void Aggregates::LogTags(const Log& log) {
+  tag_ids_.clear();
+  for (const auto& name : log.tags) {
+    tag_ids_.push_back(InternTag(name));
+  }
+}
+
+void Aggregates::Add(const Log& log) {
+  if (!Validate(log).ok()) {
+    return;
+  }
+
+  // One time zone conversion for both:
+  const int64_t day = LocalDay(log.created_at);
+  num_logs_++;
+  years_[CivilFromDays(day).year]++;
+  days_[day]++;
+
+  LogTags(log);
+  pairs_.Add(tag_ids_.data(), tag_ids_.data() + tag_ids_.size());
+
+  for (uint32_t id : tag_ids_) {
+    TagAggregate& tag = tags_[id];
+    tag.count++;
+    if (!tag.stale) {
+      UseTag(log.created_at, &tag);
+    }
+  }
+}
+
+void Aggregates::Remove(const Log& log) {
+  if (!Validate(log).ok()) {
+    return;
+  }
+
+  const int64_t day = LocalDay(log.created_at);
+  num_logs_--;
+  Decrement(&years_, static_cast<int>(CivilFromDays(day).year));
+  Decrement(&days_, day);
+
+  LogTags(log);
+  pairs_.Add(tag_ids_.data(), tag_ids_.data() + tag_ids_.size(), -1);
+
+  for (uint32_t id : tag_ids_) {
+    TagAggregate& tag = tags_[id];
+    if (tag.count == 0) {
+      continue;
+    }
+
+    if (--tag.count == 0) {
+      tag = TagAggregate();
+    } else if (!tag.stale && log.created_at == tag.last_used &&
+               --tag.last_used_count == 0) {
+      tag.stale = true;
+    }
+  }
+}
+
+void Aggregates::OnPut(const Log* old_log, const Log& log) {
+  if (excluded_.count(log.id) > 0) {
+    return;
+  }
+
+  if (old_log != nullptr) {
+    Remove(*old_log);
+  }
+  Add(log);
+}
+
+void Aggregates::OnErase(const Log& old_log) {
+  if (excluded_.erase(old_log.id) > 0) {
+    return;
+  }
+
+  Remove(old_log);
+}
+
+bool Aggregates::Sync(const Index& index) {
+  bool changed = false;
+
+  for (const auto& deleted : index.tombstones().deleted()) {
+    int id = deleted.first;
+    if (excluded_.count(id) > 0) {
+      continue;
+    }
+
+    auto found = index.entries().find(id);
+    if (found != index.entries().end()) {
+      Remove(found->second.log);
+      excluded_.insert(id);
+      changed = true;
+    }
+  }
+
+  for (auto it = excluded_.begin(); it != excluded_.end();) {
+    if (index.IsDeleted(*it)) {
+      ++it;
+      continue;
+    }
+
+    auto found = index.entries().find(*it);
+    if (found != index.entries().end()) {
+      Add(found->second.log);
+    }
+    it = excluded_.erase(it);
+    changed = true;
+  }
+
+  bool has_stale = false;
+  std::vector<bool> stale(tags_.size(), false);
+  for (std::size_t id = 0; id < tags_.size(); id++) {
+    if (tags_[id].stale) {
+      tags_[id] = {tags_[id].count, 0, 0, false};
+      stale[id] = true;
+      has_stale = true;
+    }
+  }
+
+  if (!has_stale) {
+    return changed;
+  }
+
+  // Only the newest logs of the stale tags are looked for:
+  for (const auto& entry : index.entries()) {
+    const Log& log = entry.second.log;
+    if (excluded_.count(log.id) > 0 || index.IsDeleted(log.id) ||
+        !Validate(log).ok()) {
+      continue;
+    }
+
+    for (const auto& name : log.tags) {
+      atl::Optional<uint32_t> id = FindTag(name);
+      if (id && stale[*id]) {
+        UseTag(log.created_at, &tags_[*id]);
+      }
+    }
+  }
+
+  return true;
+}
+
+std::vector<std::string> Aggregates::Diff(const Aggregates& expected) const {
+  std::vector<std::string> diffs;
+
+  if (num_logs_ != expected.num_logs_) {
+    diffs.push_back("logs: " + std::to_string(num_logs_) + ", expected " +
+                    std::to_string(expected.num_logs_));
+  }
+
+  DiffCounts(years_, expected.years_,
+             [](int year) { return "year " + std::to_string(year); }, &diffs);
+  DiffCounts(days_, expected.days_,
+             [](int64_t day) { return "day " + FormatDay(day); }, &diffs);
+
+  // Both are compared by name, the ids of the two differ:
+  std::map<std::string, std::pair<TagAggregate, TagAggregate>> tags;
+  for (uint32_t id = 0; id < num_tags(); id++) {
+    tags[tag_names_[id]].first = tags_[id];
+  }
+  for (uint32_t id = 0; id < expected.num_tags(); id++) {
+    tags[expected.tag_names_[id]].second = expected.tags_[id];
+  }
+  for (const auto& tag : tags) {
+    const TagAggregate& actual = tag.second.first;
+    const TagAggregate& wanted = tag.second.second;
+    if (actual.count != wanted.count) {
+      diffs.push_back("tag " + tag.first + ": " +
+                      std::to_string(actual.count) + " logs, expected " +
+                      std::to_string(wanted.count));
+    } else if (actual.last_used != wanted.last_used) {
+      diffs.push_back("tag " + tag.first + ": last used " +
+                      atl::FormatTime(actual.last_used) + ", expected " +
+                      atl::FormatTime(wanted.last_used));
+    }
+  }
+
+  return diffs;
+}
+
+std::vector<std::string> Aggregates::Diff(
+    const ColumnIndex& columns, const CooccurrenceMatrix& expected) const {
+  using Pair = std::pair<std::string, std::string>;
+  std::map<Pair, std::pair<uint64_t, uint64_t>> pairs;
+
+  auto by_name = [](const std::string& a, const std::string& b) {
+    return a < b ? Pair(a, b) : Pair(b, a);
+  };
+  pairs_.ForEachPair([&](uint32_t a, uint32_t b, uint64_t count) {
+    pairs[by_name(tag_names_[a], tag_names_[b])].first = count;
+  });
+  expected.ForEachPair([&](uint32_t a, uint32_t b, uint64_t count) {
+    pairs[by_name(columns.tag_name(a), columns.tag_name(b))].second = count;
+  });
+
+  std::vector<std::string> diffs;
+  for (const auto& pair : pairs) {
+    if (pair.second.first != pair.second.second) {
+      diffs.push_back("tags " + pair.first.first + " & " + pair.first.second +
+                      ": " + std::to_string(pair.second.first) +
+                      " logs, expected " + std::to_string(pair.second.second));
+    }
+  }
+
+  return diffs;
+}
+
+void Aggregates::Clear() {
+  num_logs_ = 0;
+  years_.clear();
+  days_.clear();
+  excluded_.clear();
+  tag_names_.clear();
+  tag_lookup_.clear();
+  tags_.clear();
+  pairs_.Clear();
+}
+
+void Aggregates::Encode(std::string* out) const {
+  atl::PutVarint64(out, num_logs_);
+
+  atl::PutVarint64(out, years_.size());
+  for (const auto& year : years_) {
+    atl::PutVarint32(out, year.first);
+    atl::PutVarint64(out, year.second);
+  }
+
+  // Only the tags which are still used are written, renumbered:
+  std::vector<uint32_t> renumbered(tags_.size(), UINT32_MAX);
+  uint32_t num_used = 0;
+  for (uint32_t id = 0; id < tags_.size(); id++) {
+    if (tags_[id].count > 0) {
+      renumbered[id] = num_used++;
+    }
+  }
+
+  atl::PutVarint64(out, num_used);
+  for (uint32_t id = 0; id < tags_.size(); id++) {
+    const TagAggregate& tag = tags_[id];
+    if (tag.count == 0) {
+      continue;
+    }
+
+    atl::PutLengthPrefixed(out, tag_names_[id]);
+    atl::PutVarint64(out, tag.count);
+    atl::PutFixed64(out, tag.last_used);
+    atl::PutVarint64(out, tag.last_used_count);
+    atl::PutVarint32(out, tag.stale ? 1 : 0);
+  }
+
+  atl::PutVarint64(out, pairs_.size());
+  pairs_.ForEachPair([&](uint32_t a, uint32_t b, uint64_t count) {
+    atl::PutVarint32(out, renumbered[a]);
+    atl::PutVarint32(out, renumbered[b]);
+    atl::PutVarint64(out, count);
+  });
+
+  atl::PutVarint64(out, excluded_.size());
+  int prev_id = 0;
+  for (int id : excluded_) {
+    atl::PutVarint32(out, id - prev_id);
+    prev_id = id;
+  }
+
+  // The active days ascending, as deltas from the first one:
+  atl::PutVarint64(out, days_.size());
+  int64_t prev_day = days_.empty() ? 0 : days_.begin()->first;
+  atl::PutFixed64(out, static_cast<uint64_t>(prev_day));
+  for (const auto& day : days_) {
+    atl::PutVarint64(out, day.first - prev_day);
+    atl::PutVarint64(out, day.second);
+    prev_day = day.first;
+  }
+}
+
+bool Aggregates::Decode(atl::Decoder* in) {
+  uint64_t num_years = 0;
+  if (!in->GetVarint64(&num_logs_) || !in->GetVarint64(&num_years) ||
+      num_years > in->remaining()) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < num_years; i++) {
+    uint32_t year = 0;
+    uint64_t count = 0;
+    if (!in->GetVarint32(&year) || !in->GetVarint64(&count)) {
+      return false;
+    }
+    years_[static_cast<int>(year)] = count;
+  }
+
+  uint64_t num_tags = 0;
+  if (!in->GetVarint64(&num_tags) || num_tags > in->remaining()) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < num_tags; i++) {
+    atl::StringView name;
+    TagAggregate tag;
+    uint32_t stale = 0;
+    if (!in->GetLengthPrefixed(&name) || !in->GetVarint64(&tag.count) ||
+        !in->GetFixed64(&tag.last_used) ||
+        !in->GetVarint64(&tag.last_used_count) || !in->GetVarint32(&stale)) {
+      return false;
+    }
+    tag.stale = stale != 0;
+    tags_[InternTag(name.to_string())] = tag;
+  }
+
+  uint64_t num_pairs = 0;
+  if (!in->GetVarint64(&num_pairs) || num_pairs > in->remaining()) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < num_pairs; i++) {
+    uint32_t pair[2] = {0, 0};
+    uint64_t count = 0;
+    if (!in->GetVarint32(&pair[0]) || !in->GetVarint32(&pair[1]) ||
+        !in->GetVarint64(&count) || pair[0] >= num_tags ||
+        pair[1] >= num_tags || pair[0] == pair[1]) {
+      return false;
+    }
+    pairs_.Add(pair, pair + 2, count);
+  }
+
+  uint64_t num_excluded = 0;
+  if (!in->GetVarint64(&num_excluded) || num_excluded > in->remaining()) {
+    return false;
+  }
+
+  int id = 0;
+  for (uint64_t i = 0; i < num_excluded; i++) {
+    uint32_t delta = 0;
+    if (!in->GetVarint32(&delta)) {
+      return false;
+    }
+    id += delta;
+    excluded_.insert(excluded_.end(), id);
+  }
+
+  // Older files don't have the days, they are rebuilt:
+  uint64_t num_days = 0;
+  uint64_t first_day = 0;
+  if (!in->GetVarint64(&num_days) || num_days > in->remaining() ||
+      !in->GetFixed64(&first_day)) {
+    return false;
+  }
+
+  int64_t day = static_cast<int64_t>(first_day);
+  for (uint64_t i = 0; i < num_days; i++) {
+    uint64_t delta = 0;
+    uint64_t count = 0;
+    if (!in->GetVarint64(&delta) || !in->GetVarint64(&count)) {
+      return false;
+    }
+    day += delta;
+    days_.emplace_hint(days_.end(), day, count);
+  }
+
+  return true;
+}
+
+}  // namespace worklog
@@ -0,0 +1,108 @@
+#ifndef AGGREGATES_H_
+#define AGGREGATES_H_
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "atl/optional.h"
+
+#include "cooccurrence.h"
+#include "derived_index.h"
+#include "index.h"
+#include "worklog.h"
+
+namespace worklog {
+
+struct TagAggregate {
+  uint64_t count = 0;
+
+  // The created_at of the newest log with the tag and how many logs have
+  // it. If the last of them goes away the newest remaining one is unknown
+  // (stale) until the next Sync().
+  uint64_t last_used = 0;
+  uint64_t last_used_count = 0;
+  bool stale = false;
+};
+
+// Aggregates are materialised counts of the valid, not deleted logs: per
+// tag (with the date it was last used), per pair of tags (co-occurrence),
+// per year and per local day (a rollup for the activity reports). They
+// are updated by deltas as logs are put & erased, so reading them is
+// O(#tags) instead of a scan of all logs. The tags are interned, so the
+// pairs of a log are counted over ids.
+//
+// Deleting & undeleting a log only changes the tombstones, not the index,
+// so those deltas are applied by Sync(). The deleted logs which are not
+// counted are remembered for that.
+class Aggregates : public DerivedIndex {
+ public:
+  explicit Aggregates(const Config& config);
+
+  void OnPut(const Log* old_log, const Log& log) override;
+  void OnErase(const Log& old_log) override;
+
+  LogFields fields() const override { return kHeaderFields; }
+
+  // Excludes the logs deleted since the last call, adds the undeleted ones
+  // back and recomputes the stale last uses (a scan of the index, only if
+  // there are any). Returns true if anything changed.
+  bool Sync(const Index& index);
+
+  uint64_t num_logs() const { return num_logs_; }
+  const std::map<int, uint64_t>& years() const { return years_; }
+
+  // The logs per civil day number (see civil_day.h), only active days.
+  const std::map<int64_t, uint64_t>& days() const { return days_; }
+
+  // Tags which are no longer used keep their id with a count of 0.
+  std::size_t num_tags() const { return tag_names_.size(); }
+  const std::string& tag_name(uint32_t tag) const { return tag_names_[tag]; }
+  const TagAggregate& tag(uint32_t tag) const { return tags_[tag]; }
+  atl::Optional<uint32_t> FindTag(const std::string& name) const;
+
+  const CooccurrenceMatrix& cooccurrence() const { return pairs_; }
+
+  // Describes every difference to the expected aggregates (ie. freshly
+  // rebuilt ones), one line each. Empty if they match.
+  std::vector<std::string> Diff(const Aggregates& expected) const;
+
+  // Same for the co-occurrences counted from the columns (see
+  // ComputeCooccurrence).
+  std::vector<std::string> Diff(const ColumnIndex& columns,
+                                const CooccurrenceMatrix& expected) const;
+
+ protected:
+  void Clear() override;
+  void Encode(std::string* out) const override;
+  bool Decode(atl::Decoder* in) override;
+
+ private:
+  uint32_t InternTag(const std::string& name);
+
+  // Interns the tags of the log into tag_ids_.
+  void LogTags(const Log& log);
+
+  void Add(const Log& log);
+  void Remove(const Log& log);
+
+  uint64_t num_logs_ = 0;
+  std::map<int, uint64_t> years_;
+  std::map<int64_t, uint64_t> days_;
+  std::set<int> excluded_;
+
+  std::vector<std::string> tag_names_;
+  std::unordered_map<std::string, uint32_t> tag_lookup_;
+  std::vector<TagAggregate> tags_;
+  CooccurrenceMatrix pairs_;
+
+  // Scratch space for the tag ids of a log.
+  std::vector<uint32_t> tag_ids_;
+};
+
+}  // namespace worklog
+
+#endif  // AGGREGATES_H_
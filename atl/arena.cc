@@ -0,0 +1,57 @@
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "arena.h"
+
+namespace atl {
+
+constexpr std::size_t Arena::kDefaultBlockSize;
+
+void* Arena::Allocate(std::size_t size, std::size_t alignment) {
+  std::size_t padding =
+      (alignment - reinterpret_cast<std::uintptr_t>(ptr_) % alignment) %
+      alignment;
+
+  if (ptr_ == nullptr || size + padding > remaining_) {
+    if (size > block_size_ / 4) {
+      // The current block is kept for the following small allocations.
+      // Blocks come from new[], which is aligned for every fundamental type.
+      return AllocateBlock(size);
+    }
+
+    ptr_ = AllocateBlock(block_size_);
+    remaining_ = block_size_;
+    padding = 0;
+  }
+
+  char* result = ptr_ + padding;
+  ptr_ += padding + size;
+  remaining_ -= padding + size;
+  return result;
+}
+
+StringView Arena::Copy(StringView text) {
+  if (text.empty()) {
+    return StringView();
+  }
+
+  char* data = static_cast<char*>(Allocate(text.size(), 1));
+  std::memcpy(data, text.data(), text.size());
+  return StringView(data, text.size());
+}
+
+void Arena::Reset() {
+  blocks_.clear();
+  ptr_ = nullptr;
+  remaining_ = 0;
+  memory_usage_ = 0;
+}
+
+char* Arena::AllocateBlock(std::size_t size) {
+  blocks_.emplace_back(new char[size]);
+  memory_usage_ += size;
+  return blocks_.back().get();
+}
+
+}  // namespace atl
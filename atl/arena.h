@@ -0,0 +1,95 @@
+#ifndef ATL_ARENA_H_
+#define ATL_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "string_view.h"
+
+namespace atl {
+
+// Arena is a monotonic (bump pointer) allocator: memory is handed out from
+// large blocks and only released all at once, by Reset() or the destructor.
+// It suits data which is built and dropped together, like the entries of an
+// index loaded for a single command, and replaces a heap allocation per
+// object with one per block.
+//
+// Allocations larger than a quarter of the block size get a block of their
+// own, so a few large objects don't waste the rest of the current block.
+class Arena {
+ public:
+  static constexpr std::size_t kDefaultBlockSize = 64 * 1024;
+
+  explicit Arena(std::size_t block_size = kDefaultBlockSize)
+      : block_size_(block_size) {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* Allocate(std::size_t size,
+                 std::size_t alignment = alignof(std::max_align_t));
+
+  // Copies the text into the arena, the view stays valid until Reset().
+  StringView Copy(StringView text);
+
+  // Releases all memory, everything allocated before becomes invalid.
+  void Reset();
+
+  // The number of bytes of all blocks (including their unused rest).
+  std::size_t MemoryUsage() const { return memory_usage_; }
+  std::size_t num_blocks() const { return blocks_.size(); }
+
+ private:
+  char* AllocateBlock(std::size_t size);
+
+  std::size_t block_size_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* ptr_ = nullptr;
+  std::size_t remaining_ = 0;
+  std::size_t memory_usage_ = 0;
+};
+
+// ArenaAllocator makes standard containers allocate from an Arena, ie.
+//
+//   std::map<int, Log, std::less<int>,
+//            atl::ArenaAllocator<std::pair<const int, Log>>>
+//       logs(atl::ArenaAllocator<std::pair<const int, Log>>(&arena));
+//
+// deallocate() is a no-op, the memory of erased elements is only reclaimed
+// by Arena::Reset(). The arena has to outlive the container.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, std::size_t) {}
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return !(a == b);
+}
+
+}  // namespace atl
+
+#endif  // ATL_ARENA_H_
@@ -0,0 +1,130 @@
+#ifndef ATL_CODING_H_
+#define ATL_CODING_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "string_view.h"
+
+// Little endian fixed width & varint encoding helpers for the binary
+// index files (similar like leveldb's coding.h).
+
+namespace atl {
+
+inline void PutFixed32(std::string* dst, uint32_t value) {
+  char buf[4];
+  for (int i = 0; i < 4; i++) {
+    buf[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+  dst->append(buf, sizeof(buf));
+}
+
+inline void PutFixed64(std::string* dst, uint64_t value) {
+  char buf[8];
+  for (int i = 0; i < 8; i++) {
+    buf[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+  dst->append(buf, sizeof(buf));
+}
+
+inline void PutVarint64(std::string* dst, uint64_t value) {
+  while (value >= 0x80) {
+    dst->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  dst->push_back(static_cast<char>(value));
+}
+
+inline void PutVarint32(std::string* dst, uint32_t value) {
+  PutVarint64(dst, value);
+}
+
+inline void PutLengthPrefixed(std::string* dst, StringView value) {
+  PutVarint64(dst, value.size());
+  dst->append(value.data(), value.size());
+}
+
+// Decoder consumes an input buffer front to back. Every getter returns
+// false (and leaves the output untouched) when the input is truncated.
+class Decoder {
+ public:
+  explicit Decoder(StringView input) : input_(input) {}
+
+  bool empty() const { return input_.empty(); }
+  std::size_t remaining() const { return input_.size(); }
+
+  bool GetFixed32(uint32_t* value) {
+    if (input_.size() < 4) return false;
+    uint32_t result = 0;
+    for (int i = 0; i < 4; i++) {
+      result |= static_cast<uint32_t>(static_cast<unsigned char>(input_[i]))
+                << (8 * i);
+    }
+    input_.remove_prefix(4);
+    *value = result;
+    return true;
+  }
+
+  bool GetFixed64(uint64_t* value) {
+    if (input_.size() < 8) return false;
+    uint64_t result = 0;
+    for (int i = 0; i < 8; i++) {
+      result |= static_cast<uint64_t>(static_cast<unsigned char>(input_[i]))
+                << (8 * i);
+    }
+    input_.remove_prefix(8);
+    *value = result;
+    return true;
+  }
+
+  bool GetVarint64(uint64_t* value) {
+    uint64_t result = 0;
+    for (std::size_t i = 0; i < input_.size() && i < 10; i++) {
+      uint64_t byte = static_cast<unsigned char>(input_[i]);
+      result |= (byte & 0x7f) << (7 * i);
+      if ((byte & 0x80) == 0) {
+        input_.remove_prefix(i + 1);
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool GetVarint32(uint32_t* value) {
+    uint64_t result = 0;
+    if (!GetVarint64(&result) || result > UINT32_MAX) return false;
+    *value = static_cast<uint32_t>(result);
+    return true;
+  }
+
+  bool GetLengthPrefixed(StringView* value) {
+    uint64_t length = 0;
+    if (!GetVarint64(&length) || length > input_.size()) return false;
+    *value = input_.substr(0, length);
+    input_.remove_prefix(length);
+    return true;
+  }
+
+  // The next n bytes, without copying them.
+  bool GetBytes(std::size_t n, StringView* value) {
+    if (n > input_.size()) return false;
+    *value = input_.substr(0, n);
+    input_.remove_prefix(n);
+    return true;
+  }
+
+  bool Skip(std::size_t n) {
+    if (n > input_.size()) return false;
+    input_.remove_prefix(n);
+    return true;
+  }
+
+ private:
+  StringView input_;
+};
+
+}  // namespace atl
+
+#endif  // ATL_CODING_H_
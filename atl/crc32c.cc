@@ -0,0 +1,79 @@
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ATL_CRC32C_SSE42
+#include <nmmintrin.h>
+#endif
+
+#include "crc32c.h"
+
+namespace atl {
+
+namespace {
+constexpr uint32_t kPolynomial = 0x82f63b78;  // reversed Castagnoli
+
+struct Crc32cTable {
+  uint32_t values[256];
+
+  Crc32cTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+      }
+      values[i] = crc;
+    }
+  }
+};
+
+uint32_t ExtendPortable(uint32_t crc, const char* data, std::size_t n) {
+  static const Crc32cTable table;
+
+  auto* p = reinterpret_cast<const unsigned char*>(data);
+  crc = ~crc;
+  for (std::size_t i = 0; i < n; i++) {
+    crc = table.values[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+#ifdef ATL_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+uint32_t ExtendSse42(uint32_t crc, const char* data, std::size_t n) {
+  uint64_t crc64 = ~crc;
+
+  while (n >= 8) {
+    uint64_t chunk;
+    std::memcpy(&chunk, data, sizeof(chunk));
+    crc64 = _mm_crc32_u64(crc64, chunk);
+    data += 8;
+    n -= 8;
+  }
+
+  uint32_t crc32 = static_cast<uint32_t>(crc64);
+  while (n > 0) {
+    crc32 = _mm_crc32_u8(crc32, static_cast<unsigned char>(*data));
+    data++;
+    n--;
+  }
+
+  return ~crc32;
+}
+
+bool HasSse42() {
+  static const bool supported = __builtin_cpu_supports("sse4.2");
+  return supported;
+}
+#endif  // ATL_CRC32C_SSE42
+}  // namespace
+
+uint32_t Crc32cExtend(uint32_t crc, const char* data, std::size_t n) {
+#ifdef ATL_CRC32C_SSE42
+  if (HasSse42()) {
+    return ExtendSse42(crc, data, n);
+  }
+#endif
+  return ExtendPortable(crc, data, n);
+}
+
+}  // namespace atl
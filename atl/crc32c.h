@@ -0,0 +1,25 @@
+#ifndef ATL_CRC32C_H_
+#define ATL_CRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "string_view.h"
+
+namespace atl {
+
+// Returns the crc32c (Castagnoli) of data extended by crc. Uses the SSE4.2
+// crc32 instruction when the cpu supports it and a lookup table otherwise.
+uint32_t Crc32cExtend(uint32_t crc, const char* data, std::size_t n);
+
+inline uint32_t Crc32c(const char* data, std::size_t n) {
+  return Crc32cExtend(0, data, n);
+}
+
+inline uint32_t Crc32c(StringView data) {
+  return Crc32cExtend(0, data.data(), data.size());
+}
+
+}  // namespace atl
+
+#endif  // ATL_CRC32C_H_
@@ -0,0 +1,151 @@
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>  // DT_* constants
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <boost/filesystem.hpp>
+
+#include "dir.h"
+
+namespace atl {
+
+#ifdef __linux__
+namespace {
+
+// The kernel struct is not exported by glibc, see: man 2 getdents64
+struct LinuxDirent64 {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+// 1 MiB fits roughly 30k log entries per syscall.
+constexpr std::size_t kDirBufferSize = 1 << 20;
+
+EntryType TypeFromMode(mode_t mode) {
+  if (S_ISREG(mode)) return EntryType::kFile;
+  if (S_ISDIR(mode)) return EntryType::kDirectory;
+  return EntryType::kOther;
+}
+
+EntryType TypeFromDirent(int dir_fd, const LinuxDirent64* dirent) {
+  switch (dirent->d_type) {
+    case DT_REG:
+      return EntryType::kFile;
+    case DT_DIR:
+      return EntryType::kDirectory;
+    case DT_UNKNOWN:
+      break;
+    default:
+      return EntryType::kOther;
+  }
+
+  // Some file systems (ie. older xfs, reiserfs) don't fill d_type:
+  struct stat st;
+  if (fstatat(dir_fd, dirent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+    return EntryType::kUnknown;
+  }
+  return TypeFromMode(st.st_mode);
+}
+
+bool IsDotOrDotDot(const char* name) {
+  return name[0] == '.' &&
+         (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+}  // namespace
+
+bool ListDir(const std::string& path,
+             std::function<bool(const DirEntry&)> callback) {
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  std::vector<char> buffer(kDirBufferSize);
+  bool ok = true;
+
+  for (;;) {
+    long nread = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+    if (nread < 0) {
+      ok = false;
+      break;
+    }
+
+    if (nread == 0) {
+      break;
+    }
+
+    for (long pos = 0; pos < nread;) {
+      auto* dirent = reinterpret_cast<LinuxDirent64*>(buffer.data() + pos);
+      pos += dirent->d_reclen;
+
+      if (IsDotOrDotDot(dirent->d_name)) {
+        continue;
+      }
+
+      DirEntry entry;
+      entry.name = StringView(dirent->d_name);
+      entry.type = TypeFromDirent(fd, dirent);
+
+      if (!callback(entry)) {
+        close(fd);
+        return true;
+      }
+    }
+  }
+
+  close(fd);
+  return ok;
+}
+
+#else
+
+bool ListDir(const std::string& path,
+             std::function<bool(const DirEntry&)> callback) {
+  namespace fs = boost::filesystem;
+
+  boost::system::error_code ec;
+  fs::directory_iterator it(path, ec);
+  if (ec) {
+    return false;
+  }
+
+  for (fs::directory_iterator end; it != end; it.increment(ec)) {
+    if (ec) {
+      return false;
+    }
+
+    const std::string name = it->path().filename().string();
+
+    DirEntry entry;
+    entry.name = StringView(name);
+
+    fs::file_type type = it->symlink_status(ec).type();
+    if (type == fs::regular_file) {
+      entry.type = EntryType::kFile;
+    } else if (type == fs::directory_file) {
+      entry.type = EntryType::kDirectory;
+    } else {
+      entry.type = EntryType::kOther;
+    }
+
+    if (!callback(entry)) {
+      break;
+    }
+  }
+
+  return true;
+}
+
+#endif  // __linux__
+
+}  // namespace atl
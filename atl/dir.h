@@ -0,0 +1,32 @@
+#ifndef ATL_DIR_H_
+#define ATL_DIR_H_
+
+#include <functional>
+#include <string>
+
+#include "string_view.h"
+
+namespace atl {
+
+enum class EntryType { kUnknown, kFile, kDirectory, kOther };
+
+// DirEntry is only valid during the ListDir callback. The name points
+// into the read buffer and must be copied if it is needed afterwards.
+struct DirEntry {
+  StringView name;
+  EntryType type;
+};
+
+// Lists the entries of a single directory (non recursive) without '.' and
+// '..'. On linux the entries are read in large getdents64 batches and the
+// type comes from d_type, so no stat call is needed per entry (except on
+// file systems which report DT_UNKNOWN).
+//
+// Returns false if the directory could not be opened. Listing stops early
+// when the callback returns false.
+bool ListDir(const std::string& path,
+             std::function<bool(const DirEntry&)> callback);
+
+}  // namespace atl
+
+#endif  // ATL_DIR_H_
@@ -1,12 +1,21 @@
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Using boost filesystem because it will be soon in C++17 and then
 // it's possible to remove the boost dependency.
 #include <boost/filesystem.hpp>
 
+#include "dir.h"
 #include "optional.h"
 #include "file.h"
 
@@ -14,20 +23,53 @@
 
 namespace atl {
 
-void WalkDir(const std::string& path, std::function<bool(const std::string&)> callback) {
-  if (path.empty()) return;
+namespace {
+// Like boost's recursive_directory_iterator the walk stops at the first
+// directory which can't be listed:
+atl::Status WalkDirRecursive(
+    const std::string& path,
+    const std::function<bool(const std::string&)>& callback,
+    bool* keep_walking) {
+  std::vector<std::string> sub_dirs;
+
+  bool listed = ListDir(path, [&](const DirEntry& entry) -> bool {
+    std::string current_file = path + "/" + entry.name.to_string();
+    if (!callback(current_file)) {
+      *keep_walking = false;
+      return false;
+    }
+
+    if (entry.type == EntryType::kDirectory) {
+      sub_dirs.push_back(std::move(current_file));
+    }
+    return true;
+  });
+  if (!listed) {
+    return atl::Status(atl::error::INTERNAL,
+                       "Failed to list directory: " + path);
+  }
 
-  namespace fs = boost::filesystem;
-  fs::path dir_path(path);
-  fs::recursive_directory_iterator end;
+  for (const auto& sub_dir : sub_dirs) {
+    if (!*keep_walking) {
+      break;
+    }
 
-  for (fs::recursive_directory_iterator i(dir_path); i != end; ++i) {
-    const fs::path& current_file = *i;
-    if (!callback(current_file.string())) {
-      return;
+    atl::Status status = WalkDirRecursive(sub_dir, callback, keep_walking);
+    if (!status.ok()) {
+      return status;
     }
   }
-  return;
+
+  return atl::Status();
+}
+}  // namespace
+
+atl::Status WalkDir(const std::string& path,
+                    std::function<bool(const std::string&)> callback) {
+  if (path.empty()) return atl::Status();
+
+  bool keep_walking = true;
+  return WalkDirRecursive(path, callback, &keep_walking);
 }
 
 std::string TempName() {
@@ -82,6 +124,73 @@ bool FileWriteContent(const std::string& filename, const std::string& content) {
   return true;
 }
 
+bool FileWriteContentAtomic(const std::string& filename,
+                            const std::string& content) {
+  std::string tmp_filename =
+      filename + ".tmp." + std::to_string(static_cast<long>(getpid()));
+
+  int fd = open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0666);
+  if (fd < 0) {
+    return false;
+  }
+
+  // The data has to be on disk before the rename is, otherwise a crash
+  // could leave the new name with an empty or partial file:
+  std::size_t done = 0;
+  while (done < content.size()) {
+    ssize_t n = write(fd, content.data() + done, content.size() - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+
+  bool written = done == content.size() && fsync(fd) == 0;
+  if (close(fd) != 0 || !written) {
+    std::remove(tmp_filename.c_str());
+    return false;
+  }
+
+  if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    std::remove(tmp_filename.c_str());
+    return false;
+  }
+
+  // So is the rename itself, which is an update of the directory:
+  std::string::size_type slash = filename.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : filename.substr(0, slash);
+  int dir_fd = open(dir.empty() ? "/" : dir.c_str(), O_RDONLY | O_CLOEXEC);
+  if (dir_fd < 0) {
+    return false;
+  }
+  bool synced = fsync(dir_fd) == 0;
+  close(dir_fd);
+  return synced;
+}
+
+atl::Optional<FileStat> StatFile(const std::string& filename) {
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) {
+    return {};
+  }
+
+  FileStat file_stat;
+#ifdef __APPLE__
+  file_stat.mtime_ns = static_cast<uint64_t>(st.st_mtimespec.tv_sec) * 1000000000 +
+                       st.st_mtimespec.tv_nsec;
+#else
+  file_stat.mtime_ns = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                       st.st_mtim.tv_nsec;
+#endif
+  file_stat.size = static_cast<uint64_t>(st.st_size);
+
+  return file_stat;
+}
+
 atl::Optional<std::string> FileReadContent(const std::string& filename) {
   std::ifstream file(filename);
 
@@ -98,4 +207,68 @@ atl::Optional<std::string> FileReadContent(const std::string& filename) {
   return std::move(content);
 }
 
+atl::Optional<std::string> FileReadRange(const std::string& filename,
+                                         uint64_t offset, uint64_t size) {
+  int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return {};
+  }
+
+  std::string content(size, '\0');
+  uint64_t done = 0;
+  while (done < size) {
+    ssize_t n = pread(fd, &content[done], size - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+
+  close(fd);
+  if (done != size) {
+    return {};
+  }
+
+  return content;
+}
+
+MappedFile::~MappedFile() {
+  if (address_ != nullptr) {
+    munmap(address_, size_);
+  }
+}
+
+bool MappedFile::Open(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+
+  // mmap fails for an empty length:
+  void* address = nullptr;
+  if (st.st_size > 0) {
+    address = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (address == MAP_FAILED) {
+    return false;
+  }
+
+  if (address_ != nullptr) {
+    munmap(address_, size_);
+  }
+  address_ = address;
+  size_ = st.st_size;
+  return true;
+}
+
 }  // namespace atl
@@ -1,6 +1,7 @@
 #ifndef ATL_FILE_H_
 #define ATL_FILE_H_
 
+#include <cstdint>
 #include <fstream>
 #include <functional>
 #include <string>
@@ -9,10 +10,13 @@
 #include "optional.h"
 #include "status.h"
 #include "statusor.h"
+#include "string_view.h"
 
 namespace atl {
-void WalkDir(const std::string& path,
-             std::function<bool(const std::string&)> callback);
+// Calls the callback for every entry below path until it returns false.
+// Returns an error for the first directory which can't be listed.
+atl::Status WalkDir(const std::string& path,
+                    std::function<bool(const std::string&)> callback);
 std::string TempName();
 std::string TempFileName();
 
@@ -38,7 +42,48 @@ bool Rename(const std::string& old_path, const std::string& new_path);
 bool Remove(const std::string& path);
 bool FileExists(const std::string& filename);
 bool FileWriteContent(const std::string& filename, const std::string& content);
+
+// Writes the content into a temporary file next to filename and renames it
+// afterwards, so readers see either the old or the new content but never a
+// partially written file. The file & its directory are synced, so the same
+// holds after a crash.
+bool FileWriteContentAtomic(const std::string& filename,
+                            const std::string& content);
+
+struct FileStat {
+  uint64_t mtime_ns = 0;  // modification time in nanoseconds
+  uint64_t size = 0;
+};
+atl::Optional<FileStat> StatFile(const std::string& filename);
 atl::Optional<std::string> FileReadContent(const std::string& filename);
+
+// Reads size bytes at offset with pread, repeated until all of them have
+// been read. Fails if the file is shorter.
+atl::Optional<std::string> FileReadRange(const std::string& filename,
+                                         uint64_t offset, uint64_t size);
+
+// A file mapped read-only into memory, for readers which only look at a
+// small part of it. Unmapped by the destructor.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Fails if the file can't be opened or mapped. An empty file is an empty
+  // view.
+  bool Open(const std::string& filename);
+
+  StringView data() const {
+    return StringView(static_cast<const char*>(address_), size_);
+  }
+
+ private:
+  void* address_ = nullptr;
+  std::size_t size_ = 0;
+};
 }  // namespace atl
 
 #endif  // ATL_FILE_H_
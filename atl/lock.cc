@@ -0,0 +1,181 @@
+#include <cerrno>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lock.h"
+
+namespace atl {
+
+namespace {
+bool SetLock(int fd, int command, short type, int64_t offset) {
+  struct flock lock = {};
+  lock.l_type = type;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = offset;
+  lock.l_len = 1;
+
+  for (;;) {
+    if (fcntl(fd, command, &lock) == 0) {
+      return true;
+    }
+
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+}
+
+#ifndef F_OFD_SETLKW
+// The ranges of a lock file held by the threads of this process.
+struct Range {
+  int readers = 0;
+  bool writer = false;
+
+  // The record lock is being set, outside of the mutex.
+  bool pending = false;
+
+  // The holders & the threads waiting for the range.
+  int users = 0;
+
+  bool free() const { return readers == 0 && !writer; }
+};
+
+struct SharedFile {
+  int fd = -1;
+  int refs = 0;
+  std::map<int64_t, Range> ranges;
+};
+
+struct LockTable {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::map<std::string, SharedFile> files;
+};
+
+// Never destroyed, locks may be released by static destructors.
+LockTable& Table() {
+  static LockTable* table = new LockTable();
+  return *table;
+}
+
+// Drops a reference to the file, the last one closes it.
+void Unref(LockTable* table, const std::string& path, SharedFile* file) {
+  if (--file->refs == 0) {
+    close(file->fd);
+    table->files.erase(path);
+  }
+}
+#endif
+}  // namespace
+
+#ifdef F_OFD_SETLKW
+FileLock::FileLock(const std::string& path, int64_t offset, Mode mode)
+    : path_(path), offset_(offset), mode_(mode) {
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    return;
+  }
+
+  locked_ = SetLock(fd_, F_OFD_SETLKW,
+                    mode == Mode::kShared ? F_RDLCK : F_WRLCK, offset);
+}
+
+FileLock::~FileLock() {
+  // Closing the file releases the lock:
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+#else
+FileLock::FileLock(const std::string& path, int64_t offset, Mode mode)
+    : path_(path), offset_(offset), mode_(mode) {
+  LockTable& table = Table();
+  std::unique_lock<std::mutex> guard(table.mutex);
+
+  SharedFile& file = table.files[path];
+  if (file.fd < 0) {
+    file.fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file.fd < 0) {
+      table.files.erase(path);
+      return;
+    }
+  }
+  file.refs++;
+
+  const bool exclusive = mode == Mode::kExclusive;
+  Range& range = file.ranges[offset];
+  range.users++;
+  table.changed.wait(guard, [&range, exclusive] {
+    return !range.pending && (exclusive ? range.free() : !range.writer);
+  });
+
+  // Only the first holder in this process takes the record lock, the
+  // others wait for it above:
+  const bool first = range.free();
+  if (exclusive) {
+    range.writer = true;
+  } else {
+    range.readers++;
+  }
+
+  if (first) {
+    range.pending = true;
+    guard.unlock();
+    bool locked =
+        SetLock(file.fd, F_SETLKW, exclusive ? F_WRLCK : F_RDLCK, offset);
+    guard.lock();
+    range.pending = false;
+
+    if (!locked) {
+      if (exclusive) {
+        range.writer = false;
+      } else {
+        range.readers--;
+      }
+      if (--range.users == 0) {
+        file.ranges.erase(offset);
+      }
+      Unref(&table, path, &file);
+      table.changed.notify_all();
+      return;
+    }
+    table.changed.notify_all();
+  }
+
+  fd_ = file.fd;
+  locked_ = true;
+}
+
+FileLock::~FileLock() {
+  if (!locked_) {
+    return;
+  }
+
+  LockTable& table = Table();
+  std::lock_guard<std::mutex> guard(table.mutex);
+
+  SharedFile& file = table.files[path_];
+  Range& range = file.ranges[offset_];
+  if (mode_ == Mode::kExclusive) {
+    range.writer = false;
+  } else {
+    range.readers--;
+  }
+
+  if (range.free()) {
+    SetLock(file.fd, F_SETLK, F_UNLCK, offset_);
+  }
+  if (--range.users == 0) {
+    file.ranges.erase(offset_);
+  }
+  Unref(&table, path_, &file);
+  table.changed.notify_all();
+}
+#endif
+
+}  // namespace atl
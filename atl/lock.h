@@ -0,0 +1,47 @@
+#ifndef ATL_LOCK_H_
+#define ATL_LOCK_H_
+
+#include <cstdint>
+#include <string>
+
+namespace atl {
+
+// FileLock is a scoped advisory lock on a byte range of a file. Locks on
+// different ranges of the same file don't block each other, so a single
+// lock file can provide one lock per id (the offset being the id).
+//
+// The locks exclude other processes as well as other threads of this one.
+// Under linux open file description locks are used. Elsewhere the process
+// shares one descriptor per lock file and only locks a range (with a POSIX
+// record lock) while any of its threads holds it; the threads are
+// coordinated in process. A POSIX lock is dropped by closing any descriptor
+// of the file, which the shared descriptor never does early.
+//
+// The lock file is created if it does not exist yet. The constructor blocks
+// until the lock has been acquired; check operator bool for failures.
+class FileLock {
+ public:
+  enum class Mode { kShared, kExclusive };
+
+  FileLock(const std::string& path, int64_t offset, Mode mode);
+  ~FileLock();
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+  operator bool() const {
+    return locked_;
+  }
+
+ private:
+  std::string path_;
+  int64_t offset_;
+  Mode mode_;
+
+  int fd_ = -1;
+  bool locked_ = false;
+};
+
+}  // namespace atl
+
+#endif  // ATL_LOCK_H_
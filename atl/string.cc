@@ -5,9 +5,14 @@
 #include <string>
 #include <vector>
 #include <cassert>
+#include <limits>
 
 #include <boost/algorithm/string/case_conv.hpp>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "string.h"
 
 namespace atl {
@@ -29,7 +34,35 @@ std::string ToUpper(const std::string& str) {
 }
 
 std::string ToLower(const std::string& str) {
-  return boost::to_lower_copy<std::string>(str);
+  std::string lower(str);
+  ToLowerInPlace(&lower[0], lower.size());
+  return lower;
+}
+
+void ToLowerInPlace(char* data, std::size_t size) {
+  std::size_t i = 0;
+
+#if defined(__SSE2__)
+  // The bytes compare signed: those of UTF-8 sequences are negative, so
+  // they are never between 'A' & 'Z'.
+  const __m128i before_a = _mm_set1_epi8('A' - 1);
+  const __m128i after_z = _mm_set1_epi8('Z' + 1);
+  const __m128i lower_bit = _mm_set1_epi8(0x20);
+  for (; i + 16 <= size; i += 16) {
+    auto* chunk_ptr = reinterpret_cast<__m128i*>(data + i);
+    __m128i chunk = _mm_loadu_si128(chunk_ptr);
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chunk, before_a),
+                                  _mm_cmplt_epi8(chunk, after_z));
+    chunk = _mm_or_si128(chunk, _mm_and_si128(upper, lower_bit));
+    _mm_storeu_si128(chunk_ptr, chunk);
+  }
+#endif
+
+  for (; i < size; i++) {
+    if (data[i] >= 'A' && data[i] <= 'Z') {
+      data[i] = data[i] - 'A' + 'a';
+    }
+  }
 }
 
 std::vector<std::string> Split(const std::string& text,
@@ -102,4 +135,24 @@ std::string TrimSpace(const std::string& text) {
   return Trim(text, cutset);
 }
 
+atl::Optional<int> ParseInt(StringView text) {
+  if (text.empty()) {
+    return {};
+  }
+
+  int64_t value = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') {
+      return {};
+    }
+
+    value = value * 10 + (c - '0');
+    if (value > std::numeric_limits<int>::max()) {
+      return {};
+    }
+  }
+
+  return static_cast<int>(value);
+}
+
 }  // namespace atl
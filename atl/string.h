@@ -8,11 +8,18 @@
 #include <string>
 #include <vector>
 
+#include "optional.h"
+#include "string_view.h"
+
 namespace atl {
 
 std::string CreateSnippet(const std::string& str, unsigned int num_chars, const std::string& filler = "...");
 std::string ToUpper(const std::string& str);
+
+// Lower cases ASCII letters only, the bytes of UTF-8 sequences are left as
+// they are. 16 bytes at a time where SSE2 is available.
 std::string ToLower(const std::string& str);
+void ToLowerInPlace(char* data, std::size_t size);
 
 template <typename Container>
 std::string Join(const Container& container, const std::string& delim) {
@@ -49,6 +56,11 @@ std::string TrimRight(const std::string& text, const std::string& cutset);
 std::string Trim(const std::string& text, const std::string& cutset);
 std::string TrimSpace(const std::string& text);
 
+// Parses a non negative decimal number (ie. a work log id) without
+// allocating. Returns nothing if the text contains anything else than
+// digits or if the number does not fit into an int.
+atl::Optional<int> ParseInt(StringView text);
+
 }  // namespace atl
 
 #endif  // ATL_STRING_H_
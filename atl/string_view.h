@@ -0,0 +1,12 @@
+#ifndef ATL_STRING_VIEW_H_
+#define ATL_STRING_VIEW_H_
+
+// Using boost string_view because it will be std::string_view in C++17 and
+// then it's possible to remove the boost dependency (same as filesystem).
+#include <boost/utility/string_view.hpp>
+
+namespace atl {
+using StringView = boost::string_view;
+}  // namespace atl
+
+#endif  // ATL_STRING_VIEW_H_
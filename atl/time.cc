@@ -30,7 +30,9 @@ std::pair<std::chrono::time_point<std::chrono::system_clock>, bool> ParseTime(
                           bool>(CurrentTime(), false);
   }
 
-  t.tm_isdst = 1;
+  // Let mktime figure out whether DST applies on that day, forcing it
+  // shifted every date by an hour (the previous day) in zones without DST:
+  t.tm_isdst = -1;
   auto tp = std::mktime(&t);
   return std::make_pair<std::chrono::time_point<std::chrono::system_clock>,
                         bool>(std::chrono::system_clock::from_time_t(tp), true);
@@ -0,0 +1,148 @@
+#!/bin/sh
+# Times the worklog commands the performance work was measured with on a
+# generated store, so the numbers can be reproduced and compared between
+# builds. Prints the minimum & median wall time of every command.
+#
+# Usage: worklog_bench.sh <path to the worklog binary> [logs, default 20000]
+#                         [runs, default 5]
+
+set -e
+
+if [ $# -lt 1 ]; then
+  echo "Usage: $0 <path to the worklog binary> [logs] [runs]" >&2
+  exit 2
+fi
+
+WORKLOG=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+LOGS=${2:-20000}
+RUNS=${3:-5}
+WRITERS=16
+export EDITOR=true
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+cd "$DIR"
+"$WORKLOG" init > /dev/null
+
+# The same store for the same number of logs: 1 to 3 tags out of 12, a
+# 4 word subject and an 80 word description from a 3000 word vocabulary.
+awk -v logs="$LOGS" 'BEGIN {
+  srand(1)
+  split("php cpp lang/php lang/cpp lang/go db web infra ml perf ops docs",
+        tags, " ")
+  for (id = 1; id <= logs; id++) {
+    file = ".worklog/logs/" id
+    printf "date=%04d-%02d-%02d\n", 2010 + int(rand() * 8),
+           1 + int(rand() * 12), 1 + int(rand() * 28) > file
+    n = 1 + int(rand() * 3)
+    line = tags[1 + int(rand() * 12)]
+    for (i = 2; i <= n; i++) line = line ", " tags[1 + int(rand() * 12)]
+    printf "tags=%s\n", line > file
+    if (id % 2 == 0) printf "duration=%dm\n", 5 + int(rand() * 300) > file
+    printf "\nW%d", int(rand() * 3000) > file
+    for (i = 1; i < 4; i++) printf " w%d", int(rand() * 3000) > file
+    printf "\n\n" > file
+    for (i = 0; i < 80; i++) printf "w%d ", int(rand() * 3000) > file
+    printf "\n" > file
+    close(file)
+  }
+  print logs + 1 > ".worklog/next_id"
+}'
+
+# BSD date (ie. on OSX) has no %N, perl is there instead.
+if date +%N | grep -q '^[0-9]*$'; then
+  now_ms() {
+    echo $(($(date +%s%N) / 1000000))
+  }
+else
+  now_ms() {
+    perl -MTime::HiRes=time -e 'printf "%d\n", time * 1000'
+  }
+fi
+
+# Runs "$@" RUNS times after the prepare function $2 and prints the
+# minimum & median time under the label $1.
+measure() {
+  label=$1
+  prepare=$2
+  shift 2
+
+  times=""
+  run=0
+  while [ $run -lt "$RUNS" ]; do
+    $prepare
+    start=$(now_ms)
+    "$@" > /dev/null 2>&1
+    times="$times $(($(now_ms) - start))"
+    run=$((run + 1))
+  done
+
+  echo "$times" | tr ' ' '\n' | sed '/^$/d' | sort -n | awk -v label="$label" '
+    { t[NR] = $1 }
+    END { printf "%-40s min %6d ms  median %6d ms\n", label, t[1],
+                 t[int((NR + 1) / 2)] }'
+}
+
+# Drops every index, so the next command rebuilds them from the logs.
+drop_indexes() {
+  find .worklog -maxdepth 1 -type f ! -name lock ! -name next_id \
+    ! -name tombstones -exec rm -f {} +
+}
+
+# Changes one log behind worklog's back, so the next sweep reads it. The
+# mtime differs on every call even within the same second.
+TOUCHES=0
+touch_log() {
+  TOUCHES=$((TOUCHES + 1))
+  touch -d "@$((1500000000 + TOUCHES))" .worklog/logs/1
+}
+
+# Runs WRITERS concurrent 'tag add' on the logs $1 .. $1 + WRITERS - 1, or
+# all on log $1 with $2 = same.
+tag_writers() {
+  writer=0
+  while [ $writer -lt $WRITERS ]; do
+    id=$1
+    [ "$2" = same ] || id=$(($1 + writer))
+    "$WORKLOG" tag add "bench$writer" "$id" &
+    writer=$((writer + 1))
+  done
+  wait
+}
+
+no_prepare() {
+  :
+}
+
+echo "$LOGS logs, $RUNS runs"
+
+# Directory listing & index build:
+measure "list, rebuilding all indexes" drop_indexes "$WORKLOG" list
+measure "list, sweep with one changed log" touch_log "$WORKLOG" list
+measure "list" no_prepare "$WORKLOG" list
+
+# Index loading & the allocations per log:
+measure "tag list" no_prepare "$WORKLOG" tag list
+measure "search tag:lang/php" no_prepare "$WORKLOG" search tag:lang/php
+
+# Concurrent writers under the byte range locks:
+measure "$WRITERS writers on $WRITERS logs" no_prepare tag_writers 1
+measure "$WRITERS writers on one log" no_prepare tag_writers 1 same
+writer=0
+while [ $writer -lt $WRITERS ]; do
+  grep "^tags=" .worklog/logs/1 | grep -q "bench$writer\(,\|$\)" || {
+    echo "FAIL: the concurrent tag add of bench$writer was lost" >&2
+    exit 1
+  }
+  writer=$((writer + 1))
+done
+
+# Group-by statistics over the column index:
+measure "stats" no_prepare "$WORKLOG" stats
+measure "stats tag" no_prepare "$WORKLOG" stats tag
+measure "stats tag,month" no_prepare "$WORKLOG" stats tag,month
+
+# Shell completion from the mapped completions file:
+measure "complete tag lang" no_prepare "$WORKLOG" complete tag lang
+measure "complete id 12" no_prepare "$WORKLOG" complete id 12
+measure "complete word w12" no_prepare "$WORKLOG" complete word w12
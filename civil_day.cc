@@ -0,0 +1,68 @@
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+#include "civil_day.h"
+
+namespace worklog {
+
+// Both conversions are Howard Hinnant's days_from_civil & civil_from_days.
+int64_t DaysFromCivil(int64_t year, int month, int day) {
+  year -= month <= 2;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int64_t year_of_era = year - era * 400;
+  int64_t day_of_year =
+      (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+CivilDate CivilFromDays(int64_t days) {
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  int64_t day_of_era = days - era * 146097;
+  int64_t year_of_era = (day_of_era - day_of_era / 1460 +
+                         day_of_era / 36524 - day_of_era / 146096) /
+                        365;
+  int64_t day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  int64_t shifted_month = (5 * day_of_year + 2) / 153;  // March is 0
+
+  CivilDate date;
+  date.day = static_cast<int>(day_of_year - (153 * shifted_month + 2) / 5 + 1);
+  date.month = static_cast<int>(shifted_month < 10 ? shifted_month + 3
+                                                   : shifted_month - 9);
+  date.year = year_of_era + era * 400 + (date.month <= 2);
+  return date;
+}
+
+int Weekday(int64_t days) {
+  // 1970-01-01 was a Thursday:
+  int64_t weekday = (days + 3) % 7;
+  return static_cast<int>(weekday < 0 ? weekday + 7 : weekday);
+}
+
+void IsoWeek(int64_t days, int64_t* year, int* week) {
+  int64_t thursday = days - Weekday(days) + 3;
+  *year = CivilFromDays(thursday).year;
+  *week = static_cast<int>((thursday - DaysFromCivil(*year, 1, 1)) / 7 + 1);
+}
+
+int64_t LocalDay(uint64_t created_at) {
+  std::time_t time = created_at;
+  std::tm t = {};
+  localtime_r(&time, &t);
+  return DaysFromCivil(t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+}
+
+std::string FormatDay(int64_t days) {
+  CivilDate date = CivilFromDays(days);
+  char text[32];
+  int size = std::snprintf(text, sizeof(text), "%04lld-%02d-%02d",
+                           static_cast<long long>(date.year), date.month,
+                           date.day);
+  return std::string(text, size);
+}
+
+}  // namespace worklog
@@ -0,0 +1,35 @@
+#ifndef CIVIL_DAY_H_
+#define CIVIL_DAY_H_
+
+#include <cstdint>
+#include <string>
+
+namespace worklog {
+
+// Dates are handled as civil day numbers, the days since 1970-01-01 of the
+// proleptic Gregorian calendar. Converting between day numbers & dates is
+// plain arithmetic, only the local day of a timestamp needs the time zone.
+struct CivilDate {
+  int64_t year;
+  int month;  // 1 to 12
+  int day;    // 1 to 31
+};
+
+int64_t DaysFromCivil(int64_t year, int month, int day);
+CivilDate CivilFromDays(int64_t days);
+
+// 0 for Monday to 6 for Sunday.
+int Weekday(int64_t days);
+
+// The ISO 8601 week of the day: the year of its Thursday & the week number.
+void IsoWeek(int64_t days, int64_t* year, int* week);
+
+// The day of the timestamp in local time.
+int64_t LocalDay(uint64_t created_at);
+
+// ie. 2017-06-24
+std::string FormatDay(int64_t days);
+
+}  // namespace worklog
+
+#endif  // CIVIL_DAY_H_
@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "column_index.h"
+#include "tag_tree.h"
+
+namespace worklog {
+
+namespace {
+// "WLCO"
+constexpr uint32_t kColumnIndexMagic = 0x4f434c57;
+}  // namespace
+
+ColumnIndex::ColumnIndex(const Config& config)
+    : DerivedIndex(config.ColumnIndexPath(), kColumnIndexMagic) {}
+
+uint32_t ColumnIndex::Dictionary::Intern(const std::string& name) {
+  auto found = ids_.find(name);
+  if (found != ids_.end()) {
+    return found->second;
+  }
+
+  uint32_t id = names_.size();
+  names_.push_back(name);
+  ids_.emplace(name, id);
+
+  auto pos = std::upper_bound(
+      sorted_.begin(), sorted_.end(), name,
+      [this](const std::string& name, uint32_t other) {
+        return name < names_[other];
+      });
+  sorted_.insert(pos, id);
+  return id;
+}
+
+atl::Optional<uint32_t> ColumnIndex::Dictionary::Find(
+    const std::string& name) const {
+  auto found = ids_.find(name);
+  if (found == ids_.end()) {
+    return {};
+  }
+  return found->second;
+}
+
+std::vector<uint32_t> ColumnIndex::Dictionary::FindPrefix(
+    const std::string& prefix) const {
+  auto first = std::lower_bound(
+      sorted_.begin(), sorted_.end(), prefix,
+      [this](uint32_t id, const std::string& prefix) {
+        return names_[id] < prefix;
+      });
+
+  std::vector<uint32_t> ids;
+  for (auto id = first; id != sorted_.end() &&
+                        names_[*id].compare(0, prefix.size(), prefix) == 0;
+       ++id) {
+    ids.push_back(*id);
+  }
+  return ids;
+}
+
+void ColumnIndex::Dictionary::Clear() {
+  names_.clear();
+  ids_.clear();
+  sorted_.clear();
+}
+
+void ColumnIndex::SetRow(std::size_t row, const Log& log) {
+  ids_[row] = log.id;
+  created_at_[row] = log.created_at;
+  valid_[row] = Validate(log).ok();
+
+  subject_offsets_[row] = subjects_.size();
+  subject_sizes_[row] = log.subject.size();
+  subjects_ += log.subject;
+
+  tag_offsets_[row] = tags_.size();
+  tag_counts_[row] = log.tags.size();
+  for (const auto& tag : log.tags) {
+    tags_.push_back(tags_dict_.Intern(tag));
+  }
+
+  metadata_offsets_[row] = metadata_.size();
+  metadata_counts_[row] = log.metadata.size();
+  for (const auto& field : log.metadata) {
+    MetadataValue value = ParseMetadataValue(field.second);
+    if (value.type == MetadataType::kEnum) {
+      value.number = enums_dict_.Intern(field.second);
+    }
+    metadata_.push_back(
+        {keys_dict_.Intern(field.first), value.type, value.number});
+  }
+}
+
+void ColumnIndex::OnPut(const Log* /*old_log*/, const Log& log) {
+  // Rows are in id order and new logs get the highest id, so this is
+  // nearly always an append:
+  auto pos = std::lower_bound(ids_.begin(), ids_.end(), log.id);
+  std::size_t row = pos - ids_.begin();
+
+  if (pos == ids_.end() || *pos != log.id) {
+    ids_.insert(pos, log.id);
+    created_at_.insert(created_at_.begin() + row, 0);
+    valid_.insert(valid_.begin() + row, false);
+    subject_offsets_.insert(subject_offsets_.begin() + row, 0);
+    subject_sizes_.insert(subject_sizes_.begin() + row, 0);
+    tag_offsets_.insert(tag_offsets_.begin() + row, 0);
+    tag_counts_.insert(tag_counts_.begin() + row, 0);
+    metadata_offsets_.insert(metadata_offsets_.begin() + row, 0);
+    metadata_counts_.insert(metadata_counts_.begin() + row, 0);
+  }
+
+  SetRow(row, log);
+}
+
+void ColumnIndex::OnErase(const Log& old_log) {
+  std::size_t row = Row(old_log.id);
+  if (row == size()) {
+    return;
+  }
+
+  ids_.erase(ids_.begin() + row);
+  created_at_.erase(created_at_.begin() + row);
+  valid_.erase(valid_.begin() + row);
+  subject_offsets_.erase(subject_offsets_.begin() + row);
+  subject_sizes_.erase(subject_sizes_.begin() + row);
+  tag_offsets_.erase(tag_offsets_.begin() + row);
+  tag_counts_.erase(tag_counts_.begin() + row);
+  metadata_offsets_.erase(metadata_offsets_.begin() + row);
+  metadata_counts_.erase(metadata_counts_.begin() + row);
+}
+
+std::size_t ColumnIndex::Row(int id) const {
+  auto pos = std::lower_bound(ids_.begin(), ids_.end(), id);
+  return pos != ids_.end() && *pos == id ? pos - ids_.begin() : size();
+}
+
+atl::StringView ColumnIndex::subject(std::size_t row) const {
+  return atl::StringView(subjects_.data() + subject_offsets_[row],
+                         subject_sizes_[row]);
+}
+
+const uint32_t* ColumnIndex::tags_begin(std::size_t row) const {
+  return tags_.data() + tag_offsets_[row];
+}
+
+const uint32_t* ColumnIndex::tags_end(std::size_t row) const {
+  return tags_.data() + tag_offsets_[row] + tag_counts_[row];
+}
+
+std::vector<bool> ColumnIndex::MatchTags(const std::string& pattern) const {
+  std::vector<bool> tags(num_tags(), false);
+  if (IsTagPrefixPattern(pattern)) {
+    for (uint32_t tag : FindTagsWithPrefix(TagPatternPrefix(pattern))) {
+      tags[tag] = true;
+    }
+  } else if (auto tag = FindTag(pattern)) {
+    tags[*tag] = true;
+  }
+  return tags;
+}
+
+const MetadataCell* ColumnIndex::metadata_begin(std::size_t row) const {
+  return metadata_.data() + metadata_offsets_[row];
+}
+
+const MetadataCell* ColumnIndex::metadata_end(std::size_t row) const {
+  return metadata_.data() + metadata_offsets_[row] + metadata_counts_[row];
+}
+
+const MetadataCell* ColumnIndex::FindMetadata(std::size_t row,
+                                              uint32_t key) const {
+  for (const MetadataCell* cell = metadata_begin(row);
+       cell != metadata_end(row); ++cell) {
+    if (cell->key == key) {
+      return cell;
+    }
+  }
+  return nullptr;
+}
+
+bool ColumnIndex::IsValid(int id) const {
+  std::size_t row = Row(id);
+  return row < size() && valid_[row];
+}
+
+void ColumnIndex::Clear() {
+  ids_.clear();
+  created_at_.clear();
+  valid_.clear();
+  subjects_.clear();
+  subject_offsets_.clear();
+  subject_sizes_.clear();
+  tags_.clear();
+  tag_offsets_.clear();
+  tag_counts_.clear();
+  metadata_.clear();
+  metadata_offsets_.clear();
+  metadata_counts_.clear();
+  tags_dict_.Clear();
+  keys_dict_.Clear();
+  enums_dict_.Clear();
+}
+
+void ColumnIndex::Encode(std::string* out) const {
+  // Only the tags which are still used are written, renumbered in the
+  // order they are found:
+  std::vector<uint32_t> renumbered(tags_dict_.size(), UINT32_MAX);
+  std::vector<uint32_t> used_tags;
+  for (std::size_t row = 0; row < size(); row++) {
+    for (const uint32_t* tag = tags_begin(row); tag != tags_end(row); ++tag) {
+      if (renumbered[*tag] == UINT32_MAX) {
+        renumbered[*tag] = used_tags.size();
+        used_tags.push_back(*tag);
+      }
+    }
+  }
+
+  atl::PutVarint64(out, used_tags.size());
+  for (uint32_t tag : used_tags) {
+    atl::PutLengthPrefixed(out, tags_dict_.name(tag));
+  }
+
+  // The keys & enum values are few, they are written as they are:
+  for (const Dictionary* dict : {&keys_dict_, &enums_dict_}) {
+    atl::PutVarint64(out, dict->size());
+    for (uint32_t id = 0; id < dict->size(); id++) {
+      atl::PutLengthPrefixed(out, dict->name(id));
+    }
+  }
+
+  atl::PutVarint64(out, size());
+  int prev_id = 0;
+  for (std::size_t row = 0; row < size(); row++) {
+    atl::PutVarint32(out, ids_[row] - prev_id);
+    atl::PutFixed64(out, created_at_[row]);
+    atl::PutVarint32(out, valid_[row] ? 1 : 0);
+    atl::PutLengthPrefixed(out, subject(row));
+
+    atl::PutVarint32(out, tag_counts_[row]);
+    for (const uint32_t* tag = tags_begin(row); tag != tags_end(row); ++tag) {
+      atl::PutVarint32(out, renumbered[*tag]);
+    }
+
+    atl::PutVarint32(out, metadata_counts_[row]);
+    for (const MetadataCell* cell = metadata_begin(row);
+         cell != metadata_end(row); ++cell) {
+      atl::PutVarint32(out, cell->key);
+      atl::PutVarint32(out, static_cast<uint32_t>(cell->type));
+      atl::PutFixed64(out, static_cast<uint64_t>(cell->number));
+    }
+
+    prev_id = ids_[row];
+  }
+}
+
+bool ColumnIndex::Decode(atl::Decoder* in) {
+  uint64_t num_tags = 0;
+  if (!in->GetVarint64(&num_tags) || num_tags > in->remaining()) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < num_tags; i++) {
+    atl::StringView name;
+    if (!in->GetLengthPrefixed(&name)) {
+      return false;
+    }
+    tags_dict_.Intern(name.to_string());
+  }
+
+  for (Dictionary* dict : {&keys_dict_, &enums_dict_}) {
+    uint64_t size = 0;
+    if (!in->GetVarint64(&size) || size > in->remaining()) {
+      return false;
+    }
+
+    for (uint64_t i = 0; i < size; i++) {
+      atl::StringView name;
+      if (!in->GetLengthPrefixed(&name)) {
+        return false;
+      }
+      dict->Intern(name.to_string());
+    }
+  }
+
+  uint64_t num_rows = 0;
+  if (!in->GetVarint64(&num_rows) || num_rows > in->remaining()) {
+    return false;
+  }
+
+  ids_.reserve(num_rows);
+  created_at_.reserve(num_rows);
+  valid_.reserve(num_rows);
+  subject_offsets_.reserve(num_rows);
+  subject_sizes_.reserve(num_rows);
+  tag_offsets_.reserve(num_rows);
+  tag_counts_.reserve(num_rows);
+  metadata_offsets_.reserve(num_rows);
+  metadata_counts_.reserve(num_rows);
+
+  int id = 0;
+  for (uint64_t row = 0; row < num_rows; row++) {
+    uint32_t delta = 0;
+    uint64_t created_at = 0;
+    uint32_t valid = 0;
+    uint32_t count = 0;
+    atl::StringView subject;
+    if (!in->GetVarint32(&delta) || !in->GetFixed64(&created_at) ||
+        !in->GetVarint32(&valid) || !in->GetLengthPrefixed(&subject) ||
+        !in->GetVarint32(&count)) {
+      return false;
+    }
+
+    id += delta;
+    ids_.push_back(id);
+    created_at_.push_back(created_at);
+    valid_.push_back(valid != 0);
+
+    subject_offsets_.push_back(subjects_.size());
+    subject_sizes_.push_back(subject.size());
+    subjects_.append(subject.data(), subject.size());
+
+    tag_offsets_.push_back(tags_.size());
+    tag_counts_.push_back(count);
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t tag = 0;
+      if (!in->GetVarint32(&tag) || tag >= tags_dict_.size()) {
+        return false;
+      }
+      tags_.push_back(tag);
+    }
+
+    uint32_t num_fields = 0;
+    if (!in->GetVarint32(&num_fields)) {
+      return false;
+    }
+
+    metadata_offsets_.push_back(metadata_.size());
+    metadata_counts_.push_back(num_fields);
+    for (uint32_t i = 0; i < num_fields; i++) {
+      uint32_t key = 0;
+      uint32_t type = 0;
+      uint64_t number = 0;
+      if (!in->GetVarint32(&key) || key >= keys_dict_.size() ||
+          !in->GetVarint32(&type) ||
+          type > static_cast<uint32_t>(MetadataType::kInteger) ||
+          !in->GetFixed64(&number)) {
+        return false;
+      }
+
+      MetadataType cell_type = static_cast<MetadataType>(type);
+      if (cell_type == MetadataType::kEnum && number >= enums_dict_.size()) {
+        return false;
+      }
+      metadata_.push_back({key, cell_type, static_cast<int64_t>(number)});
+    }
+  }
+
+  return true;
+}
+
+}  // namespace worklog
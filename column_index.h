@@ -0,0 +1,146 @@
+#ifndef COLUMN_INDEX_H_
+#define COLUMN_INDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "atl/optional.h"
+#include "atl/string_view.h"
+
+#include "derived_index.h"
+#include "index.h"
+#include "metadata.h"
+#include "worklog.h"
+
+namespace worklog {
+
+// A custom field of a log (see Log::metadata) in the ColumnIndex. The key
+// and enum values are ids of dictionaries of the index.
+struct MetadataCell {
+  uint32_t key;
+  MetadataType type;
+  int64_t number;  // the enum value id, seconds or the integer
+};
+
+// ColumnIndex stores the header fields of all logs column by column (struct
+// of arrays) in id order: ids, created_at, the subjects in one string
+// arena, the tags as ids of a tag dictionary, the typed custom fields and
+// the validity (see Validate) as a bitmap. Filters, sorts & reports which only look at a few
+// fields scan contiguous arrays instead of whole Log objects.
+// Deleted logs are included, callers skip them (see Index::IsDeleted).
+class ColumnIndex : public DerivedIndex {
+ public:
+  explicit ColumnIndex(const Config& config);
+
+  void OnPut(const Log* old_log, const Log& log) override;
+  void OnErase(const Log& old_log) override;
+
+  LogFields fields() const override { return kHeaderFields; }
+
+  std::size_t size() const { return ids_.size(); }
+
+  // The row of the log or size() if there is none (binary search).
+  std::size_t Row(int id) const;
+
+  int id(std::size_t row) const { return ids_[row]; }
+  uint64_t created_at(std::size_t row) const { return created_at_[row]; }
+  bool valid(std::size_t row) const { return valid_[row]; }
+  atl::StringView subject(std::size_t row) const;
+
+  // The tag ids of the row are [tags_begin(row), tags_end(row)).
+  const uint32_t* tags_begin(std::size_t row) const;
+  const uint32_t* tags_end(std::size_t row) const;
+
+  std::size_t num_tags() const { return tags_dict_.size(); }
+  const std::string& tag_name(uint32_t tag) const {
+    return tags_dict_.name(tag);
+  }
+  atl::Optional<uint32_t> FindTag(const std::string& name) const {
+    return tags_dict_.Find(name);
+  }
+
+  // The ids of the tags starting with prefix in name order, a range of
+  // the sorted dictionary.
+  std::vector<uint32_t> FindTagsWithPrefix(const std::string& prefix) const {
+    return tags_dict_.FindPrefix(prefix);
+  }
+
+  // The tags matching a tag pattern (see MatchesTagPattern) as a bitmap
+  // over the tag ids.
+  std::vector<bool> MatchTags(const std::string& pattern) const;
+
+  // The custom fields of the row are [metadata_begin(row),
+  // metadata_end(row)), ordered by key name.
+  const MetadataCell* metadata_begin(std::size_t row) const;
+  const MetadataCell* metadata_end(std::size_t row) const;
+
+  // The field of the row with the key or null.
+  const MetadataCell* FindMetadata(std::size_t row, uint32_t key) const;
+
+  const std::string& metadata_key(uint32_t key) const {
+    return keys_dict_.name(key);
+  }
+  atl::Optional<uint32_t> FindMetadataKey(const std::string& name) const {
+    return keys_dict_.Find(name);
+  }
+  std::size_t num_enum_values() const { return enums_dict_.size(); }
+  const std::string& enum_value(uint32_t value) const {
+    return enums_dict_.name(value);
+  }
+
+  // Whether the log is valid; false for unknown ids.
+  bool IsValid(int id) const;
+
+ protected:
+  void Clear() override;
+  void Encode(std::string* out) const override;
+  bool Decode(atl::Decoder* in) override;
+
+ private:
+  // Interns strings as consecutive ids.
+  class Dictionary {
+   public:
+    uint32_t Intern(const std::string& name);
+    atl::Optional<uint32_t> Find(const std::string& name) const;
+    std::vector<uint32_t> FindPrefix(const std::string& prefix) const;
+
+    std::size_t size() const { return names_.size(); }
+    const std::string& name(uint32_t id) const { return names_[id]; }
+    void Clear();
+
+   private:
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::vector<uint32_t> sorted_;  // the ids in name order
+  };
+
+  void SetRow(std::size_t row, const Log& log);
+
+  std::vector<int> ids_;
+  std::vector<uint64_t> created_at_;
+  std::vector<bool> valid_;
+
+  // Replaced subjects & tags stay in the arenas until the next Encode()
+  // writes them compacted.
+  std::string subjects_;
+  std::vector<uint32_t> subject_offsets_;
+  std::vector<uint32_t> subject_sizes_;
+
+  std::vector<uint32_t> tags_;
+  std::vector<uint32_t> tag_offsets_;
+  std::vector<uint32_t> tag_counts_;
+
+  std::vector<MetadataCell> metadata_;
+  std::vector<uint32_t> metadata_offsets_;
+  std::vector<uint32_t> metadata_counts_;
+
+  Dictionary tags_dict_;
+  Dictionary keys_dict_;
+  Dictionary enums_dict_;
+};
+
+}  // namespace worklog
+
+#endif  // COLUMN_INDEX_H_
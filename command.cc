@@ -2,6 +2,7 @@
 #include <map>
 #include <string>
 #include <iostream>
+#include <vector>
 
 #include "command.h"
 
@@ -29,6 +30,14 @@ atl::StatusOr<Command::Action> CommandParser::Parse(const std::vector<std::strin
   return atl::Status(atl::error::NOT_FOUND, "Command not found");
 }
 
+std::vector<std::string> CommandParser::names() const {
+  std::vector<std::string> names;
+  for (const auto& entry : commands_) {
+    names.push_back(entry.first);
+  }
+  return names;
+}
+
 void CommandParser::PrintHelp() const {
   std::cout << "Available commands: \n";
   for (const auto& entry : commands_) {
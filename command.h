@@ -41,6 +41,9 @@ class CommandParser {
   atl::StatusOr<Command::Action> Parse(const std::vector<std::string>& args);
   void PrintHelp() const;
 
+  // The names of the commands in name order.
+  std::vector<std::string> names() const;
+
  private:
   std::map<std::string, Command> commands_;
 };
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "atl/coding.h"
+#include "atl/file.h"
+
+#include "completion_index.h"
+#include "inverted_index.h"
+#include "tombstone.h"
+
+namespace worklog {
+
+namespace {
+// "WLCP"
+constexpr uint32_t kCompletionMagic = 0x50434c57;
+
+// A table of names with two numbers each, sorted by name:
+//
+//   number of entries | size of the entries | offset of every entry |
+//   entries (length prefixed name | fixed64 first | fixed64 second)
+//
+// The fixed width offsets allow a binary search in the file as it is.
+template <typename Map, typename Numbers>
+void EncodeTable(const Map& map, const Numbers& numbers, std::string* out) {
+  std::string offsets;
+  std::string entries;
+  for (const auto& entry : map) {
+    uint64_t first = 0;
+    uint64_t second = 0;
+    numbers(entry.second, &first, &second);
+
+    atl::PutFixed32(&offsets, entries.size());
+    atl::PutLengthPrefixed(&entries, entry.first);
+    atl::PutFixed64(&entries, first);
+    atl::PutFixed64(&entries, second);
+  }
+
+  atl::PutFixed32(out, map.size());
+  atl::PutFixed32(out, entries.size());
+  out->append(offsets);
+  out->append(entries);
+}
+
+uint32_t Fixed32At(atl::StringView data, std::size_t pos) {
+  uint32_t value = 0;
+  atl::Decoder in(data.substr(pos, 4));
+  in.GetFixed32(&value);
+  return value;
+}
+
+class TableView {
+ public:
+  struct Entry {
+    atl::StringView name;
+    uint64_t first = 0;
+    uint64_t second = 0;
+  };
+
+  // Takes the table from the input, the entries stay in it.
+  bool Parse(atl::Decoder* in) {
+    uint32_t size = 0;
+    uint32_t entries_size = 0;
+    if (!in->GetFixed32(&size) || !in->GetFixed32(&entries_size) ||
+        size > in->remaining() / 4) {
+      return false;
+    }
+
+    size_ = size;
+    return in->GetBytes(4 * size, &offsets_) &&
+           in->GetBytes(entries_size, &entries_);
+  }
+
+  std::size_t size() const { return size_; }
+
+  bool Get(std::size_t i, Entry* entry) const {
+    uint32_t offset = Fixed32At(offsets_, 4 * i);
+    if (offset > entries_.size()) {
+      return false;
+    }
+
+    atl::Decoder in(entries_.substr(offset));
+    return in.GetLengthPrefixed(&entry->name) &&
+           in.GetFixed64(&entry->first) && in.GetFixed64(&entry->second);
+  }
+
+  // The first entry whose name isn't before prefix (binary search).
+  std::size_t LowerBound(atl::StringView prefix) const {
+    std::size_t begin = 0;
+    std::size_t end = size_;
+    while (begin < end) {
+      std::size_t middle = begin + (end - begin) / 2;
+      Entry entry;
+      if (Get(middle, &entry) && entry.name < prefix) {
+        begin = middle + 1;
+      } else {
+        end = middle;
+      }
+    }
+    return begin;
+  }
+
+ private:
+  std::size_t size_ = 0;
+  atl::StringView offsets_;
+  atl::StringView entries_;
+};
+
+// The names of the table starting with prefix, the largest first & second
+// numbers first.
+std::vector<std::string> CompleteTable(const TableView& table,
+                                       const std::string& prefix,
+                                       std::size_t limit) {
+  std::vector<TableView::Entry> matches;
+  TableView::Entry entry;
+  for (std::size_t i = table.LowerBound(prefix);
+       i < table.size() && table.Get(i, &entry) &&
+       entry.name.starts_with(prefix);
+       i++) {
+    matches.push_back(entry);
+  }
+
+  auto ranked = [](const TableView::Entry& a, const TableView::Entry& b) {
+    return std::tie(b.first, b.second, a.name) <
+           std::tie(a.first, a.second, b.name);
+  };
+  limit = std::min(limit, matches.size());
+  std::partial_sort(matches.begin(), matches.begin() + limit, matches.end(),
+                    ranked);
+
+  std::vector<std::string> names;
+  for (std::size_t i = 0; i < limit; i++) {
+    names.push_back(matches[i].name.to_string());
+  }
+  return names;
+}
+
+// The ids with the decimal prefix, highest first. For the prefix 12 those
+// are the ranges [12, 13), [120, 130), [1200, 1300), ... of the sorted ids,
+// each found by a binary search.
+std::vector<std::string> CompleteIds(atl::StringView ids,
+                                     const std::string& prefix,
+                                     std::size_t limit) {
+  const std::size_t size = ids.size() / 4;
+  auto lower_bound = [&](uint64_t value) {
+    std::size_t begin = 0;
+    std::size_t end = size;
+    while (begin < end) {
+      std::size_t middle = begin + (end - begin) / 2;
+      if (Fixed32At(ids, 4 * middle) < value) {
+        begin = middle + 1;
+      } else {
+        end = middle;
+      }
+    }
+    return begin;
+  };
+
+  uint64_t first = 0;
+  for (char c : prefix) {
+    if (c < '0' || c > '9' || first > UINT32_MAX) {
+      return {};
+    }
+    first = first * 10 + (c - '0');
+  }
+
+  // The ranges of the prefix, the longer numbers (higher ids) last:
+  std::vector<std::pair<std::size_t, std::size_t>> ranges;
+  if (prefix.empty()) {
+    ranges.emplace_back(0, size);
+  } else if (prefix == "0") {
+    ranges.emplace_back(lower_bound(0), lower_bound(1));
+  } else if (prefix[0] != '0') {
+    for (uint64_t width = 1; first * width <= UINT32_MAX; width *= 10) {
+      ranges.emplace_back(lower_bound(first * width),
+                          lower_bound((first + 1) * width));
+    }
+  }
+
+  std::vector<std::string> matches;
+  for (auto range = ranges.rbegin();
+       range != ranges.rend() && matches.size() < limit; ++range) {
+    for (std::size_t i = range->second;
+         i > range->first && matches.size() < limit; i--) {
+      matches.push_back(std::to_string(Fixed32At(ids, 4 * (i - 1))));
+    }
+  }
+  return matches;
+}
+}  // namespace
+
+atl::StatusOr<CompletionContext> ParseCompletionContext(
+    const std::string& text) {
+  if (text == "command") {
+    return CompletionContext::kCommand;
+  } else if (text == "tag") {
+    return CompletionContext::kTag;
+  } else if (text == "id") {
+    return CompletionContext::kId;
+  } else if (text == "word") {
+    return CompletionContext::kWord;
+  }
+  return atl::Status(atl::error::INVALID_ARGUMENT,
+                     "Unknown completion context: " + text +
+                         " (expected command, tag, id or word)");
+}
+
+CompletionIndex::CompletionIndex(const Config& config)
+    : DerivedIndex(config.CompletionsPath(), kCompletionMagic) {}
+
+void CompletionIndex::Add(const Log& log, int delta) {
+  if (delta > 0) {
+    ids_.insert(log.id);
+  } else {
+    ids_.erase(log.id);
+  }
+
+  for (const auto& tag : log.tags) {
+    uint64_t& count = tags_[tag];
+    count += delta;
+    if (count == 0) {
+      tags_.erase(tag);
+    }
+  }
+
+  std::vector<std::string> words = Tokenize(log.subject);
+  std::sort(words.begin(), words.end());
+  words.erase(std::unique(words.begin(), words.end()), words.end());
+  for (const auto& word : words) {
+    WordStats& stats = words_[word];
+    stats.count += delta;
+    if (stats.count == 0) {
+      words_.erase(word);
+    } else if (delta > 0) {
+      stats.last_used = std::max(stats.last_used, log.created_at);
+    }
+  }
+}
+
+void CompletionIndex::OnPut(const Log* old_log, const Log& log) {
+  if (excluded_.count(log.id) > 0) {
+    return;
+  }
+
+  if (old_log != nullptr) {
+    Add(*old_log, -1);
+  }
+  Add(log, 1);
+}
+
+void CompletionIndex::OnErase(const Log& old_log) {
+  if (excluded_.count(old_log.id) == 0) {
+    Add(old_log, -1);
+  }
+}
+
+bool CompletionIndex::Sync(const Index& index) {
+  const std::map<int, uint64_t>& deleted = index.tombstones().deleted();
+  bool changed = false;
+
+  for (const auto& entry : deleted) {
+    if (excluded_.insert(entry.first).second) {
+      auto found = index.entries().find(entry.first);
+      if (found != index.entries().end()) {
+        Add(found->second.log, -1);
+      }
+      changed = true;
+    }
+  }
+
+  for (auto it = excluded_.begin(); it != excluded_.end();) {
+    if (deleted.count(*it) > 0) {
+      ++it;
+      continue;
+    }
+
+    auto found = index.entries().find(*it);
+    if (found != index.entries().end()) {
+      Add(found->second.log, 1);
+    }
+    it = excluded_.erase(it);
+    changed = true;
+  }
+
+  return changed;
+}
+
+void CompletionIndex::Clear() {
+  tags_.clear();
+  words_.clear();
+  ids_.clear();
+  excluded_.clear();
+}
+
+void CompletionIndex::Encode(std::string* out) const {
+  EncodeTable(tags_,
+              [](uint64_t count, uint64_t* first, uint64_t* second) {
+                *first = count;
+                *second = 0;
+              },
+              out);
+  EncodeTable(words_,
+              [](const WordStats& stats, uint64_t* first, uint64_t* second) {
+                *first = stats.last_used;
+                *second = stats.count;
+              },
+              out);
+
+  atl::PutFixed32(out, ids_.size());
+  for (int id : ids_) {
+    atl::PutFixed32(out, id);
+  }
+
+  atl::PutFixed32(out, excluded_.size());
+  for (int id : excluded_) {
+    atl::PutFixed32(out, id);
+  }
+}
+
+bool CompletionIndex::Decode(atl::Decoder* in) {
+  TableView tags;
+  TableView words;
+  if (!tags.Parse(in) || !words.Parse(in)) {
+    return false;
+  }
+
+  TableView::Entry entry;
+  for (std::size_t i = 0; i < tags.size(); i++) {
+    if (!tags.Get(i, &entry)) {
+      return false;
+    }
+    tags_.emplace_hint(tags_.end(), entry.name.to_string(), entry.first);
+  }
+
+  for (std::size_t i = 0; i < words.size(); i++) {
+    if (!words.Get(i, &entry)) {
+      return false;
+    }
+    WordStats& stats =
+        words_.emplace_hint(words_.end(), entry.name.to_string(), WordStats())
+            ->second;
+    stats.last_used = entry.first;
+    stats.count = entry.second;
+  }
+
+  for (std::set<int>* ids : {&ids_, &excluded_}) {
+    uint32_t num_ids = 0;
+    if (!in->GetFixed32(&num_ids) || num_ids > in->remaining() / 4) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < num_ids; i++) {
+      uint32_t id = 0;
+      in->GetFixed32(&id);
+      ids->insert(ids->end(), id);
+    }
+  }
+  return true;
+}
+
+atl::StatusOr<std::vector<std::string>> CompletionIndex::Complete(
+    const Config& config, CompletionContext context,
+    const std::string& prefix, std::size_t limit) {
+  // Mapped instead of copied, the checksum is the only pass over all of it:
+  const std::string path = config.CompletionsPath();
+  atl::MappedFile file;
+  if (!file.Open(path)) {
+    return atl::Status(atl::error::NOT_FOUND, "Missing index: " + path);
+  }
+
+  uint64_t generation = 0;
+  atl::StringView payload;
+  atl::Status status = ParseFile(path, kCompletionMagic, file.data(),
+                                 &generation, &payload);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Writes leave the completions to be caught up by their next reader:
+  if (!Index::ReadState(config).IsCurrent(generation,
+                                          kFieldTags | kFieldSubject)) {
+    return atl::Status(atl::error::FAILED_PRECONDITION,
+                       "Outdated index: " + path);
+  }
+
+  atl::Decoder in(payload);
+  TableView tags;
+  TableView words;
+  uint32_t num_ids = 0;
+  atl::StringView ids;
+  uint32_t num_excluded = 0;
+  atl::StringView excluded;
+  if (!tags.Parse(&in) || !words.Parse(&in) || !in.GetFixed32(&num_ids) ||
+      num_ids > in.remaining() / 4 || !in.GetBytes(4 * num_ids, &ids) ||
+      !in.GetFixed32(&num_excluded) || num_excluded > in.remaining() / 4 ||
+      !in.GetBytes(4 * num_excluded, &excluded)) {
+    return atl::Status(atl::error::DATA_LOSS, "Corrupted index: " + path);
+  }
+
+  // Logs deleted or undeleted since the file has been saved:
+  Tombstones tombstones(config);
+  atl::Status tombstones_status = tombstones.Load();
+  if (!tombstones_status.ok()) {
+    return tombstones_status;
+  }
+
+  bool synced = tombstones.size() == num_excluded;
+  for (uint32_t i = 0; synced && i < num_excluded; i++) {
+    synced = tombstones.Contains(Fixed32At(excluded, 4 * i));
+  }
+  if (!synced) {
+    return atl::Status(atl::error::FAILED_PRECONDITION,
+                       "Outdated index: " + path);
+  }
+
+  switch (context) {
+    case CompletionContext::kTag:
+      return CompleteTable(tags, prefix, limit);
+    case CompletionContext::kWord:
+      return CompleteTable(words, prefix, limit);
+    case CompletionContext::kId:
+      return CompleteIds(ids, prefix, limit);
+    case CompletionContext::kCommand:
+      break;
+  }
+  return std::vector<std::string>();
+}
+
+}  // namespace worklog
@@ -0,0 +1,85 @@
+#ifndef COMPLETION_INDEX_H_
+#define COMPLETION_INDEX_H_
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "atl/statusor.h"
+
+#include "derived_index.h"
+#include "index.h"
+#include "worklog.h"
+
+namespace worklog {
+
+// What is completed: command names come from the CommandParser, the rest
+// from the CompletionIndex.
+enum class CompletionContext { kCommand, kTag, kId, kWord };
+
+// Parses 'command', 'tag', 'id' or 'word'.
+atl::StatusOr<CompletionContext> ParseCompletionContext(
+    const std::string& text);
+
+// CompletionIndex keeps what shell completions offer: the tags (with the
+// number of logs), the ids and the words of the subjects (lower case, with
+// the date they were last used).
+//
+// Like for the Aggregates, deleting & undeleting a log only changes the
+// tombstones, so those are applied by Sync(). The file records the
+// tombstones it reflects, Complete() refuses it once they differ.
+//
+// The file is laid out to be used in place by Complete(): the tags & words
+// are tables sorted by name with a fixed width offset per entry, so a
+// prefix is found by a binary search without decoding the other entries,
+// and the ids are a sorted array of fixed32.
+class CompletionIndex : public DerivedIndex {
+ public:
+  explicit CompletionIndex(const Config& config);
+
+  void OnPut(const Log* old_log, const Log& log) override;
+  void OnErase(const Log& old_log) override;
+
+  LogFields fields() const override { return kFieldTags | kFieldSubject; }
+
+  // Excludes the logs deleted since the last call and adds the undeleted
+  // ones back. Returns true if anything changed.
+  bool Sync(const Index& index);
+
+  // Completes the prefix from the saved file of the index without loading
+  // the log index, only its header & the tombstones are read to check that
+  // the file is still current (FAILED_PRECONDITION otherwise). At most
+  // limit candidates are returned: the most used tags, the most recently
+  // used words and the highest ids first.
+  static atl::StatusOr<std::vector<std::string>> Complete(
+      const Config& config, CompletionContext context,
+      const std::string& prefix, std::size_t limit);
+
+ protected:
+  void Clear() override;
+  void Encode(std::string* out) const override;
+  bool Decode(atl::Decoder* in) override;
+
+ private:
+  struct WordStats {
+    uint64_t count = 0;
+
+    // Not lowered when the newest log with the word goes away.
+    uint64_t last_used = 0;
+  };
+
+  void Add(const Log& log, int delta);
+
+  std::map<std::string, uint64_t> tags_;
+  std::map<std::string, WordStats> words_;
+  std::set<int> ids_;
+
+  // The tombstones as of the last Sync(), those logs aren't counted.
+  std::set<int> excluded_;
+};
+
+}  // namespace worklog
+
+#endif  // COMPLETION_INDEX_H_
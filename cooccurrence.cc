@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "cooccurrence.h"
+
+namespace worklog {
+
+namespace {
+// Below this many logs the matrix is counted by a single thread.
+constexpr std::size_t kMinParallelCooccurrenceSize = 1 << 16;
+}  // namespace
+
+void CooccurrenceMatrix::Add(const uint32_t* begin, const uint32_t* end,
+                             int64_t delta) {
+  for (const uint32_t* a = begin; a != end; ++a) {
+    for (const uint32_t* b = a + 1; b != end; ++b) {
+      auto found = counts_.find(Key(*a, *b));
+      if (found == counts_.end()) {
+        if (delta > 0) {
+          counts_.emplace(Key(*a, *b), delta);
+        }
+        continue;
+      }
+
+      if (delta < 0 && found->second <= static_cast<uint64_t>(-delta)) {
+        counts_.erase(found);
+      } else {
+        found->second += delta;
+      }
+    }
+  }
+}
+
+void CooccurrenceMatrix::Merge(const CooccurrenceMatrix& other) {
+  for (const auto& pair : other.counts_) {
+    counts_[pair.first] += pair.second;
+  }
+}
+
+uint64_t CooccurrenceMatrix::count(uint32_t a, uint32_t b) const {
+  auto found = counts_.find(Key(a, b));
+  return found == counts_.end() ? 0 : found->second;
+}
+
+CooccurrenceMatrix ComputeCooccurrence(const Index& index,
+                                       const ColumnIndex& columns,
+                                       unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  const std::size_t size = columns.size();
+  unsigned int num_chunks =
+      size < kMinParallelCooccurrenceSize ? 1 : num_threads;
+  std::size_t chunk_size = (size + num_chunks - 1) / num_chunks;
+
+  std::vector<CooccurrenceMatrix> matrices(num_chunks);
+  auto count = [&](unsigned int chunk) {
+    CooccurrenceMatrix& matrix = matrices[chunk];
+
+    std::size_t end = std::min(size, (chunk + 1) * chunk_size);
+    for (std::size_t row = chunk * chunk_size; row < end; row++) {
+      if (columns.valid(row) && !index.IsDeleted(columns.id(row))) {
+        matrix.Add(columns.tags_begin(row), columns.tags_end(row));
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int chunk = 1; chunk < num_chunks; chunk++) {
+    threads.emplace_back(count, chunk);
+  }
+  count(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (unsigned int chunk = 1; chunk < num_chunks; chunk++) {
+    matrices[0].Merge(matrices[chunk]);
+  }
+  return std::move(matrices[0]);
+}
+
+}  // namespace worklog
@@ -0,0 +1,55 @@
+#ifndef COOCCURRENCE_H_
+#define COOCCURRENCE_H_
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "column_index.h"
+#include "index.h"
+
+namespace worklog {
+
+// CooccurrenceMatrix counts in how many logs two tags appear together. The
+// tags are interned ids (ie. of a ColumnIndex) and only the pairs which
+// occur are stored: a sparse upper triangle keyed by the pair of ids.
+class CooccurrenceMatrix {
+ public:
+  // Counts every pair of the tag ids of a log, a negative delta uncounts
+  // them. The ids of a log are distinct.
+  void Add(const uint32_t* begin, const uint32_t* end, int64_t delta = 1);
+
+  void Merge(const CooccurrenceMatrix& other);
+  void Clear() { counts_.clear(); }
+
+  uint64_t count(uint32_t a, uint32_t b) const;
+  std::size_t size() const { return counts_.size(); }
+
+  // Calls fn(a, b, count) for every pair with a < b, in no particular order.
+  template <typename Fn>
+  void ForEachPair(Fn fn) const {
+    for (const auto& pair : counts_) {
+      fn(static_cast<uint32_t>(pair.first >> 32),
+         static_cast<uint32_t>(pair.first), pair.second);
+    }
+  }
+
+ private:
+  static uint64_t Key(uint32_t a, uint32_t b) {
+    return a < b ? static_cast<uint64_t>(a) << 32 | b
+                 : static_cast<uint64_t>(b) << 32 | a;
+  }
+
+  std::unordered_map<uint64_t, uint64_t> counts_;
+};
+
+// Counts the co-occurrences of the valid, not deleted logs over the tag id
+// column (the ids are the ones of the ColumnIndex). Large stores are split
+// into one range of rows per thread (0 uses all cores), each counting into
+// its own matrix, which are merged afterwards.
+CooccurrenceMatrix ComputeCooccurrence(const Index& index,
+                                       const ColumnIndex& columns,
+                                       unsigned int num_threads = 0);
+
+}  // namespace worklog
+
+#endif  // COOCCURRENCE_H_
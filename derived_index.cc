@@ -0,0 +1,85 @@
+#include <string>
+
+#include "atl/coding.h"
+#include "atl/crc32c.h"
+#include "atl/file.h"
+#include "atl/optional.h"
+
+#include "derived_index.h"
+
+namespace worklog {
+
+// File layout: magic | generation | payload | crc32c of all before
+atl::Status DerivedIndex::ParseFile(const std::string& path, uint32_t magic,
+                                    atl::StringView data, uint64_t* generation,
+                                    atl::StringView* payload) {
+  if (data.size() < 16) {
+    return atl::Status(atl::error::DATA_LOSS, "Truncated index: " + path);
+  }
+
+  atl::StringView body = data.substr(0, data.size() - 4);
+  atl::Decoder crc_in(data.substr(body.size()));
+
+  uint32_t crc = 0;
+  if (!crc_in.GetFixed32(&crc) || atl::Crc32c(body) != crc) {
+    return atl::Status(atl::error::DATA_LOSS, "Corrupted index: " + path);
+  }
+
+  atl::Decoder in(body);
+
+  uint32_t file_magic = 0;
+  if (!in.GetFixed32(&file_magic) || file_magic != magic ||
+      !in.GetFixed64(generation)) {
+    return atl::Status(atl::error::DATA_LOSS, "Unknown index format: " + path);
+  }
+
+  *payload = body.substr(12);
+  return atl::Status();
+}
+
+atl::Status DerivedIndex::Load(uint64_t* generation) {
+  Clear();
+
+  atl::Optional<std::string> content = atl::FileReadContent(path_);
+  if (!content) {
+    return atl::Status(atl::error::NOT_FOUND, "Missing index: " + path_);
+  }
+
+  atl::StringView payload;
+  atl::Status status =
+      ParseFile(path_, magic_, content.value(), generation, &payload);
+  if (!status.ok()) {
+    return status;
+  }
+
+  atl::Decoder in(payload);
+  if (!Decode(&in) || !in.empty()) {
+    Clear();
+    return atl::Status(atl::error::DATA_LOSS, "Corrupted index: " + path_);
+  }
+
+  return atl::Status();
+}
+
+atl::Status DerivedIndex::Save(uint64_t generation) const {
+  std::string out;
+  atl::PutFixed32(&out, magic_);
+  atl::PutFixed64(&out, generation);
+  Encode(&out);
+  atl::PutFixed32(&out, atl::Crc32c(out));
+
+  if (!atl::FileWriteContentAtomic(path_, out)) {
+    return atl::Status(atl::error::INTERNAL, "Failed to write index: " + path_);
+  }
+
+  return atl::Status();
+}
+
+void DerivedIndex::Rebuild(const Index& index) {
+  Clear();
+  for (const auto& entry : index.entries()) {
+    OnPut(nullptr, entry.second.log);
+  }
+}
+
+}  // namespace worklog
@@ -0,0 +1,58 @@
+#ifndef DERIVED_INDEX_H_
+#define DERIVED_INDEX_H_
+
+#include <cstdint>
+#include <string>
+
+#include "atl/coding.h"
+#include "atl/status.h"
+
+#include "index.h"
+
+namespace worklog {
+
+// DerivedIndex is an index which is computed from the log index (ie. the
+// trigram index). It is kept up to date incrementally through the
+// IndexListener callbacks and stored together with the generation of the
+// log index it reflects. An older one is still current if none of its
+// fields changed since (see IndexState), otherwise it catches up with the
+// journal of the log index or is rebuilt from it (see IndexSet).
+class DerivedIndex : public IndexListener {
+ public:
+  DerivedIndex(const std::string& path, uint32_t magic)
+      : path_(path), magic_(magic) {}
+
+  // Fails if the file is missing or corrupted. Whether the generation of
+  // the file is current is up to the caller.
+  atl::Status Load(uint64_t* generation);
+
+  // Checks the magic & the checksum of the data of the file of a derived
+  // index, but not its generation: for readers which don't load the log
+  // index. The payload (what Encode() wrote) points into data.
+  static atl::Status ParseFile(const std::string& path, uint32_t magic,
+                               atl::StringView data, uint64_t* generation,
+                               atl::StringView* payload);
+  atl::Status Save(uint64_t generation) const;
+
+  // Recomputes the index from all logs of the index.
+  virtual void Rebuild(const Index& index);
+
+  // The fields of the logs a rebuild needs (besides id & created_at). The
+  // index is outdated by a change of any of them.
+  virtual LogFields fields() const { return kAllFields; }
+
+  const std::string& path() const { return path_; }
+
+ protected:
+  virtual void Clear() = 0;
+  virtual void Encode(std::string* out) const = 0;
+  virtual bool Decode(atl::Decoder* in) = 0;
+
+ private:
+  const std::string path_;
+  const uint32_t magic_;
+};
+
+}  // namespace worklog
+
+#endif  // DERIVED_INDEX_H_
@@ -1,22 +1,19 @@
 #ifndef FILTER_H_
 #define FILTER_H_
-#include <set>
 #include <functional>
 
-namespace worklog {
-struct Filter {
-  std::set<std::string> tags;
-  std::set<std::string> tags_negative;
-  std::string subject;
-};
+#include "column_index.h"
+#include "worklog.h"
 
-Filter ParseFilter(const std::string& text);
-void ApplyFilter(std::function<bool(const worklog::Log&)> apply_func, std::vector<worklog::Log>* logs);
+namespace worklog {
 
-std::function<bool(const worklog::Log&)> SubjectFilter(const Filter& filter);
-std::function<bool(const worklog::Log&)> TagsFilter(const Filter& filter);
-std::function<bool(const worklog::Log&)> OnlyValidFilter();
-std::function<bool(const worklog::Log&)> OnlyInvalidFilter();
+// The validity is looked up in the validity bitmap of the columns instead
+// of validating the logs again. The columns are captured by reference and
+// must outlive the function.
+std::function<bool(const worklog::Log&)> OnlyValidFilter(
+    const ColumnIndex& columns);
+std::function<bool(const worklog::Log&)> OnlyInvalidFilter(
+    const ColumnIndex& columns);
 
 } // namespace worklog
 #endif  // FILTER_H_
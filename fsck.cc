@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "atl/crc32c.h"
+#include "atl/dir.h"
+#include "atl/file.h"
+#include "atl/optional.h"
+#include "atl/string.h"
+
+#include "fsck.h"
+#include "index.h"
+
+namespace worklog {
+
+namespace {
+using Kind = FsckIssue::Kind;
+
+FsckIssue MakeIssue(Kind kind, int id, const std::string& message) {
+  FsckIssue issue;
+  issue.kind = kind;
+  issue.id = id;
+  issue.message = message;
+  return issue;
+}
+
+// Checks a single log file against its index entry (entry may be null).
+void CheckLog(const Config& config, int id, const IndexEntry* entry,
+              std::vector<FsckIssue>* issues) {
+  std::string log_path =
+      atl::JoinStr("/", config.logs_dir, std::to_string(id));
+
+  if (entry == nullptr) {
+    issues->push_back(MakeIssue(Kind::kUnindexed, id, "not indexed yet"));
+    return;
+  }
+
+  atl::Optional<atl::FileStat> stat = atl::StatFile(log_path);
+  atl::Optional<std::string> content = atl::FileReadContent(log_path);
+  if (!stat || !content) {
+    issues->push_back(
+        MakeIssue(Kind::kUnreadable, id, "failed to read " + log_path));
+    return;
+  }
+
+  if (stat->mtime_ns != entry->mtime_ns || stat->size != entry->size) {
+    issues->push_back(MakeIssue(Kind::kStale, id, "changed since indexed"));
+    return;
+  }
+
+  if (atl::Crc32c(content.value()) != entry->crc32c) {
+    issues->push_back(MakeIssue(
+        Kind::kCorrupted, id,
+        "checksum mismatch, the content changed but the mtime didn't"));
+    return;
+  }
+
+  atl::Status valid_check = Validate(entry->log);
+  if (!valid_check.ok()) {
+    issues->push_back(
+        MakeIssue(Kind::kInvalid, id, valid_check.error_message()));
+  }
+}
+
+void CheckNextId(const Config& config, int max_id,
+                 std::vector<FsckIssue>* issues) {
+  atl::Optional<std::string> content = atl::FileReadContent(config.NextIdPath());
+  if (!content) {
+    issues->push_back(MakeIssue(Kind::kNextId, 0, "failed to read next_id"));
+    return;
+  }
+
+  atl::Optional<int> next_id = atl::ParseInt(atl::TrimSpace(content.value()));
+  if (!next_id || next_id.value() <= 0) {
+    issues->push_back(
+        MakeIssue(Kind::kNextId, 0, "next_id is not a positive number"));
+    return;
+  }
+
+  if (next_id.value() <= max_id) {
+    issues->push_back(MakeIssue(
+        Kind::kNextId, 0,
+        "next_id " + std::to_string(next_id.value()) +
+            " is not above the highest id " + std::to_string(max_id) +
+            ", new logs would collide"));
+  }
+}
+}  // namespace
+
+std::string FsckIssueKindName(FsckIssue::Kind kind) {
+  switch (kind) {
+    case Kind::kCorrupted:
+      return "corrupted";
+    case Kind::kUnreadable:
+      return "unreadable";
+    case Kind::kMissing:
+      return "missing";
+    case Kind::kUnindexed:
+      return "unindexed";
+    case Kind::kStale:
+      return "stale";
+    case Kind::kInvalid:
+      return "invalid";
+    case Kind::kIndex:
+      return "index";
+    case Kind::kNextId:
+      return "next_id";
+  }
+  return "unknown";
+}
+
+std::vector<FsckIssue> Fsck(const Config& config, unsigned int num_threads) {
+  std::vector<FsckIssue> issues;
+
+  Index index(config);
+  atl::Status status = index.Load();
+  if (!status.ok()) {
+    issues.push_back(MakeIssue(Kind::kIndex, 0, status.error_message()));
+  }
+
+  std::vector<int> ids;
+  atl::ListDir(config.logs_dir, [&ids](const atl::DirEntry& file) -> bool {
+    if (file.type != atl::EntryType::kFile) {
+      return true;
+    }
+
+    atl::Optional<int> id = atl::ParseInt(file.name);
+    if (id) {
+      ids.push_back(id.value());
+    }
+    return true;
+  });
+
+  std::sort(ids.begin(), ids.end());
+
+  int max_id = ids.empty() ? 0 : ids.back();
+  for (const auto& entry : index.entries()) {
+    if (!std::binary_search(ids.begin(), ids.end(), entry.first)) {
+      issues.push_back(MakeIssue(Kind::kMissing, entry.first,
+                                 "indexed but the log file is gone"));
+    }
+  }
+
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (num_threads > ids.size()) {
+    num_threads = std::max<std::size_t>(1, ids.size());
+  }
+
+  // The logs are handed out in small chunks, so a few large logs don't
+  // leave the other threads idle:
+  const std::size_t kChunkSize = 64;
+  std::atomic<std::size_t> next_chunk(0);
+  std::mutex issues_mutex;
+
+  auto worker = [&]() {
+    std::vector<FsckIssue> local_issues;
+
+    for (;;) {
+      std::size_t begin = next_chunk.fetch_add(kChunkSize);
+      if (begin >= ids.size()) {
+        break;
+      }
+
+      std::size_t end = std::min(begin + kChunkSize, ids.size());
+      for (std::size_t i = begin; i < end; i++) {
+        auto found = index.entries().find(ids[i]);
+        const IndexEntry* entry =
+            found == index.entries().end() ? nullptr : &found->second;
+        CheckLog(config, ids[i], entry, &local_issues);
+      }
+    }
+
+    std::lock_guard<std::mutex> guard(issues_mutex);
+    issues.insert(issues.end(), local_issues.begin(), local_issues.end());
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int i = 1; i < num_threads; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  CheckNextId(config, max_id, &issues);
+
+  std::stable_sort(issues.begin(), issues.end(),
+                   [](const FsckIssue& a, const FsckIssue& b) {
+                     return a.id < b.id;
+                   });
+
+  return issues;
+}
+
+}  // namespace worklog
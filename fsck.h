@@ -0,0 +1,43 @@
+#ifndef FSCK_H_
+#define FSCK_H_
+
+#include <string>
+#include <vector>
+
+#include "worklog.h"
+
+namespace worklog {
+
+struct FsckIssue {
+  enum class Kind {
+    kCorrupted,   // content changed but mtime & size didn't (bit rot)
+    kUnreadable,  // the log file could not be read
+    kMissing,     // indexed but the log file is gone
+    kUnindexed,   // the log file is not in the index yet
+    kStale,       // the log file changed since it has been indexed
+    kInvalid,     // the indexed log doesn't pass Validate
+    kIndex,       // the index itself is corrupted
+    kNextId,      // next_id is unreadable or not above the highest id
+  };
+
+  Kind kind;
+  int id = 0;
+  std::string message;
+
+  // Stale & unindexed logs are picked up by the next index refresh and
+  // therefore are no errors.
+  bool IsError() const {
+    return kind != Kind::kStale && kind != Kind::kUnindexed;
+  }
+};
+
+// Verifies the work log space without parsing a single log: the file
+// checksums are compared against the index in parallel on num_threads
+// threads (0 = one per core). Issues are returned sorted by id.
+std::vector<FsckIssue> Fsck(const Config& config, unsigned int num_threads = 0);
+
+std::string FsckIssueKindName(FsckIssue::Kind kind);
+
+}  // namespace worklog
+
+#endif  // FSCK_H_
@@ -0,0 +1,685 @@
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "atl/coding.h"
+#include "atl/crc32c.h"
+#include "atl/dir.h"
+#include "atl/file.h"
+#include "atl/lock.h"
+#include "atl/optional.h"
+#include "atl/string.h"
+
+#include "index.h"
+
+namespace worklog {
+
+namespace {
+// "WLIX" followed by the format version. Version 3 re-parses the logs
+// whose created_at was shifted by the DST bug of atl::ParseTime, version 4
+// moved the descriptions into their own section, version 5 added the
+// metadata (which older versions didn't parse), version 6 the last
+// changes of the fields & the journal. Version 7 re-parses the logs whose
+// description lines with a '=' were taken for fields.
+constexpr uint32_t kIndexMagic = 0x58494c57;
+constexpr uint32_t kIndexVersion = 7;
+
+// magic | version | generation | number of entries | size of the headers |
+// size of the descriptions | generation of the last change of every field
+constexpr uint64_t kIndexHeaderSize = 88;
+
+// Every record is at least its length prefix & its crc32c, which bounds the
+// number of entries a header can claim before anything is allocated.
+constexpr uint64_t kMinRecordSize = 5;
+
+// The journal keeps the changes of the latest generations up to this size.
+// A derived index which is older than all of them is rebuilt instead.
+constexpr std::size_t kMaxJournalSize = 1 << 22;
+
+struct Header {
+  uint32_t version = 0;
+  IndexState state;
+  uint64_t num_entries = 0;
+  uint64_t headers_size = 0;
+  uint64_t descriptions_size = 0;
+};
+
+// Also returns the generation of older versions (false then), so the
+// generations keep growing across versions.
+bool DecodeHeader(atl::StringView data, Header* header) {
+  atl::Decoder in(data);
+
+  uint32_t magic = 0;
+  if (!in.GetFixed32(&magic) || magic != kIndexMagic ||
+      !in.GetFixed32(&header->version) ||
+      !in.GetFixed64(&header->state.generation)) {
+    header->state.generation = 0;
+    return false;
+  }
+
+  if (header->version != kIndexVersion || !in.GetFixed64(&header->num_entries) ||
+      !in.GetFixed64(&header->headers_size) ||
+      !in.GetFixed64(&header->descriptions_size)) {
+    return false;
+  }
+
+  for (auto& generation : header->state.last_changed) {
+    if (!in.GetFixed64(&generation)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The descriptions are stored after the headers of all logs, so loading
+// without them (see LogFields) only reads the first part of the file.
+void EncodeEntry(const IndexEntry& entry, std::string* dst) {
+  const Log& log = entry.log;
+
+  atl::PutVarint32(dst, log.id);
+  atl::PutFixed64(dst, log.created_at);
+  atl::PutFixed64(dst, entry.mtime_ns);
+  atl::PutFixed64(dst, entry.size);
+  atl::PutFixed32(dst, entry.crc32c);
+  atl::PutLengthPrefixed(dst, log.subject);
+
+  atl::PutVarint32(dst, log.tags.size());
+  for (const auto& tag : log.tags) {
+    atl::PutLengthPrefixed(dst, tag);
+  }
+
+  atl::PutVarint32(dst, log.metadata.size());
+  for (const auto& field : log.metadata) {
+    atl::PutLengthPrefixed(dst, field.first);
+    atl::PutLengthPrefixed(dst, field.second);
+  }
+
+  atl::PutVarint64(dst, log.description.size());
+}
+
+bool DecodeEntry(atl::Decoder* in, LogFields fields, IndexEntry* entry) {
+  Log& log = entry->log;
+
+  uint32_t id = 0;
+  uint32_t num_tags = 0;
+  uint32_t num_fields = 0;
+  uint64_t description_size = 0;
+  atl::StringView subject;
+
+  if (!in->GetVarint32(&id) || !in->GetFixed64(&log.created_at) ||
+      !in->GetFixed64(&entry->mtime_ns) || !in->GetFixed64(&entry->size) ||
+      !in->GetFixed32(&entry->crc32c) ||
+      !in->GetLengthPrefixed(&subject) || !in->GetVarint32(&num_tags)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < num_tags; i++) {
+    atl::StringView tag;
+    if (!in->GetLengthPrefixed(&tag)) {
+      return false;
+    }
+
+    if (fields & kFieldTags) {
+      log.tags.insert(tag.to_string());
+    }
+  }
+
+  if (!in->GetVarint32(&num_fields)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < num_fields; i++) {
+    atl::StringView key;
+    atl::StringView value;
+    if (!in->GetLengthPrefixed(&key) || !in->GetLengthPrefixed(&value)) {
+      return false;
+    }
+
+    if (fields & kFieldMetadata) {
+      log.metadata.emplace_hint(log.metadata.end(), key.to_string(),
+                                value.to_string());
+    }
+  }
+
+  if (!in->GetVarint64(&description_size)) {
+    return false;
+  }
+
+  log.id = static_cast<int>(id);
+  if (fields & kFieldSubject) {
+    log.subject = subject.to_string();
+  }
+  log.has_description =
+      (fields & kFieldHasDescription) != 0 && description_size > 0;
+  return true;
+}
+
+// Every record is stored length prefixed and followed by its crc32c, so a
+// torn or corrupted index is detected on load (and then rebuilt).
+void EncodeRecord(const IndexEntry& entry, std::string* dst) {
+  std::string record;
+  EncodeEntry(entry, &record);
+
+  atl::PutLengthPrefixed(dst, record);
+  atl::PutFixed32(dst, atl::Crc32c(record));
+}
+
+bool DecodeRecord(atl::Decoder* in, LogFields fields, IndexEntry* entry) {
+  atl::StringView record;
+  uint32_t crc = 0;
+  if (!in->GetLengthPrefixed(&record) || !in->GetFixed32(&crc) ||
+      atl::Crc32c(record) != crc) {
+    return false;
+  }
+
+  atl::Decoder record_in(record);
+  return DecodeEntry(&record_in, fields, entry);
+}
+
+// generation | id | changed fields | whether the log existed | the old log
+// with its description if it did
+void EncodeChange(const IndexChange& change, std::string* dst) {
+  atl::PutFixed64(dst, change.generation);
+  atl::PutVarint32(dst, change.id);
+  atl::PutVarint32(dst, change.fields);
+  atl::PutVarint32(dst, change.existed ? 1 : 0);
+  if (change.existed) {
+    EncodeEntry(change.old_entry, dst);
+    atl::PutLengthPrefixed(dst, change.old_entry.log.description);
+  }
+}
+
+bool DecodeChange(atl::Decoder* in, IndexChange* change) {
+  uint32_t id = 0;
+  uint32_t existed = 0;
+  if (!in->GetFixed64(&change->generation) || !in->GetVarint32(&id) ||
+      !in->GetVarint32(&change->fields) || !in->GetVarint32(&existed)) {
+    return false;
+  }
+
+  change->id = static_cast<int>(id);
+  change->existed = existed != 0;
+  if (!change->existed) {
+    return true;
+  }
+
+  atl::StringView description;
+  if (!DecodeEntry(in, kAllFields, &change->old_entry) ||
+      !in->GetLengthPrefixed(&description)) {
+    return false;
+  }
+  change->old_entry.log.description = description.to_string();
+  change->old_entry.log.has_description = !description.empty();
+  return true;
+}
+
+bool HasDescription(const Log& log) {
+  return log.has_description || !log.description.empty();
+}
+}  // namespace
+
+LogFields ChangedFields(const Log& a, const Log& b) {
+  LogFields fields = 0;
+  if (a.id != b.id || a.created_at != b.created_at) {
+    fields |= kFieldIdentity;
+  }
+  if (a.tags != b.tags) {
+    fields |= kFieldTags;
+  }
+  if (a.subject != b.subject) {
+    fields |= kFieldSubject;
+  }
+  if (HasDescription(a) != HasDescription(b)) {
+    fields |= kFieldHasDescription;
+  }
+  if (a.description != b.description) {
+    fields |= kFieldDescription;
+  }
+  if (a.metadata != b.metadata) {
+    fields |= kFieldMetadata;
+  }
+  return fields;
+}
+
+uint64_t IndexState::LastChange(LogFields fields) const {
+  uint64_t generation = 0;
+  for (std::size_t bit = 0; bit < last_changed.size(); bit++) {
+    if (fields & (1u << bit)) {
+      generation = std::max(generation, last_changed[bit]);
+    }
+  }
+  return generation;
+}
+
+bool IndexState::IsCurrent(uint64_t derived_generation,
+                           LogFields fields) const {
+  return derived_generation == generation ||
+         (derived_generation < generation &&
+          LastChange(fields | kFieldIdentity) <= derived_generation);
+}
+
+std::string Index::LogPath(int id) const {
+  return atl::JoinStr("/", config_.logs_dir, std::to_string(id));
+}
+
+atl::Status Index::Load(LogFields fields) {
+  entries_.clear();
+  arena_.Reset();
+  fields_ = fields;
+  state_ = IndexState();
+  dirty_ = false;
+  journal_offset_ = 0;
+  journal_loaded_ = false;
+  journal_base_ = 0;
+  journal_.clear();
+  pending_.clear();
+
+  atl::Status tombstones_status = tombstones_.Load();
+  if (!tombstones_status.ok()) {
+    return tombstones_status;
+  }
+
+  if (!atl::FileExists(config_.IndexPath())) {
+    return atl::Status();
+  }
+
+  const std::string& path = config_.IndexPath();
+  auto corrupted = [this, &path]() {
+    entries_.clear();
+    arena_.Reset();
+    journal_offset_ = 0;
+    return atl::Status(atl::error::DATA_LOSS, "Corrupted index: " + path);
+  };
+
+  atl::Optional<std::string> header_data =
+      atl::FileReadRange(path, 0, kIndexHeaderSize);
+  Header header;
+  if (!header_data || !DecodeHeader(header_data.value(), &header)) {
+    // Only the generation of an older version is kept, so it agrees with
+    // ReadState() and the rebuilt index continues it:
+    state_.generation = header.state.generation;
+    return atl::Status(atl::error::DATA_LOSS, "Unknown index format: " + path);
+  }
+  state_ = header.state;
+
+  // The sizes in the header aren't checksummed, a torn or corrupted header
+  // must not make the reads below allocate whatever it claims:
+  atl::Optional<atl::FileStat> stat = atl::StatFile(path);
+  if (!stat || stat->size < kIndexHeaderSize ||
+      header.headers_size > stat->size - kIndexHeaderSize ||
+      header.descriptions_size >
+          stat->size - kIndexHeaderSize - header.headers_size ||
+      header.num_entries > header.headers_size / kMinRecordSize) {
+    return corrupted();
+  }
+
+  atl::Optional<std::string> headers =
+      atl::FileReadRange(path, kIndexHeaderSize, header.headers_size);
+  if (!headers) {
+    return corrupted();
+  }
+
+  // Every record holds the header fields of a log:
+  std::vector<IndexEntry*> order;
+  order.reserve(header.num_entries);
+
+  atl::Decoder in(headers.value());
+  for (uint64_t i = 0; i < header.num_entries; i++) {
+    IndexEntry entry;
+    if (!DecodeRecord(&in, fields, &entry)) {
+      return corrupted();
+    }
+
+    int id = entry.log.id;
+    order.push_back(&entries_.emplace(id, std::move(entry)).first->second);
+  }
+
+  if (!in.empty()) {
+    return corrupted();
+  }
+
+  const uint64_t descriptions_offset = kIndexHeaderSize + header.headers_size;
+  journal_offset_ = descriptions_offset + header.descriptions_size;
+  if ((fields & kFieldDescription) == 0) {
+    return atl::Status();
+  }
+
+  // The descriptions follow in the same order, checksummed as a whole:
+  atl::Optional<std::string> descriptions = atl::FileReadRange(
+      path, descriptions_offset, header.descriptions_size);
+  if (!descriptions || descriptions->size() < 4 ||
+      descriptions->size() != header.descriptions_size) {
+    return corrupted();
+  }
+
+  const std::string& data = descriptions.value();
+  atl::StringView body(data.data(), data.size() - 4);
+  atl::Decoder crc_in(atl::StringView(data.data() + body.size(), 4));
+
+  uint32_t crc = 0;
+  if (!crc_in.GetFixed32(&crc) || atl::Crc32c(body) != crc) {
+    return corrupted();
+  }
+
+  atl::Decoder descriptions_in(body);
+  for (IndexEntry* entry : order) {
+    atl::StringView description;
+    if (!descriptions_in.GetLengthPrefixed(&description)) {
+      return corrupted();
+    }
+    entry->log.description = description.to_string();
+  }
+
+  if (!descriptions_in.empty()) {
+    return corrupted();
+  }
+
+  return atl::Status();
+}
+
+atl::Status Index::LoadJournal() {
+  if (journal_loaded_) {
+    return atl::Status();
+  }
+
+  const std::string& path = config_.IndexPath();
+  atl::Optional<atl::FileStat> stat = atl::StatFile(path);
+  if (journal_offset_ == 0 || !stat || stat->size < journal_offset_ + 4) {
+    return atl::Status(atl::error::NOT_FOUND, "No journal in: " + path);
+  }
+
+  atl::Optional<std::string> data =
+      atl::FileReadRange(path, journal_offset_, stat->size - journal_offset_);
+  if (!data) {
+    return atl::Status(atl::error::INTERNAL, "Failed to read: " + path);
+  }
+
+  atl::StringView body(data->data(), data->size() - 4);
+  atl::Decoder crc_in(atl::StringView(data->data() + body.size(), 4));
+  uint32_t crc = 0;
+  if (!crc_in.GetFixed32(&crc) || atl::Crc32c(body) != crc) {
+    return atl::Status(atl::error::DATA_LOSS, "Corrupted journal: " + path);
+  }
+
+  // The snapshot on disk might not be the loaded one anymore:
+  atl::Decoder in(body);
+  uint64_t generation = 0;
+  uint64_t num_changes = 0;
+  if (!in.GetFixed64(&generation) || generation != state_.generation ||
+      !in.GetFixed64(&journal_base_) || !in.GetVarint64(&num_changes) ||
+      num_changes > in.remaining()) {
+    return atl::Status(atl::error::FAILED_PRECONDITION,
+                       "The index has been replaced: " + path);
+  }
+
+  std::vector<IndexChange> journal(num_changes);
+  for (auto& change : journal) {
+    if (!DecodeChange(&in, &change)) {
+      return atl::Status(atl::error::DATA_LOSS, "Corrupted journal: " + path);
+    }
+  }
+
+  journal_.swap(journal);
+  journal_loaded_ = true;
+  return atl::Status();
+}
+
+atl::Status Index::Update(const std::vector<int>& ids, bool* reloaded) {
+  *reloaded = false;
+
+  // Concurrent writers are serialized, readers are never blocked because
+  // the index is replaced atomically (see worklog.h):
+  atl::FileLock lock(config_.LockPath(), kIndexLockOffset,
+                     atl::FileLock::Mode::kExclusive);
+  if (!lock) {
+    return atl::Status(atl::error::UNAVAILABLE, "Failed to lock the index");
+  }
+
+  // Another process might have written a newer snapshot in the meantime.
+  // The changes are applied to that one instead, so the journal continues
+  // its history (the listeners saw the changes relative to the old one):
+  if (ReadState(config_).generation != state_.generation) {
+    atl::Status load_status = Load(kAllFields);
+    listeners_.clear();
+    *reloaded = true;
+    if (!load_status.ok()) {
+      return load_status;
+    }
+  }
+
+  for (int id : ids) {
+    Touch(id);
+  }
+
+  if (!dirty_) {
+    return atl::Status();
+  }
+  return Save();
+}
+
+atl::Status Index::Save() {
+  // The descriptions which haven't been loaded would be lost:
+  if (fields_ != kAllFields) {
+    return atl::Status(atl::error::FAILED_PRECONDITION,
+                       "Can't save an index loaded without all fields");
+  }
+
+  // A failed Load() leaves the generation at 0, it must keep growing:
+  const uint64_t generation =
+      std::max(state_.generation, ReadState(config_).generation) + 1;
+
+  // Without the journal of the loaded snapshot (ie. it couldn't be loaded)
+  // the history starts over: every derived index is outdated then.
+  if (!LoadJournal().ok()) {
+    journal_.clear();
+    pending_.clear();
+    journal_base_ = generation;
+    state_.last_changed.fill(generation);
+  }
+
+  for (auto& change : pending_) {
+    change.generation = generation;
+    for (std::size_t bit = 0; bit < state_.last_changed.size(); bit++) {
+      if (change.fields & (1u << bit)) {
+        state_.last_changed[bit] = generation;
+      }
+    }
+    journal_.push_back(std::move(change));
+  }
+  pending_.clear();
+
+  // The oldest generations are dropped as a whole once the journal gets
+  // too large:
+  std::vector<std::string> changes(journal_.size());
+  std::size_t journal_size = 0;
+  for (std::size_t i = 0; i < journal_.size(); i++) {
+    EncodeChange(journal_[i], &changes[i]);
+    journal_size += changes[i].size();
+  }
+
+  std::size_t first = 0;
+  while (first < journal_.size() && journal_size > kMaxJournalSize) {
+    journal_base_ = journal_[first].generation;
+    for (; first < journal_.size() &&
+           journal_[first].generation == journal_base_;
+         first++) {
+      journal_size -= changes[first].size();
+    }
+  }
+  journal_.erase(journal_.begin(), journal_.begin() + first);
+
+  std::string headers;
+  std::string descriptions;
+  for (const auto& entry : entries_) {
+    EncodeRecord(entry.second, &headers);
+    atl::PutLengthPrefixed(&descriptions, entry.second.log.description);
+  }
+  atl::PutFixed32(&descriptions, atl::Crc32c(descriptions));
+
+  std::string journal;
+  atl::PutFixed64(&journal, generation);
+  atl::PutFixed64(&journal, journal_base_);
+  atl::PutVarint64(&journal, journal_.size());
+  for (std::size_t i = first; i < changes.size(); i++) {
+    journal += changes[i];
+  }
+  atl::PutFixed32(&journal, atl::Crc32c(journal));
+
+  std::string out;
+  atl::PutFixed32(&out, kIndexMagic);
+  atl::PutFixed32(&out, kIndexVersion);
+  atl::PutFixed64(&out, generation);
+  atl::PutFixed64(&out, entries_.size());
+  atl::PutFixed64(&out, headers.size());
+  atl::PutFixed64(&out, descriptions.size());
+  for (uint64_t last_changed : state_.last_changed) {
+    atl::PutFixed64(&out, last_changed);
+  }
+  out += headers;
+  out += descriptions;
+  const uint64_t journal_offset = out.size();
+  out += journal;
+
+  if (!atl::FileWriteContentAtomic(config_.IndexPath(), out)) {
+    return atl::Status(atl::error::INTERNAL,
+                       "Failed to write index: " + config_.IndexPath());
+  }
+
+  state_.generation = generation;
+  journal_offset_ = journal_offset;
+  dirty_ = false;
+  return atl::Status();
+}
+
+IndexState Index::ReadState(const Config& config) {
+  Header header;
+  atl::Optional<std::string> data =
+      atl::FileReadRange(config.IndexPath(), 0, kIndexHeaderSize);
+  if (data) {
+    DecodeHeader(data.value(), &header);
+  }
+  return header.state;
+}
+
+bool Index::ParseEntry(int id, IndexEntry* entry) {
+  std::string log_path = LogPath(id);
+
+  atl::Optional<atl::FileStat> stat = atl::StatFile(log_path);
+  if (!stat) {
+    return false;
+  }
+
+  atl::Optional<std::string> content = atl::FileReadContent(log_path);
+  if (!content) {
+    return false;
+  }
+
+  entry->log = hs_.Unserialize(content.value());
+  entry->log.id = id;
+  entry->mtime_ns = stat->mtime_ns;
+  entry->size = stat->size;
+  entry->crc32c = atl::Crc32c(content.value());
+  return true;
+}
+
+std::vector<int> Index::Sweep() const {
+  std::vector<int> changed;
+  std::vector<int> seen;
+  seen.reserve(entries_.size());
+
+  // The path buffer is reused, the sweep runs over every log of every
+  // command and shouldn't allocate per log:
+  std::string path = config_.logs_dir + "/";
+  const std::size_t dir_size = path.size();
+
+  atl::ListDir(config_.logs_dir, [&](const atl::DirEntry& file) -> bool {
+    if (file.type != atl::EntryType::kFile) {
+      return true;
+    }
+
+    atl::Optional<int> id = atl::ParseInt(file.name);
+    if (!id) {
+      return true;
+    }
+
+    seen.push_back(id.value());
+
+    auto found = entries_.find(id.value());
+    if (found != entries_.end()) {
+      path.resize(dir_size);
+      path += std::to_string(id.value());
+
+      atl::Optional<atl::FileStat> stat = atl::StatFile(path);
+      if (stat && stat->mtime_ns == found->second.mtime_ns &&
+          stat->size == found->second.size) {
+        return true;
+      }
+    }
+
+    changed.push_back(id.value());
+    return true;
+  });
+
+  // Both are sorted by id now, the entries missing from seen are gone:
+  std::sort(seen.begin(), seen.end());
+  auto it = seen.begin();
+  for (const auto& entry : entries_) {
+    while (it != seen.end() && *it < entry.first) {
+      ++it;
+    }
+    if (it == seen.end() || *it != entry.first) {
+      changed.push_back(entry.first);
+    }
+  }
+
+  return changed;
+}
+
+void Index::Touch(int id) {
+  auto found = entries_.find(id);
+
+  IndexEntry entry;
+  if (!ParseEntry(id, &entry)) {
+    if (found != entries_.end()) {
+      for (auto* listener : listeners_) {
+        listener->OnErase(found->second.log);
+      }
+
+      RecordChange(id, &found->second, kAllFields | kFieldIdentity);
+      entries_.erase(found);
+      dirty_ = true;
+    }
+    return;
+  }
+
+  const Log* old_log = found == entries_.end() ? nullptr : &found->second.log;
+  for (auto* listener : listeners_) {
+    listener->OnPut(old_log, entry.log);
+  }
+
+  // Only the changes which matter to the derived indexes are recorded,
+  // touching an unchanged log just updates its file state:
+  if (old_log == nullptr) {
+    RecordChange(id, nullptr, kAllFields | kFieldIdentity);
+  } else if (LogFields changed = ChangedFields(*old_log, entry.log)) {
+    RecordChange(id, &found->second, changed);
+  }
+
+  entries_[id] = std::move(entry);
+  dirty_ = true;
+}
+
+void Index::RecordChange(int id, const IndexEntry* old_entry,
+                         LogFields fields) {
+  IndexChange change;
+  change.id = id;
+  change.fields = fields;
+  change.existed = old_entry != nullptr;
+  if (old_entry != nullptr) {
+    change.old_entry = *old_entry;
+  }
+  pending_.push_back(std::move(change));
+}
+
+}  // namespace worklog
@@ -0,0 +1,176 @@
+#ifndef INDEX_H_
+#define INDEX_H_
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "atl/arena.h"
+#include "atl/status.h"
+
+#include "serializer.h"
+#include "tombstone.h"
+#include "worklog.h"
+
+namespace worklog {
+
+struct IndexEntry {
+  Log log;
+
+  // The file state the log was parsed from. If any of them differs from
+  // the file on disk the log gets re-parsed.
+  uint64_t mtime_ns = 0;
+  uint64_t size = 0;
+
+  // crc32c of the file content, used by fsck to detect corrupted logs
+  // whose mtime & size didn't change.
+  uint32_t crc32c = 0;
+};
+
+// Stands for the id & created_at in the fields of a change: a log which is
+// created, removed or moved in time changes every derived index.
+constexpr LogFields kFieldIdentity = 1 << 5;
+
+// The fields which differ between the two logs, for the journal.
+LogFields ChangedFields(const Log& a, const Log& b);
+
+// The generation of an index and the generation at which each field of any
+// of its logs last changed.
+struct IndexState {
+  uint64_t generation = 0;
+  std::array<uint64_t, 6> last_changed = {};  // by bit of the fields
+
+  uint64_t LastChange(LogFields fields) const;
+
+  // Whether an index derived from the given fields which has been saved at
+  // the generation is still current: none of them changed since.
+  bool IsCurrent(uint64_t derived_generation, LogFields fields) const;
+};
+
+// A change of a log recorded in the journal of the index: the log as it
+// was before (unless it is new) and which of its fields changed.
+struct IndexChange {
+  uint64_t generation = 0;  // 0 until saved
+  int id = 0;
+  LogFields fields = 0;
+  bool existed = false;
+  IndexEntry old_entry;
+};
+
+// The entries of an index are allocated from its arena (see atl::Arena):
+// they are loaded and dropped together, one map node per log would
+// otherwise be one heap allocation per log.
+using IndexEntries =
+    std::map<int, IndexEntry, std::less<int>,
+             atl::ArenaAllocator<std::pair<const int, IndexEntry>>>;
+
+// IndexListener gets notified about every change of the index, so derived
+// indexes (see DerivedIndex) can be maintained incrementally.
+class IndexListener {
+ public:
+  virtual ~IndexListener() {}
+
+  // old_log is null if the log is new.
+  virtual void OnPut(const Log* old_log, const Log& log) = 0;
+  virtual void OnErase(const Log& old_log) = 0;
+};
+
+// Index is a persistent cache of the parsed work logs which is stored
+// under .worklog/index. Only logs which have been created, changed or
+// deleted since the index has been written are (re-)parsed.
+//
+// Every Update() writes a new snapshot with a higher generation number.
+// Readers work on the snapshot they loaded and never block writers.
+//
+// The snapshot also holds a journal of the latest changes, so derived
+// indexes which weren't loaded by a write can catch up with it later
+// instead of being rebuilt (see IndexSet).
+class Index {
+ public:
+  explicit Index(const Config& config)
+      : config_(config),
+        entries_(IndexEntries::allocator_type(&arena_)),
+        tombstones_(config) {}
+
+  Index(const Index&) = delete;
+  Index& operator=(const Index&) = delete;
+
+  // Loads the index from disk. A missing index is not an error, it is
+  // treated as an empty one (and the first sweep fills it then). Without
+  // kFieldDescription the descriptions are not even read, but such an
+  // index can't be saved.
+  atl::Status Load(LogFields fields = kAllFields);
+
+  // Re-parses the given logs and saves the index, holding the index lock
+  // throughout. If another process saved a newer snapshot since Load() it
+  // is loaded first (reloaded is set then and the listeners are dropped),
+  // so the generations form a single history.
+  atl::Status Update(const std::vector<int>& ids, bool* reloaded);
+
+  // Reads the state of the index on disk without loading it.
+  static IndexState ReadState(const Config& config);
+
+  // Loads the journal of the snapshot. Fails if the file has been replaced
+  // since the index has been loaded.
+  atl::Status LoadJournal();
+
+  // The changes with a generation above journal_base() in the order they
+  // happened, older ones have been dropped.
+  const std::vector<IndexChange>& journal() const { return journal_; }
+  uint64_t journal_base() const { return journal_base_; }
+
+  // Compares the mtime & size of every log file with the index (mtime
+  // sweep) and returns the ids of the new, changed and removed logs.
+  std::vector<int> Sweep() const;
+
+  // Re-parses a single log from disk or drops it if the file is gone.
+  void Touch(int id);
+
+  void AddListener(IndexListener* listener) { listeners_.push_back(listener); }
+  void RemoveListeners() { listeners_.clear(); }
+
+  const IndexEntries& entries() const { return entries_; }
+  bool IsDeleted(int id) const { return tombstones_.Contains(id); }
+  const Tombstones& tombstones() const { return tombstones_; }
+  LogFields fields() const { return fields_; }
+  uint64_t generation() const { return state_.generation; }
+  const IndexState& state() const { return state_; }
+  bool dirty() const { return dirty_; }
+
+ private:
+  std::string LogPath(int id) const;
+  bool ParseEntry(int id, IndexEntry* entry);
+
+  // Writes a new snapshot with the pending changes added to the journal.
+  // The index lock has to be held.
+  atl::Status Save();
+
+  void RecordChange(int id, const IndexEntry* old_entry, LogFields fields);
+
+  Config config_;
+  HumanSerializer hs_;
+
+  // The nodes of erased entries are only reclaimed by the next Load().
+  atl::Arena arena_;
+  IndexEntries entries_;
+  Tombstones tombstones_;
+  std::vector<IndexListener*> listeners_;
+  LogFields fields_ = kAllFields;
+  IndexState state_;
+  bool dirty_ = false;
+
+  // Where the journal starts in the file.
+  uint64_t journal_offset_ = 0;
+  bool journal_loaded_ = false;
+  uint64_t journal_base_ = 0;
+  std::vector<IndexChange> journal_;
+
+  // The changes since the last save, their generation is set by Save().
+  std::vector<IndexChange> pending_;
+};
+
+}  // namespace worklog
+
+#endif  // INDEX_H_
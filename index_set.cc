@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <vector>
+
+#include "index_set.h"
+
+namespace worklog {
+
+IndexSet::IndexSet(const Config& config, LogFields fields)
+    : config_(config),
+      fields_(fields),
+      index_(config),
+      trigrams_(config),
+      inverted_index_(config),
+      time_index_(config),
+      columns_(config),
+      completions_(config),
+      signatures_(config),
+      aggregates_(config) {
+  derived_ = {&trigrams_, &inverted_index_, &time_index_, &columns_,
+              &completions_, &signatures_, &aggregates_};
+}
+
+atl::Status IndexSet::Open(const std::vector<int>& touched) {
+  atl::Status load_status = index_.Load(fields_);
+
+  std::vector<int> ids = index_.Sweep();
+  ids.insert(ids.end(), touched.begin(), touched.end());
+
+  atl::Status apply_status = Apply(ids);
+  return load_status.ok() ? apply_status : load_status;
+}
+
+atl::Status IndexSet::Load() { return index_.Load(fields_); }
+
+atl::Status IndexSet::Apply(const std::vector<int>& ids) {
+  if (ids.empty()) {
+    return atl::Status();
+  }
+
+  // The changed logs are parsed completely and the index can only be
+  // saved with all fields:
+  LoadFields(kAllFields);
+
+  std::vector<int> unique_ids(ids);
+  std::sort(unique_ids.begin(), unique_ids.end());
+  unique_ids.erase(std::unique(unique_ids.begin(), unique_ids.end()),
+                   unique_ids.end());
+
+  const uint64_t generation = index_.generation();
+  bool reloaded = false;
+  atl::Status status = index_.Update(unique_ids, &reloaded);
+
+  // The prepared indexes missed the changes of the other process:
+  if (reloaded) {
+    prepared_.clear();
+  }
+
+  if (!status.ok() || index_.generation() == generation) {
+    return status;
+  }
+
+  // The indexes which aren't prepared catch up on their next use:
+  const IndexState& state = index_.state();
+  for (auto* derived : derived_) {
+    if (prepared_.count(derived) == 0 ||
+        state.LastChange(derived->fields() | kFieldIdentity) !=
+            state.generation) {
+      continue;
+    }
+
+    atl::Status save_status = derived->Save(state.generation);
+    if (!save_status.ok()) {
+      return save_status;
+    }
+  }
+
+  return atl::Status();
+}
+
+void IndexSet::Prepare(DerivedIndex* derived) {
+  if (prepared_.count(derived) > 0) {
+    return;
+  }
+
+  uint64_t generation = 0;
+  bool loaded = derived->Load(&generation).ok();
+  if (!loaded || !index_.state().IsCurrent(generation, derived->fields())) {
+    LoadFields(derived->fields());
+
+    // A newer index than the log index (ie. the log index couldn't be
+    // loaded) can't be caught up either:
+    if (!loaded || generation > index_.generation() ||
+        !Replay(derived, generation).ok()) {
+      derived->Rebuild(index_);
+    }
+    derived->Save(index_.generation());
+  }
+
+  index_.AddListener(derived);
+  prepared_.insert(derived);
+}
+
+atl::Status IndexSet::Replay(DerivedIndex* derived, uint64_t generation) {
+  atl::Status status = index_.LoadJournal();
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (index_.journal_base() > generation) {
+    return atl::Status(atl::error::OUT_OF_RANGE,
+                       "The journal doesn't go back far enough");
+  }
+
+  // The first change of a log holds it as the derived index has seen it,
+  // the index holds it as it is now:
+  std::set<int> seen;
+  for (const auto& change : index_.journal()) {
+    if (change.generation <= generation || !seen.insert(change.id).second) {
+      continue;
+    }
+
+    auto found = index_.entries().find(change.id);
+    const Log* old_log = change.existed ? &change.old_entry.log : nullptr;
+    if (found != index_.entries().end()) {
+      derived->OnPut(old_log, found->second.log);
+    } else if (old_log != nullptr) {
+      derived->OnErase(*old_log);
+    }
+  }
+
+  return atl::Status();
+}
+
+void IndexSet::LoadFields(LogFields fields) {
+  if ((fields & ~index_.fields()) == 0) {
+    return;
+  }
+
+  // The prepared indexes stay valid if the reloaded index is at the same
+  // generation:
+  const uint64_t generation = index_.generation();
+  index_.Load(kAllFields);
+  if (index_.generation() != generation) {
+    index_.RemoveListeners();
+    prepared_.clear();
+  }
+}
+
+TrigramIndex& IndexSet::trigrams() {
+  Prepare(&trigrams_);
+  return trigrams_;
+}
+
+InvertedIndex& IndexSet::inverted_index() {
+  Prepare(&inverted_index_);
+  return inverted_index_;
+}
+
+TimeIndex& IndexSet::time_index() {
+  Prepare(&time_index_);
+  return time_index_;
+}
+
+ColumnIndex& IndexSet::columns() {
+  Prepare(&columns_);
+  return columns_;
+}
+
+CompletionIndex& IndexSet::completions() {
+  // The deleted logs are subtracted with their fields:
+  LoadFields(completions_.fields());
+  Prepare(&completions_);
+  if (completions_.Sync(index_)) {
+    completions_.Save(index_.generation());
+  }
+  return completions_;
+}
+
+MinHashIndex& IndexSet::signatures() {
+  Prepare(&signatures_);
+  return signatures_;
+}
+
+Aggregates& IndexSet::aggregates() {
+  Prepare(&aggregates_);
+  if (aggregates_.Sync(index_)) {
+    aggregates_.Save(index_.generation());
+  }
+  return aggregates_;
+}
+
+}  // namespace worklog
@@ -0,0 +1,100 @@
+#ifndef INDEX_SET_H_
+#define INDEX_SET_H_
+
+#include <set>
+#include <vector>
+
+#include "atl/status.h"
+
+#include "aggregates.h"
+#include "column_index.h"
+#include "completion_index.h"
+#include "derived_index.h"
+#include "index.h"
+#include "inverted_index.h"
+#include "minhash_index.h"
+#include "time_index.h"
+#include "trigram.h"
+#include "worklog.h"
+
+namespace worklog {
+
+// IndexSet keeps the log index and all indexes derived from it in sync.
+// A derived index is only loaded when it is used: writes only update the
+// log index (and the derived indexes which are loaded anyway), the others
+// catch up with the journal of the log index on their next use. A derived
+// file is only rewritten if any of the fields it is derived from changed.
+class IndexSet {
+ public:
+  // Only the given fields of the logs are loaded (see Index::Load) unless
+  // logs have to be applied, then all fields are.
+  explicit IndexSet(const Config& config, LogFields fields = kAllFields);
+
+  IndexSet(const IndexSet&) = delete;
+  IndexSet& operator=(const IndexSet&) = delete;
+
+  // Loads the log index and applies the logs which changed since it has
+  // been written (mtime sweep) plus the explicitly touched ones. Failing
+  // to load or save is not fatal (everything is rebuilt from the log
+  // files), so the returned status is meant as a warning.
+  atl::Status Open(const std::vector<int>& touched = {});
+
+  // Loads the log index as it has been saved, without the mtime sweep:
+  // for readers which must not touch the log files.
+  atl::Status Load();
+
+  // Re-parses the given logs and saves the log index together with the
+  // loaded derived indexes they changed.
+  atl::Status Apply(const std::vector<int>& ids);
+
+  Index& index() { return index_; }
+
+  // The derived indexes are loaded (and caught up if outdated) on first
+  // use:
+  TrigramIndex& trigrams();
+  InvertedIndex& inverted_index();
+  TimeIndex& time_index();
+  ColumnIndex& columns();
+  MinHashIndex& signatures();
+
+  // Also applies the deletes & undeletes since the completions have been
+  // saved (see CompletionIndex::Sync).
+  CompletionIndex& completions();
+
+  // Also applies the deletes & undeletes since the aggregates have been
+  // saved (see Aggregates::Sync).
+  Aggregates& aggregates();
+
+ private:
+  // Loads the derived index and brings it up to date with the log index:
+  // an outdated one replays the journal or is rebuilt if that's not
+  // possible, and is saved then.
+  void Prepare(DerivedIndex* derived);
+
+  // Applies the changes of the journal after the given generation to the
+  // derived index. Fails if the journal doesn't go back that far.
+  atl::Status Replay(DerivedIndex* derived, uint64_t generation);
+
+  // Reloads the log index with all fields if it lacks any of the given
+  // ones. References to its logs are invalidated then, the prepared
+  // derived indexes too if another process saved the index meanwhile.
+  void LoadFields(LogFields fields);
+
+  Config config_;
+  LogFields fields_;
+  Index index_;
+  TrigramIndex trigrams_;
+  InvertedIndex inverted_index_;
+  TimeIndex time_index_;
+  ColumnIndex columns_;
+  CompletionIndex completions_;
+  MinHashIndex signatures_;
+  Aggregates aggregates_;
+
+  std::vector<DerivedIndex*> derived_;
+  std::set<DerivedIndex*> prepared_;
+};
+
+}  // namespace worklog
+
+#endif  // INDEX_SET_H_
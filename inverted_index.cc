@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "atl/string.h"
+
+#include "inverted_index.h"
+
+namespace worklog {
+
+namespace {
+// "WLII"
+constexpr uint32_t kInvertedMagic = 0x49494c57;
+
+// BM25 parameters (the commonly used defaults)
+constexpr double kK1 = 1.2;
+constexpr double kB = 0.75;
+
+// term -> term frequency
+std::map<std::string, uint32_t> CountTerms(const Log& log, uint32_t* length) {
+  std::map<std::string, uint32_t> counts;
+  *length = 0;
+
+  for (const std::string* text : {&log.subject, &log.description}) {
+    const std::string lower = atl::ToLower(*text);
+    ForEachWord(lower, [&](atl::StringView term) {
+      counts[term.to_string()]++;
+      (*length)++;
+    });
+  }
+
+  return counts;
+}
+
+double Idf(std::size_t num_logs, std::size_t df) {
+  return std::log(1.0 + (num_logs - df + 0.5) / (df + 0.5));
+}
+
+struct ScoreGreater {
+  // Ties are broken by the lower id, so the ranking is deterministic:
+  bool operator()(const ScoredLog& a, const ScoredLog& b) const {
+    if (a.score != b.score) {
+      return a.score > b.score;
+    }
+    return a.id < b.id;
+  }
+};
+}  // namespace
+
+InvertedIndex::InvertedIndex(const Config& config)
+    : DerivedIndex(config.InvertedIndexPath(), kInvertedMagic) {}
+
+void InvertedIndex::OnPut(const Log* old_log, const Log& log) {
+  uint32_t length = 0;
+  std::map<std::string, uint32_t> counts = CountTerms(log, &length);
+  if (old_log != nullptr) {
+    // The same terms (ie. only a tag was changed) leave the postings as
+    // they are:
+    uint32_t old_length = 0;
+    if (CountTerms(*old_log, &old_length) == counts) {
+      return;
+    }
+    OnErase(*old_log);
+  }
+
+  for (const auto& count : counts) {
+    Term& term = terms_[count.first];
+
+    Posting posting = {log.id, count.second};
+    auto pos = std::lower_bound(
+        term.postings.begin(), term.postings.end(), log.id,
+        [](const Posting& p, int id) { return p.id < id; });
+    term.postings.insert(pos, posting);
+    term.max_tf = std::max(term.max_tf, count.second);
+  }
+
+  lengths_[log.id] = length;
+  total_length_ += length;
+}
+
+void InvertedIndex::OnErase(const Log& old_log) {
+  uint32_t length = 0;
+  for (const auto& count : CountTerms(old_log, &length)) {
+    auto found = terms_.find(count.first);
+    if (found == terms_.end()) {
+      continue;
+    }
+
+    auto& postings = found->second.postings;
+    auto pos = std::lower_bound(
+        postings.begin(), postings.end(), old_log.id,
+        [](const Posting& p, int id) { return p.id < id; });
+    if (pos != postings.end() && pos->id == old_log.id) {
+      postings.erase(pos);
+    }
+
+    if (postings.empty()) {
+      terms_.erase(found);
+    }
+  }
+
+  auto found = lengths_.find(old_log.id);
+  if (found != lengths_.end()) {
+    total_length_ -= found->second;
+    lengths_.erase(found);
+  }
+}
+
+std::vector<ScoredLog> InvertedIndex::TopK(
+    const std::vector<std::string>& terms, std::size_t k,
+    std::function<bool(int)> accept) const {
+  if (k == 0 || lengths_.empty()) {
+    return {};
+  }
+
+  const std::size_t num_logs = lengths_.size();
+  const double avg_length = static_cast<double>(total_length_) / num_logs;
+
+  struct Cursor {
+    const std::vector<Posting>* postings;
+    std::size_t pos;
+    double idf;
+    double max_score;
+  };
+
+  std::vector<Cursor> cursors;
+  std::vector<std::string> unique_terms(terms);
+  std::sort(unique_terms.begin(), unique_terms.end());
+  unique_terms.erase(std::unique(unique_terms.begin(), unique_terms.end()),
+                     unique_terms.end());
+
+  for (const auto& text : unique_terms) {
+    auto found = terms_.find(text);
+    if (found == terms_.end()) {
+      continue;
+    }
+
+    const Term& term = found->second;
+    double idf = Idf(num_logs, term.postings.size());
+
+    // The score is highest for the highest tf and the shortest log (0):
+    double tf = term.max_tf;
+    double max_score = idf * tf * (kK1 + 1) / (tf + kK1 * (1 - kB));
+
+    cursors.push_back({&term.postings, 0, idf, max_score});
+  }
+
+  // Sorted by ascending max score; upper_bounds[i] is the highest score a
+  // log can reach with the terms 0..i only.
+  std::sort(cursors.begin(), cursors.end(),
+            [](const Cursor& a, const Cursor& b) {
+              return a.max_score < b.max_score;
+            });
+
+  std::vector<double> upper_bounds(cursors.size());
+  double sum = 0;
+  for (std::size_t i = 0; i < cursors.size(); i++) {
+    sum += cursors[i].max_score;
+    upper_bounds[i] = sum;
+  }
+
+  auto term_score = [&](const Cursor& cursor, const Posting& posting) {
+    double length = lengths_.at(posting.id);
+    double tf = posting.tf;
+    return cursor.idf * tf * (kK1 + 1) /
+           (tf + kK1 * (1 - kB + kB * length / avg_length));
+  };
+
+  // Min heap of the current top k (the worst one on top):
+  std::priority_queue<ScoredLog, std::vector<ScoredLog>, ScoreGreater> top;
+  double threshold = 0;
+
+  // The cursors before first_essential can't lift a log into the top k on
+  // their own, so only logs of the essential ones are candidates:
+  std::size_t first_essential = 0;
+
+  for (;;) {
+    int id = std::numeric_limits<int>::max();
+    for (std::size_t i = first_essential; i < cursors.size(); i++) {
+      const Cursor& cursor = cursors[i];
+      if (cursor.pos < cursor.postings->size()) {
+        id = std::min(id, (*cursor.postings)[cursor.pos].id);
+      }
+    }
+
+    if (id == std::numeric_limits<int>::max()) {
+      break;
+    }
+
+    bool accepted = accept(id);
+    double score = 0;
+
+    for (std::size_t i = first_essential; i < cursors.size(); i++) {
+      Cursor& cursor = cursors[i];
+      if (cursor.pos < cursor.postings->size() &&
+          (*cursor.postings)[cursor.pos].id == id) {
+        if (accepted) {
+          score += term_score(cursor, (*cursor.postings)[cursor.pos]);
+        }
+        cursor.pos++;
+      }
+    }
+
+    if (!accepted) {
+      continue;
+    }
+
+    // The non essential terms are only looked up (by binary search) as
+    // long as they could still lift the log over the threshold:
+    for (std::size_t i = first_essential; i-- > 0;) {
+      if (top.size() == k && score + upper_bounds[i] < threshold) {
+        break;
+      }
+
+      Cursor& cursor = cursors[i];
+      auto begin = cursor.postings->begin() + cursor.pos;
+      auto pos = std::lower_bound(
+          begin, cursor.postings->end(), id,
+          [](const Posting& p, int id) { return p.id < id; });
+      cursor.pos = pos - cursor.postings->begin();
+
+      if (pos != cursor.postings->end() && pos->id == id) {
+        score += term_score(cursor, *pos);
+      }
+    }
+
+    ScoredLog scored = {id, score};
+    if (top.size() < k) {
+      top.push(scored);
+    } else if (ScoreGreater()(scored, top.top())) {
+      top.pop();
+      top.push(scored);
+    }
+
+    if (top.size() == k) {
+      threshold = top.top().score;
+      while (first_essential < cursors.size() &&
+             upper_bounds[first_essential] < threshold) {
+        first_essential++;
+      }
+    }
+  }
+
+  std::vector<ScoredLog> result;
+  result.reserve(top.size());
+  while (!top.empty()) {
+    result.push_back(top.top());
+    top.pop();
+  }
+  std::reverse(result.begin(), result.end());
+
+  return result;
+}
+
+void InvertedIndex::Clear() {
+  terms_.clear();
+  lengths_.clear();
+  total_length_ = 0;
+}
+
+void InvertedIndex::Encode(std::string* out) const {
+  // Sorted, so the same index always results in the same file:
+  std::vector<const std::string*> terms;
+  terms.reserve(terms_.size());
+  for (const auto& term : terms_) {
+    terms.push_back(&term.first);
+  }
+  std::sort(terms.begin(), terms.end(),
+            [](const std::string* a, const std::string* b) { return *a < *b; });
+
+  atl::PutVarint64(out, terms.size());
+  for (const std::string* text : terms) {
+    const Term& term = terms_.at(*text);
+
+    atl::PutLengthPrefixed(out, *text);
+    atl::PutVarint32(out, term.max_tf);
+    atl::PutVarint64(out, term.postings.size());
+
+    int prev_id = 0;
+    for (const auto& posting : term.postings) {
+      atl::PutVarint32(out, posting.id - prev_id);
+      atl::PutVarint32(out, posting.tf);
+      prev_id = posting.id;
+    }
+  }
+
+  std::vector<std::pair<int, uint32_t>> lengths(lengths_.begin(),
+                                                lengths_.end());
+  std::sort(lengths.begin(), lengths.end());
+
+  atl::PutVarint64(out, lengths.size());
+  int prev_id = 0;
+  for (const auto& length : lengths) {
+    atl::PutVarint32(out, length.first - prev_id);
+    atl::PutVarint32(out, length.second);
+    prev_id = length.first;
+  }
+}
+
+bool InvertedIndex::Decode(atl::Decoder* in) {
+  uint64_t num_terms = 0;
+  if (!in->GetVarint64(&num_terms)) {
+    return false;
+  }
+
+  terms_.reserve(num_terms);
+  for (uint64_t i = 0; i < num_terms; i++) {
+    atl::StringView text;
+    uint64_t num_postings = 0;
+
+    Term term;
+    if (!in->GetLengthPrefixed(&text) || !in->GetVarint32(&term.max_tf) ||
+        !in->GetVarint64(&num_postings) || num_postings > in->remaining()) {
+      return false;
+    }
+
+    term.postings.reserve(num_postings);
+    int prev_id = 0;
+    for (uint64_t j = 0; j < num_postings; j++) {
+      uint32_t delta = 0;
+      uint32_t tf = 0;
+      if (!in->GetVarint32(&delta) || !in->GetVarint32(&tf)) {
+        return false;
+      }
+      prev_id += delta;
+      term.postings.push_back({prev_id, tf});
+    }
+
+    terms_.emplace(text.to_string(), std::move(term));
+  }
+
+  uint64_t num_lengths = 0;
+  if (!in->GetVarint64(&num_lengths)) {
+    return false;
+  }
+
+  lengths_.reserve(num_lengths);
+  int prev_id = 0;
+  for (uint64_t i = 0; i < num_lengths; i++) {
+    uint32_t delta = 0;
+    uint32_t length = 0;
+    if (!in->GetVarint32(&delta) || !in->GetVarint32(&length)) {
+      return false;
+    }
+    prev_id += delta;
+    lengths_[prev_id] = length;
+    total_length_ += length;
+  }
+
+  return true;
+}
+
+}  // namespace worklog
@@ -0,0 +1,73 @@
+#ifndef INVERTED_INDEX_H_
+#define INVERTED_INDEX_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "derived_index.h"
+#include "index.h"
+#include "tokenizer.h"
+#include "worklog.h"
+
+namespace worklog {
+
+struct ScoredLog {
+  int id;
+  double score;
+};
+
+// InvertedIndex maps every word of the subject & the description to the
+// logs containing it together with its term frequency, so searches can be
+// ranked by BM25.
+class InvertedIndex : public DerivedIndex {
+ public:
+  explicit InvertedIndex(const Config& config);
+
+  void OnPut(const Log* old_log, const Log& log) override;
+  void OnErase(const Log& old_log) override;
+
+  LogFields fields() const override {
+    return kFieldSubject | kFieldDescription;
+  }
+
+  // Returns the k logs which score best (BM25) for the terms, best first.
+  // Only the logs accepted by the filter are scored. MaxScore pruning skips
+  // the logs which can't make it into the top k anymore, so not every
+  // posting is looked at.
+  std::vector<ScoredLog> TopK(const std::vector<std::string>& terms,
+                              std::size_t k,
+                              std::function<bool(int)> accept) const;
+
+ protected:
+  void Clear() override;
+  void Encode(std::string* out) const override;
+  bool Decode(atl::Decoder* in) override;
+
+ private:
+  struct Posting {
+    int id;
+    uint32_t tf;
+  };
+
+  struct Term {
+    // sorted by id
+    std::vector<Posting> postings;
+
+    // Upper bound of the term frequency over all postings, used for the
+    // MaxScore bound. It is not lowered on erase (it stays a valid bound).
+    uint32_t max_tf = 0;
+  };
+
+  std::unordered_map<std::string, Term> terms_;
+
+  // id -> number of words (the BM25 document length)
+  std::unordered_map<int, uint32_t> lengths_;
+  uint64_t total_length_ = 0;
+};
+
+}  // namespace worklog
+
+#endif  // INVERTED_INDEX_H_
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "gtl/ptr_util.h"
+
+#include "log_iterator.h"
+
+namespace worklog {
+
+namespace {
+bool ListedBefore(const Log& a, const Log& b) {
+  return a.created_at > b.created_at ||
+         (a.created_at == b.created_at && a.id > b.id);
+}
+
+class IdIterator : public LogIterator {
+ public:
+  explicit IdIterator(const Index& index)
+      : index_(index), it_(index.entries().begin()) {}
+
+  const Log* Next() override {
+    while (it_ != index_.entries().end()) {
+      const auto& entry = *it_++;
+      if (!index_.IsDeleted(entry.first)) {
+        return &entry.second.log;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  const Index& index_;
+  IndexEntries::const_iterator it_;
+};
+
+class NewestFirstIterator : public LogIterator {
+ public:
+  NewestFirstIterator(const Index& index, const TimeIndex& times,
+                      std::size_t begin, std::size_t end)
+      : index_(index), times_(times), begin_(begin), pos_(end) {}
+
+  const Log* Next() override {
+    while (pos_ > begin_) {
+      auto found = index_.entries().find(times_.IdAt(--pos_));
+      if (found != index_.entries().end() && !index_.IsDeleted(found->first)) {
+        return &found->second.log;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  const Index& index_;
+  const TimeIndex& times_;
+  std::size_t begin_;
+  std::size_t pos_;
+};
+
+class FilterIterator : public LogIterator {
+ public:
+  FilterIterator(std::unique_ptr<LogIterator> logs,
+                 std::function<bool(const Log&)> accept)
+      : logs_(std::move(logs)), accept_(std::move(accept)) {}
+
+  const Log* Next() override {
+    while (const Log* log = logs_->Next()) {
+      if (accept_(*log)) {
+        return log;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  std::unique_ptr<LogIterator> logs_;
+  std::function<bool(const Log&)> accept_;
+};
+
+class MergeIterator : public LogIterator {
+ public:
+  explicit MergeIterator(std::vector<std::unique_ptr<LogIterator>> runs)
+      : runs_(std::move(runs)) {
+    for (std::size_t i = 0; i < runs_.size(); i++) {
+      Push(i);
+    }
+  }
+
+  const Log* Next() override {
+    while (!heap_.empty()) {
+      std::pop_heap(heap_.begin(), heap_.end(), HeadAfter);
+      Head head = heap_.back();
+      heap_.pop_back();
+      Push(head.run);
+
+      // The runs are ordered, so duplicates come right after each other:
+      if (last_ == nullptr || last_->id != head.log->id) {
+        last_ = head.log;
+        return head.log;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  struct Head {
+    const Log* log;
+    std::size_t run;
+  };
+
+  // std::*_heap keep the greatest element on top, the log listed first
+  // has to be the greatest:
+  static bool HeadAfter(const Head& a, const Head& b) {
+    return ListedBefore(*b.log, *a.log);
+  }
+
+  void Push(std::size_t run) {
+    if (const Log* log = runs_[run]->Next()) {
+      heap_.push_back({log, run});
+      std::push_heap(heap_.begin(), heap_.end(), HeadAfter);
+    }
+  }
+
+  std::vector<std::unique_ptr<LogIterator>> runs_;
+  std::vector<Head> heap_;
+  const Log* last_ = nullptr;
+};
+}  // namespace
+
+std::unique_ptr<LogIterator> IterateById(const Index& index) {
+  return gtl::MakeUnique<IdIterator>(index);
+}
+
+std::unique_ptr<LogIterator> IterateNewestFirst(const Index& index,
+                                                const TimeIndex& times,
+                                                std::size_t begin,
+                                                std::size_t end) {
+  return gtl::MakeUnique<NewestFirstIterator>(index, times, begin, end);
+}
+
+std::unique_ptr<LogIterator> FilterLogs(std::unique_ptr<LogIterator> logs,
+                                    std::function<bool(const Log&)> accept) {
+  return gtl::MakeUnique<FilterIterator>(std::move(logs), std::move(accept));
+}
+
+std::unique_ptr<LogIterator> MergeNewestFirst(
+    std::vector<std::unique_ptr<LogIterator>> runs) {
+  return gtl::MakeUnique<MergeIterator>(std::move(runs));
+}
+
+}  // namespace worklog
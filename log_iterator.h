@@ -0,0 +1,49 @@
+#ifndef LOG_ITERATOR_H_
+#define LOG_ITERATOR_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "index.h"
+#include "time_index.h"
+#include "worklog.h"
+
+namespace worklog {
+
+// LogIterator yields the logs of the index one at a time, so commands can
+// filter them as they go and stop early instead of copying all logs into
+// a vector first. The logs belong to the index and live as long as it.
+// Deleted logs are never yielded.
+class LogIterator {
+ public:
+  virtual ~LogIterator() {}
+
+  // Returns null at the end.
+  virtual const Log* Next() = 0;
+};
+
+// In id order; for commands which don't care about the order.
+std::unique_ptr<LogIterator> IterateById(const Index& index);
+
+// In the listing order (created_at DESC, id DESC) over the positions
+// [begin, end) of the time index.
+std::unique_ptr<LogIterator> IterateNewestFirst(const Index& index,
+                                                const TimeIndex& times,
+                                                std::size_t begin,
+                                                std::size_t end);
+
+std::unique_ptr<LogIterator> FilterLogs(
+    std::unique_ptr<LogIterator> logs,
+    std::function<bool(const Log&)> accept);
+
+// Merges runs which are each in the listing order into one (k-way merge
+// with a heap of the runs' heads). A log yielded by several runs is
+// yielded once.
+std::unique_ptr<LogIterator> MergeNewestFirst(
+    std::vector<std::unique_ptr<LogIterator>> runs);
+
+}  // namespace worklog
+
+#endif  // LOG_ITERATOR_H_
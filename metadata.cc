@@ -0,0 +1,140 @@
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "metadata.h"
+
+namespace worklog {
+
+namespace {
+// Parses the digits at the front of text into value and removes them.
+// Fails if there are none or if the number gets too large.
+bool ConsumeNumber(atl::StringView* text, int64_t* value) {
+  std::size_t pos = 0;
+  *value = 0;
+  while (pos < text->size() && (*text)[pos] >= '0' && (*text)[pos] <= '9') {
+    if (*value > (std::numeric_limits<int64_t>::max() - 9) / 10) {
+      return false;
+    }
+    *value = *value * 10 + ((*text)[pos] - '0');
+    pos++;
+  }
+
+  text->remove_prefix(pos);
+  return pos > 0;
+}
+
+// 'h:mm' or 'h:mm:ss'
+bool ParseClockDuration(atl::StringView text, int64_t* seconds) {
+  int64_t hours = 0;
+  int64_t minutes = 0;
+  int64_t secs = 0;
+  if (!ConsumeNumber(&text, &hours) || text.empty() || text[0] != ':') {
+    return false;
+  }
+
+  text.remove_prefix(1);
+  if (text.size() < 2 || !ConsumeNumber(&text, &minutes) || minutes >= 60) {
+    return false;
+  }
+
+  if (!text.empty()) {
+    if (text[0] != ':') {
+      return false;
+    }
+    text.remove_prefix(1);
+    if (text.size() != 2 || !ConsumeNumber(&text, &secs) || secs >= 60) {
+      return false;
+    }
+  }
+
+  *seconds = hours * 3600 + minutes * 60 + secs;
+  return true;
+}
+
+// '1h30m', '2h', '45m', '30s' (every unit at most once, in that order)
+bool ParseUnitDuration(atl::StringView text, int64_t* seconds) {
+  const char units[] = {'h', 'm', 's'};
+  const int64_t factors[] = {3600, 60, 1};
+
+  std::size_t unit = 0;
+  *seconds = 0;
+  while (!text.empty()) {
+    int64_t value = 0;
+    if (!ConsumeNumber(&text, &value) || text.empty()) {
+      return false;
+    }
+
+    while (unit < 3 && units[unit] != text[0]) {
+      unit++;
+    }
+    if (unit == 3 || value > std::numeric_limits<int64_t>::max() / 3600) {
+      return false;
+    }
+
+    *seconds += value * factors[unit++];
+    text.remove_prefix(1);
+  }
+
+  return true;
+}
+}  // namespace
+
+MetadataValue ParseMetadataValue(atl::StringView text) {
+  MetadataValue value;
+
+  atl::StringView digits = text;
+  bool negative = !digits.empty() && digits[0] == '-';
+  if (negative) {
+    digits.remove_prefix(1);
+  }
+
+  int64_t number = 0;
+  if (ConsumeNumber(&digits, &number) && digits.empty()) {
+    value.type = MetadataType::kInteger;
+    value.number = negative ? -number : number;
+  } else if (!text.empty() && (ParseClockDuration(text, &number) ||
+                               ParseUnitDuration(text, &number))) {
+    value.type = MetadataType::kDuration;
+    value.number = number;
+  }
+
+  return value;
+}
+
+std::string FormatDuration(int64_t seconds) {
+  std::string text;
+  if (seconds < 0) {
+    text = "-";
+    seconds = -seconds;
+  }
+
+  int64_t hours = seconds / 3600;
+  int64_t minutes = seconds % 3600 / 60;
+  seconds %= 60;
+
+  if (hours > 0) {
+    text += std::to_string(hours) + "h";
+  }
+  if (minutes > 0 || (hours == 0 && seconds == 0)) {
+    text += std::to_string(minutes) + "m";
+  }
+  if (seconds > 0) {
+    text += std::to_string(seconds) + "s";
+  }
+  return text;
+}
+
+const char* MetadataTypeName(MetadataType type) {
+  switch (type) {
+    case MetadataType::kEnum:
+      return "enum";
+    case MetadataType::kDuration:
+      return "duration";
+    case MetadataType::kInteger:
+      return "integer";
+  }
+  return "unknown";
+}
+
+}  // namespace worklog
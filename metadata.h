@@ -0,0 +1,32 @@
+#ifndef METADATA_H_
+#define METADATA_H_
+
+#include <cstdint>
+#include <string>
+
+#include "atl/string_view.h"
+
+namespace worklog {
+
+// Custom header fields of a log (see Log::metadata) are typed by their
+// value: durations like '1h30m', '45m', '20s' or '1:30' (h:mm), integers
+// like '3' or '-2' and everything else is an enum value (ie. a project).
+enum class MetadataType : uint8_t { kEnum = 0, kDuration = 1, kInteger = 2 };
+
+struct MetadataValue {
+  MetadataType type = MetadataType::kEnum;
+
+  // Seconds for durations, the value for integers.
+  int64_t number = 0;
+};
+
+MetadataValue ParseMetadataValue(atl::StringView text);
+
+// Formats seconds like '2h5m', '45m' or '1m30s'.
+std::string FormatDuration(int64_t seconds);
+
+const char* MetadataTypeName(MetadataType type);
+
+}  // namespace worklog
+
+#endif  // METADATA_H_
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "atl/coding.h"
+
+#include "inverted_index.h"
+#include "minhash_index.h"
+
+namespace worklog {
+
+namespace {
+// "WLMH"
+constexpr uint32_t kMinHashMagic = 0x484d4c57;
+
+// Words per shingle.
+constexpr std::size_t kShingleSize = 3;
+
+// The signatures are split into 16 bands of 4 rows for the LSH buckets.
+// Two logs of a similarity s share a bucket in at least one band with a
+// probability of 1 - (1 - s^4)^16: 99.9% at 0.8, 64% at 0.5, 12% at 0.3.
+constexpr std::size_t kBands = 16;
+constexpr std::size_t kRows = kSignatureSize / kBands;
+
+// Below this many logs a rebuild hashes on a single thread.
+constexpr std::size_t kMinParallelRebuildSize = 1 << 12;
+
+// The finalizer of splitmix64.
+uint64_t Mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// FNV-1a over the words, each followed by a 0 byte.
+uint64_t HashWords(const std::vector<std::string>& words, std::size_t begin,
+                   std::size_t end) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (std::size_t i = begin; i < end; i++) {
+    for (char c : words[i]) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    hash *= 0x100000001b3ULL;
+  }
+  return Mix(hash);
+}
+
+// The hash functions of the signature: h(x) = (a * x + b) >> 32 with an odd
+// a (multiply-shift), one multiplication per function & shingle.
+struct HashFunctions {
+  HashFunctions() {
+    for (std::size_t i = 0; i < kSignatureSize; i++) {
+      a[i] = Mix(2 * i + 1) | 1;
+      b[i] = Mix(2 * i + 2);
+    }
+  }
+
+  uint64_t a[kSignatureSize];
+  uint64_t b[kSignatureSize];
+};
+
+const HashFunctions& Functions() {
+  static const HashFunctions functions;
+  return functions;
+}
+
+// The bucket of a signature in a band.
+uint64_t BandKey(const Signature& signature, std::size_t band) {
+  uint64_t key = 0;
+  for (std::size_t row = band * kRows; row < (band + 1) * kRows; row++) {
+    key = Mix(key ^ signature[row]);
+  }
+  return key;
+}
+}  // namespace
+
+bool ComputeSignature(const std::string& text, Signature* signature) {
+  std::vector<std::string> words = Tokenize(text);
+  if (words.empty()) {
+    return false;
+  }
+
+  const HashFunctions& functions = Functions();
+  signature->fill(UINT32_MAX);
+
+  const std::size_t num_shingles =
+      words.size() < kShingleSize ? 1 : words.size() - kShingleSize + 1;
+  for (std::size_t i = 0; i < num_shingles; i++) {
+    uint64_t shingle =
+        HashWords(words, i, std::min(words.size(), i + kShingleSize));
+    for (std::size_t j = 0; j < kSignatureSize; j++) {
+      uint32_t hash = (functions.a[j] * shingle + functions.b[j]) >> 32;
+      (*signature)[j] = std::min((*signature)[j], hash);
+    }
+  }
+
+  return true;
+}
+
+double EstimateSimilarity(const Signature& a, const Signature& b) {
+  std::size_t equal = 0;
+  for (std::size_t i = 0; i < kSignatureSize; i++) {
+    equal += a[i] == b[i];
+  }
+  return static_cast<double>(equal) / kSignatureSize;
+}
+
+MinHashIndex::MinHashIndex(const Config& config)
+    : DerivedIndex(config.SignaturesPath(), kMinHashMagic) {}
+
+void MinHashIndex::OnPut(const Log* old_log, const Log& log) {
+  // Most changes leave the description alone:
+  if (old_log != nullptr && old_log->description == log.description) {
+    return;
+  }
+
+  Signature signature;
+  if (ComputeSignature(log.description, &signature)) {
+    signatures_[log.id] = signature;
+  } else {
+    signatures_.erase(log.id);
+  }
+}
+
+void MinHashIndex::OnErase(const Log& old_log) {
+  signatures_.erase(old_log.id);
+}
+
+void MinHashIndex::Rebuild(const Index& index) {
+  Clear();
+
+  std::vector<const Log*> logs;
+  logs.reserve(index.entries().size());
+  for (const auto& entry : index.entries()) {
+    logs.push_back(&entry.second.log);
+  }
+
+  // One range of logs per thread, the signatures are inserted afterwards
+  // in the order of the ids:
+  const unsigned int num_threads =
+      logs.size() < kMinParallelRebuildSize
+          ? 1
+          : std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t chunk_size = (logs.size() + num_threads - 1) / num_threads;
+
+  std::vector<Signature> signatures(logs.size());
+  std::vector<char> hashed(logs.size(), 0);
+  auto hash = [&](unsigned int chunk) {
+    std::size_t end = std::min(logs.size(), (chunk + 1) * chunk_size);
+    for (std::size_t i = chunk * chunk_size; i < end; i++) {
+      hashed[i] = ComputeSignature(logs[i]->description, &signatures[i]);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int chunk = 1; chunk < num_threads; chunk++) {
+    threads.emplace_back(hash, chunk);
+  }
+  hash(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (std::size_t i = 0; i < logs.size(); i++) {
+    if (hashed[i]) {
+      signatures_.emplace_hint(signatures_.end(), logs[i]->id, signatures[i]);
+    }
+  }
+}
+
+std::vector<DuplicateGroup> MinHashIndex::FindDuplicates(
+    const Index& index, double threshold) const {
+  std::vector<int> ids;
+  std::vector<const Signature*> signatures;
+  for (const auto& entry : signatures_) {
+    if (!index.IsDeleted(entry.first)) {
+      ids.push_back(entry.first);
+      signatures.push_back(&entry.second);
+    }
+  }
+
+  // The groups are the sets of a union-find over the positions:
+  const std::size_t size = ids.size();
+  std::vector<std::size_t> parents(size);
+  std::iota(parents.begin(), parents.end(), 0);
+  auto find = [&parents](std::size_t i) {
+    while (parents[i] != i) {
+      parents[i] = parents[parents[i]];
+      i = parents[i];
+    }
+    return i;
+  };
+
+  std::vector<std::pair<uint64_t, std::size_t>> buckets(size);
+  std::vector<std::size_t> leaders;
+  for (std::size_t band = 0; band < kBands; band++) {
+    for (std::size_t i = 0; i < size; i++) {
+      buckets[i] = {BandKey(*signatures[i], band), i};
+    }
+    std::sort(buckets.begin(), buckets.end());
+
+    for (std::size_t begin = 0, end = 0; begin < size; begin = end) {
+      for (end = begin + 1;
+           end < size && buckets[end].first == buckets[begin].first; end++) {
+      }
+
+      // A log is only compared with the logs of the bucket which didn't
+      // join an earlier one, so a bucket of copies takes one comparison
+      // per log instead of one per pair:
+      leaders.clear();
+      for (std::size_t i = begin; i < end; i++) {
+        std::size_t log = buckets[i].second;
+        bool joined = false;
+        for (std::size_t leader : leaders) {
+          if (find(log) == find(leader) ||
+              EstimateSimilarity(*signatures[log], *signatures[leader]) >=
+                  threshold) {
+            parents[find(log)] = find(leader);
+            joined = true;
+          }
+        }
+
+        if (!joined) {
+          leaders.push_back(log);
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<std::size_t>> members(size);
+  for (std::size_t i = 0; i < size; i++) {
+    members[find(i)].push_back(i);
+  }
+
+  std::vector<DuplicateGroup> groups;
+  for (const auto& positions : members) {
+    if (positions.size() < 2) {
+      continue;
+    }
+
+    DuplicateGroup group;
+    for (std::size_t i : positions) {
+      group.ids.push_back(ids[i]);
+      group.similarities.push_back(
+          EstimateSimilarity(*signatures[positions[0]], *signatures[i]));
+    }
+    groups.push_back(std::move(group));
+  }
+
+  std::sort(groups.begin(), groups.end(),
+            [](const DuplicateGroup& a, const DuplicateGroup& b) {
+              return a.ids.size() > b.ids.size() ||
+                     (a.ids.size() == b.ids.size() && a.ids[0] < b.ids[0]);
+            });
+  return groups;
+}
+
+void MinHashIndex::Clear() { signatures_.clear(); }
+
+void MinHashIndex::Encode(std::string* out) const {
+  atl::PutVarint64(out, signatures_.size());
+
+  int prev_id = 0;
+  for (const auto& entry : signatures_) {
+    atl::PutVarint32(out, entry.first - prev_id);
+    prev_id = entry.first;
+
+    for (uint32_t hash : entry.second) {
+      atl::PutFixed32(out, hash);
+    }
+  }
+}
+
+bool MinHashIndex::Decode(atl::Decoder* in) {
+  uint64_t num_signatures = 0;
+  if (!in->GetVarint64(&num_signatures) ||
+      num_signatures > in->remaining() / (4 * kSignatureSize)) {
+    return false;
+  }
+
+  int id = 0;
+  for (uint64_t i = 0; i < num_signatures; i++) {
+    uint32_t delta = 0;
+    if (!in->GetVarint32(&delta)) {
+      return false;
+    }
+    id += delta;
+
+    Signature signature;
+    for (auto& hash : signature) {
+      if (!in->GetFixed32(&hash)) {
+        return false;
+      }
+    }
+    signatures_.emplace_hint(signatures_.end(), id, signature);
+  }
+
+  return true;
+}
+
+}  // namespace worklog
@@ -0,0 +1,77 @@
+#ifndef MINHASH_INDEX_H_
+#define MINHASH_INDEX_H_
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "derived_index.h"
+#include "index.h"
+#include "worklog.h"
+
+namespace worklog {
+
+// The number of hash functions of a MinHash signature.
+constexpr std::size_t kSignatureSize = 64;
+
+// A MinHash signature holds the smallest value of every hash function over
+// the shingles of a text. The share of the positions at which two
+// signatures agree estimates the Jaccard similarity of their shingles.
+using Signature = std::array<uint32_t, kSignatureSize>;
+
+// Computes the signature of the shingles of the text: its runs of three
+// consecutive words (see Tokenize), a text of fewer words is a single
+// shingle. Returns false for a text without words.
+bool ComputeSignature(const std::string& text, Signature* signature);
+
+// The estimated Jaccard similarity between 0 and 1.
+double EstimateSimilarity(const Signature& a, const Signature& b);
+
+// Logs whose descriptions are near duplicates of each other.
+struct DuplicateGroup {
+  std::vector<int> ids;  // sorted
+
+  // The estimated similarity of every log to the first one.
+  std::vector<double> similarities;
+};
+
+// MinHashIndex keeps the signature of the description of every log, so a
+// search for near duplicates only hashes the logs which changed since the
+// last one. Logs without words in the description have no signature.
+class MinHashIndex : public DerivedIndex {
+ public:
+  explicit MinHashIndex(const Config& config);
+
+  void OnPut(const Log* old_log, const Log& log) override;
+  void OnErase(const Log& old_log) override;
+
+  // Hashes the descriptions on all cores.
+  void Rebuild(const Index& index) override;
+
+  LogFields fields() const override { return kFieldDescription; }
+
+  // Groups the logs which aren't deleted by the estimated similarity of
+  // their descriptions (threshold between 0 and 1). Only the logs which
+  // share a bucket in any band of the signatures are compared
+  // (locality-sensitive hashing) instead of all pairs, so pairs below
+  // about 0.5 are likely to be missed. A log similar to any log of a group
+  // joins it. The largest groups come first.
+  std::vector<DuplicateGroup> FindDuplicates(const Index& index,
+                                             double threshold) const;
+
+  std::size_t size() const { return signatures_.size(); }
+
+ protected:
+  void Clear() override;
+  void Encode(std::string* out) const override;
+  bool Decode(atl::Decoder* in) override;
+
+ private:
+  std::map<int, Signature> signatures_;
+};
+
+}  // namespace worklog
+
+#endif  // MINHASH_INDEX_H_
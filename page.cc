@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "atl/string.h"
+
+#include "page.h"
+
+namespace worklog {
+
+constexpr std::size_t PageOptions::kNoLimit;
+
+namespace {
+struct Key {
+  uint64_t created_at;
+  int id;
+};
+
+// Listing order: newer (and for the same day higher ids) first.
+bool ListedBefore(const Key& a, const Key& b) {
+  return a.created_at > b.created_at ||
+         (a.created_at == b.created_at && a.id > b.id);
+}
+
+atl::Status ParseCount(const std::string& flag, const std::string& value,
+                       std::size_t* count) {
+  atl::Optional<int> number = atl::ParseInt(value);
+  if (!number || number.value() < 0) {
+    return atl::Status(atl::error::INVALID_ARGUMENT,
+                       flag + " expects a number");
+  }
+
+  *count = number.value();
+  return atl::Status();
+}
+}  // namespace
+
+std::string FormatCursor(const Cursor& cursor) {
+  return std::to_string(cursor.created_at) + "." + std::to_string(cursor.id);
+}
+
+atl::Optional<Cursor> ParseCursor(const std::string& text) {
+  uint64_t created_at = 0;
+  int id = 0;
+  char rest = 0;
+  if (std::sscanf(text.c_str(), "%" SCNu64 ".%d%c", &created_at, &id,
+                  &rest) != 2) {
+    return {};
+  }
+
+  return Cursor{created_at, id};
+}
+
+bool IsAfter(const Log& log, const Cursor& cursor) {
+  return ListedBefore({cursor.created_at, cursor.id},
+                      {log.created_at, log.id});
+}
+
+atl::Status ParsePageOptions(std::vector<std::string>* args,
+                             PageOptions* page) {
+  std::vector<std::string> rest;
+
+  for (std::size_t i = 0; i < args->size(); i++) {
+    const std::string& arg = (*args)[i];
+    if (arg != "--limit" && arg != "--offset" && arg != "--after") {
+      rest.push_back(arg);
+      continue;
+    }
+
+    if (i + 1 >= args->size()) {
+      return atl::Status(atl::error::INVALID_ARGUMENT,
+                         arg + " expects a value");
+    }
+
+    const std::string& value = (*args)[++i];
+    if (arg == "--limit" || arg == "--offset") {
+      atl::Status status = ParseCount(
+          arg, value, arg == "--limit" ? &page->limit : &page->offset);
+      if (!status.ok()) {
+        return status;
+      }
+      continue;
+    }
+
+    page->after = ParseCursor(value);
+    if (!page->after) {
+      return atl::Status(atl::error::INVALID_ARGUMENT,
+                         "Invalid cursor '" + value + "'");
+    }
+  }
+
+  args->swap(rest);
+  return atl::Status();
+}
+
+std::size_t PageEnd(const TimeIndex& times, const PageOptions& page) {
+  // The time index is sorted ascending, the logs before the cursor's
+  // position are the ones listed after it:
+  return page.after ? times.Position(page.after->created_at, page.after->id)
+                    : times.size();
+}
+
+atl::Optional<Cursor> WalkPage(LogIterator* logs, const PageOptions& page,
+                               const std::function<void(const Log&)>& fn) {
+  if (page.limit == 0) {
+    return {};
+  }
+
+  for (std::size_t skipped = 0; skipped < page.offset; skipped++) {
+    if (logs->Next() == nullptr) {
+      return {};
+    }
+  }
+
+  std::size_t listed = 0;
+  const Log* last = nullptr;
+  while (const Log* log = logs->Next()) {
+    if (listed == page.limit) {
+      // There is at least one more log:
+      return Cursor{last->created_at, last->id};
+    }
+
+    fn(*log);
+    last = log;
+    listed++;
+  }
+
+  return {};
+}
+
+std::vector<int> SelectPage(const Index& index, const ColumnIndex& columns,
+                            const std::vector<int>& ids,
+                            const PageOptions& page,
+                            atl::Optional<Cursor>* next) {
+  next->reset();
+
+  // One more than the page to know whether there is a next page:
+  const std::size_t keep =
+      page.limit == PageOptions::kNoLimit
+          ? PageOptions::kNoLimit
+          : page.offset + page.limit + 1;
+
+  // The keys come from the created_at column. Max heap by the listing
+  // order, its top is the last kept key:
+  std::vector<Key> heap;
+  for (int id : ids) {
+    std::size_t row = columns.Row(id);
+    if (row == columns.size() || index.IsDeleted(id)) {
+      continue;
+    }
+
+    Key key = {columns.created_at(row), id};
+    if (page.after &&
+        !ListedBefore({page.after->created_at, page.after->id}, key)) {
+      continue;
+    }
+
+    if (heap.size() < keep) {
+      heap.push_back(key);
+      std::push_heap(heap.begin(), heap.end(), ListedBefore);
+    } else if (ListedBefore(key, heap.front())) {
+      std::pop_heap(heap.begin(), heap.end(), ListedBefore);
+      heap.back() = key;
+      std::push_heap(heap.begin(), heap.end(), ListedBefore);
+    }
+  }
+
+  std::sort_heap(heap.begin(), heap.end(), ListedBefore);
+
+  if (heap.size() == keep && page.limit > 0) {
+    heap.pop_back();
+    *next = Cursor{heap.back().created_at, heap.back().id};
+  }
+
+  std::vector<int> page_ids;
+  for (std::size_t i = page.offset; i < heap.size(); i++) {
+    page_ids.push_back(heap[i].id);
+  }
+
+  return page_ids;
+}
+
+}  // namespace worklog
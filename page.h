@@ -0,0 +1,68 @@
+#ifndef PAGE_H_
+#define PAGE_H_
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "atl/optional.h"
+#include "atl/status.h"
+
+#include "column_index.h"
+#include "index.h"
+#include "log_iterator.h"
+#include "time_index.h"
+#include "worklog.h"
+
+namespace worklog {
+
+// Logs are listed newest first: created_at DESC, id DESC. A cursor is the
+// position of a log in that order, the next page starts after it.
+struct Cursor {
+  uint64_t created_at;
+  int id;
+};
+
+// Formatted as <created_at>.<id>
+std::string FormatCursor(const Cursor& cursor);
+atl::Optional<Cursor> ParseCursor(const std::string& text);
+
+// Whether the log comes after the cursor in the listing order.
+bool IsAfter(const Log& log, const Cursor& cursor);
+
+struct PageOptions {
+  static constexpr std::size_t kNoLimit = std::numeric_limits<std::size_t>::max();
+
+  std::size_t limit = kNoLimit;
+  std::size_t offset = 0;
+  atl::Optional<Cursor> after;
+};
+
+// Takes --limit N, --offset N & --after <cursor> out of args.
+atl::Status ParsePageOptions(std::vector<std::string>* args,
+                             PageOptions* page);
+
+// The position in the TimeIndex the page starts before (the logs are
+// listed backwards from there).
+std::size_t PageEnd(const TimeIndex& times, const PageOptions& page);
+
+// Pulls the logs (in the listing order, starting after the cursor) and
+// calls fn for the ones on the page as they come. Stops as soon as the
+// page is full and returns the cursor of the next page if there are more
+// logs.
+atl::Optional<Cursor> WalkPage(LogIterator* logs, const PageOptions& page,
+                               const std::function<void(const Log&)>& fn);
+
+// Returns the page of the given ids in the listing order. Only offset +
+// limit ids are kept (bounded heap) instead of sorting all of them. The
+// cursor of the next page is set if there are more ids.
+std::vector<int> SelectPage(const Index& index, const ColumnIndex& columns,
+                            const std::vector<int>& ids,
+                            const PageOptions& page,
+                            atl::Optional<Cursor>* next);
+
+}  // namespace worklog
+
+#endif  // PAGE_H_
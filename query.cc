@@ -0,0 +1,523 @@
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "atl/string.h"
+#include "atl/time.h"
+#include "gtl/ptr_util.h"
+
+#include "query.h"
+#include "tag_tree.h"
+#include "trigram.h"
+
+namespace worklog {
+
+namespace {
+using Kind = QueryNode::Kind;
+
+struct Token {
+  enum class Type { kOpen, kClose, kWord };
+
+  Type type;
+  std::string text;
+
+  // Quoted tokens are never keywords or negations:
+  bool quoted = false;
+
+  // Position of the first quote in the text; a ':' after it is not a key
+  // separator.
+  std::size_t quote_pos = std::string::npos;
+};
+
+std::vector<Token> Lex(const std::string& text) {
+  std::vector<Token> tokens;
+  Token current = {Token::Type::kWord, "", false, std::string::npos};
+  bool in_token = false;
+  bool in_quotes = false;
+
+  auto flush = [&]() {
+    if (in_token) {
+      tokens.push_back(current);
+    }
+    current = {Token::Type::kWord, "", false, std::string::npos};
+    in_token = false;
+  };
+
+  for (char c : text) {
+    if (c == '"') {
+      in_quotes = !in_quotes;
+      if (!current.quoted) {
+        current.quote_pos = current.text.size();
+      }
+      current.quoted = true;
+      in_token = true;
+      continue;
+    }
+
+    if (!in_quotes && (c == ' ' || c == '\t' || c == '\n')) {
+      flush();
+      continue;
+    }
+
+    if (!in_quotes && (c == '(' || c == ')')) {
+      flush();
+      tokens.push_back({c == '(' ? Token::Type::kOpen : Token::Type::kClose,
+                        std::string(1, c), false, std::string::npos});
+      continue;
+    }
+
+    current.text += c;
+    in_token = true;
+  }
+
+  flush();
+  return tokens;
+}
+
+bool IsKeyword(const Token& token, const char* keyword) {
+  return token.type == Token::Type::kWord && !token.quoted &&
+         token.text == keyword;
+}
+
+// Parses '2017', '2017-06' or '2017-06-24' into the start timestamp of the
+// period and the start of the following period. Anything else, like a
+// trailing '2017-06x', is rejected.
+bool ParsePeriod(const std::string& text, uint64_t* start, uint64_t* end) {
+  if (text.size() != 4 && text.size() != 7 && text.size() != 10) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < text.size(); i++) {
+    bool separator = i == 4 || i == 7;
+    if (separator ? text[i] != '-' : text[i] < '0' || text[i] > '9') {
+      return false;
+    }
+  }
+
+  int year = 0;
+  int month = 0;
+  int day = 0;
+
+  int parts = std::sscanf(text.c_str(), "%4d-%2d-%2d", &year, &month, &day);
+  if (parts != static_cast<int>(text.size() + 1) / 3 || year < 1970) {
+    return false;
+  }
+
+  int next_year = year;
+  int next_month = month;
+  int next_day = day;
+
+  if (parts == 1) {
+    month = day = 1;
+    next_year = year + 1;
+    next_month = next_day = 1;
+  } else if (parts == 2) {
+    day = 1;
+    next_month = month + 1;
+    next_day = 1;
+  } else {
+    next_day = day + 1;
+  }
+
+  if (month < 1 || month > 12 || day < 1 || day > 31) {
+    return false;
+  }
+
+  static const int kDaysInMonth[] = {31, 29, 31, 30, 31, 30,
+                                     31, 31, 30, 31, 30, 31};
+  if (next_day > kDaysInMonth[next_month - 1] ||
+      (next_month == 2 && next_day == 29 &&
+       !(next_year % 4 == 0 && (next_year % 100 != 0 || next_year % 400 == 0)))) {
+    next_day = 1;
+    next_month++;
+  }
+
+  if (next_month > 12) {
+    next_month = 1;
+    next_year++;
+  }
+
+  char buffer[48];
+  std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+  auto start_time = atl::ParseTime(buffer);
+  std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", next_year,
+                next_month, next_day);
+  auto end_time = atl::ParseTime(buffer);
+
+  if (!start_time.second || !end_time.second) {
+    return false;
+  }
+
+  *start = atl::UnixTimestamp(start_time.first);
+  *end = atl::UnixTimestamp(end_time.first);
+  return true;
+}
+
+// Splits 'a..b', 'a..', '..b' and 'a' into from & to (to == from for 'a').
+bool SplitRange(const std::string& text, std::string* from, std::string* to) {
+  auto dots = text.find("..");
+  if (dots == std::string::npos) {
+    *from = *to = text;
+    return !text.empty();
+  }
+
+  *from = text.substr(0, dots);
+  *to = text.substr(dots + 2);
+  return !from->empty() || !to->empty();
+}
+
+bool ParseDateRange(const std::string& text, QueryNode* node) {
+  std::string from;
+  std::string to;
+  if (!SplitRange(text, &from, &to)) {
+    return false;
+  }
+
+  uint64_t unused = 0;
+  if (!from.empty() && !ParsePeriod(from, &node->min, &unused)) {
+    return false;
+  }
+
+  if (!to.empty() && !ParsePeriod(to, &unused, &node->max)) {
+    return false;
+  }
+
+  if (node->min >= node->max) {
+    return false;
+  }
+
+  return true;
+}
+
+bool ParseIdRange(const std::string& text, QueryNode* node) {
+  std::string from;
+  std::string to;
+  if (!SplitRange(text, &from, &to)) {
+    return false;
+  }
+
+  // Ids are positive ints, ParseInt already refuses signs and overflows:
+  if (!from.empty()) {
+    atl::Optional<int> id = atl::ParseInt(from);
+    if (!id || id.value() <= 0) {
+      return false;
+    }
+    node->min = id.value();
+  }
+
+  if (!to.empty()) {
+    atl::Optional<int> id = atl::ParseInt(to);
+    if (!id || id.value() <= 0) {
+      return false;
+    }
+    node->max = id.value();
+  }
+
+  return node->min <= node->max;
+}
+
+class Parser {
+ public:
+  explicit Parser(std::vector<Token> tokens) : tokens_(std::move(tokens)) {}
+
+  atl::Status Parse(std::unique_ptr<QueryNode>* query) {
+    if (tokens_.empty()) {
+      return atl::Status(atl::error::INVALID_ARGUMENT, "Empty query");
+    }
+
+    atl::Status status = ParseOr(query);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (pos_ < tokens_.size()) {
+      return Error("Unexpected '" + tokens_[pos_].text + "'");
+    }
+
+    return atl::Status();
+  }
+
+ private:
+  atl::Status Error(const std::string& message) const {
+    return atl::Status(atl::error::INVALID_ARGUMENT, message);
+  }
+
+  bool AtEnd() const { return pos_ >= tokens_.size(); }
+
+  atl::Status ParseOr(std::unique_ptr<QueryNode>* node) {
+    std::unique_ptr<QueryNode> left;
+    atl::Status status = ParseAnd(&left);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (AtEnd() || !IsKeyword(tokens_[pos_], "OR")) {
+      *node = std::move(left);
+      return atl::Status();
+    }
+
+    auto or_node = gtl::MakeUnique<QueryNode>();
+    or_node->kind = Kind::kOr;
+    or_node->children.push_back(std::move(left));
+
+    while (!AtEnd() && IsKeyword(tokens_[pos_], "OR")) {
+      pos_++;
+
+      std::unique_ptr<QueryNode> right;
+      atl::Status right_status = ParseAnd(&right);
+      if (!right_status.ok()) {
+        return right_status;
+      }
+      or_node->children.push_back(std::move(right));
+    }
+
+    *node = std::move(or_node);
+    return atl::Status();
+  }
+
+  atl::Status ParseAnd(std::unique_ptr<QueryNode>* node) {
+    std::unique_ptr<QueryNode> left;
+    atl::Status status = ParseNot(&left);
+    if (!status.ok()) {
+      return status;
+    }
+
+    auto and_node = gtl::MakeUnique<QueryNode>();
+    and_node->kind = Kind::kAnd;
+    and_node->children.push_back(std::move(left));
+
+    // Juxtaposition is an implicit AND:
+    while (!AtEnd() && !IsKeyword(tokens_[pos_], "OR") &&
+           tokens_[pos_].type != Token::Type::kClose) {
+      if (IsKeyword(tokens_[pos_], "AND")) {
+        pos_++;
+      }
+
+      std::unique_ptr<QueryNode> right;
+      atl::Status right_status = ParseNot(&right);
+      if (!right_status.ok()) {
+        return right_status;
+      }
+      and_node->children.push_back(std::move(right));
+    }
+
+    if (and_node->children.size() == 1) {
+      *node = std::move(and_node->children[0]);
+    } else {
+      *node = std::move(and_node);
+    }
+    return atl::Status();
+  }
+
+  atl::Status ParseNot(std::unique_ptr<QueryNode>* node) {
+    if (AtEnd()) {
+      return Error("Unexpected end of the query");
+    }
+
+    Token& token = tokens_[pos_];
+
+    bool negated = false;
+    if (IsKeyword(token, "NOT")) {
+      pos_++;
+      negated = true;
+    } else if (token.type == Token::Type::kWord && !token.quoted &&
+               token.text.size() > 1 && token.text[0] == '-') {
+      // '-tag:php' is the short form of 'NOT tag:php':
+      token.text = token.text.substr(1);
+      negated = true;
+    }
+
+    if (!negated) {
+      return ParsePrimary(node);
+    }
+
+    std::unique_ptr<QueryNode> child;
+    atl::Status status = ParseNot(&child);
+    if (!status.ok()) {
+      return status;
+    }
+
+    auto not_node = gtl::MakeUnique<QueryNode>();
+    not_node->kind = Kind::kNot;
+    not_node->children.push_back(std::move(child));
+    *node = std::move(not_node);
+    return atl::Status();
+  }
+
+  atl::Status ParsePrimary(std::unique_ptr<QueryNode>* node) {
+    if (AtEnd()) {
+      return Error("Unexpected end of the query");
+    }
+
+    const Token& token = tokens_[pos_++];
+
+    if (token.type == Token::Type::kClose) {
+      return Error("Unexpected ')'");
+    }
+
+    if (token.type == Token::Type::kOpen) {
+      atl::Status status = ParseOr(node);
+      if (!status.ok()) {
+        return status;
+      }
+
+      if (AtEnd() || tokens_[pos_].type != Token::Type::kClose) {
+        return Error("Missing ')'");
+      }
+      pos_++;
+      return atl::Status();
+    }
+
+    auto leaf = gtl::MakeUnique<QueryNode>();
+
+    auto separator = token.text.find(':');
+    if (separator == std::string::npos || separator > token.quote_pos) {
+      leaf->kind = Kind::kText;
+      leaf->value = token.text;
+      leaf->word = !token.quoted;
+      *node = std::move(leaf);
+      return atl::Status();
+    }
+
+    const std::string key = token.text.substr(0, separator);
+    const std::string value = token.text.substr(separator + 1);
+    if (value.empty()) {
+      return Error("Missing value for '" + key + "'");
+    }
+
+    leaf->value = value;
+    if (key == "tag") {
+      leaf->kind = Kind::kTag;
+    } else if (key == "subject") {
+      leaf->kind = Kind::kSubject;
+    } else if (key == "text") {
+      leaf->kind = Kind::kText;
+    } else if (key == "date") {
+      leaf->kind = Kind::kDate;
+      if (!ParseDateRange(value, leaf.get())) {
+        return Error("Invalid date range '" + value +
+                     "'. Expected format: 2017-01..2017-06");
+      }
+    } else if (key == "id") {
+      leaf->kind = Kind::kId;
+      if (!ParseIdRange(value, leaf.get())) {
+        return Error("Invalid id range '" + value +
+                     "'. Expected format: 10..20");
+      }
+    } else {
+      return Error("Unknown key '" + key + "'");
+    }
+
+    *node = std::move(leaf);
+    return atl::Status();
+  }
+
+  std::vector<Token> tokens_;
+  std::size_t pos_ = 0;
+};
+}  // namespace
+
+atl::Status ParseQuery(const std::string& text,
+                       std::unique_ptr<QueryNode>* query) {
+  Parser parser(Lex(text));
+  return parser.Parse(query);
+}
+
+bool Matches(const QueryNode& node, const Log& log, bool rank_words) {
+  switch (node.kind) {
+    case Kind::kAnd:
+      for (const auto& child : node.children) {
+        if (!Matches(*child, log, rank_words)) {
+          return false;
+        }
+      }
+      return true;
+    case Kind::kOr:
+      for (const auto& child : node.children) {
+        if (Matches(*child, log, rank_words)) {
+          return true;
+        }
+      }
+      return false;
+    case Kind::kNot: {
+      const QueryNode& child = *node.children[0];
+      if (rank_words && child.kind == Kind::kText && child.word) {
+        return true;
+      }
+      return !Matches(child, log, rank_words);
+    }
+    case Kind::kTag:
+      return HasTagMatching(log.tags, node.value);
+    case Kind::kSubject:
+      return log.subject.find(node.value) != std::string::npos;
+    case Kind::kText:
+      if (rank_words && node.word) {
+        return true;
+      }
+      return SearchableText(log).find(FoldCase(node.value)) !=
+             std::string::npos;
+    case Kind::kDate:
+      return log.created_at >= node.min && log.created_at < node.max;
+    case Kind::kId:
+      return static_cast<uint64_t>(log.id) >= node.min &&
+             static_cast<uint64_t>(log.id) <= node.max;
+  }
+  return false;
+}
+
+std::vector<std::string> QueryTexts(const QueryNode& node) {
+  std::vector<std::string> texts;
+  if (node.kind == Kind::kNot) {
+    return texts;
+  }
+
+  if (node.kind == Kind::kText) {
+    texts.push_back(node.value);
+  }
+
+  for (const auto& child : node.children) {
+    for (auto& text : QueryTexts(*child)) {
+      texts.push_back(std::move(text));
+    }
+  }
+
+  return texts;
+}
+
+std::string QueryNodeToString(const QueryNode& node) {
+  auto range = [](uint64_t min, uint64_t max, bool is_date) {
+    auto bound = [is_date](uint64_t value) {
+      return is_date ? atl::FormatTime(value) : std::to_string(value);
+    };
+
+    std::string from = min == 0 ? "" : bound(min);
+    std::string to = max == std::numeric_limits<uint64_t>::max()
+                         ? ""
+                         : bound(is_date ? max - 1 : max);
+    return from == to ? from : from + ".." + to;
+  };
+
+  switch (node.kind) {
+    case Kind::kAnd:
+      return "AND";
+    case Kind::kOr:
+      return "OR";
+    case Kind::kNot:
+      return "NOT";
+    case Kind::kTag:
+      return "tag:" + node.value;
+    case Kind::kSubject:
+      return "subject:\"" + node.value + "\"";
+    case Kind::kText:
+      return (node.word ? "" : "text:") + std::string("\"") + node.value + "\"";
+    case Kind::kDate:
+      return "date:" + range(node.min, node.max, true);
+    case Kind::kId:
+      return "id:" + range(node.min, node.max, false);
+  }
+  return "";
+}
+
+}  // namespace worklog
@@ -0,0 +1,75 @@
+#ifndef QUERY_H_
+#define QUERY_H_
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "atl/status.h"
+
+#include "worklog.h"
+
+namespace worklog {
+
+// QueryNode is a node of the parsed search query (see ParseQuery).
+struct QueryNode {
+  enum class Kind {
+    kAnd,
+    kOr,
+    kNot,
+    kTag,      // tag:php
+    kSubject,  // subject:laravel (case sensitive substring)
+    kText,     // text:"lock contention" or a plain word (case insensitive
+               // substring of the subject or the description)
+    kDate,     // date:2017-01..2017-06 (created_at in [min, max))
+    kId,       // id:10..20 (id in [min, max])
+  };
+
+  Kind kind;
+  std::vector<std::unique_ptr<QueryNode>> children;
+
+  std::string value;
+
+  // The text came from a plain word (ranked searches rank by those words
+  // instead of filtering by them).
+  bool word = false;
+
+  uint64_t min = 0;
+  uint64_t max = std::numeric_limits<uint64_t>::max();
+
+  // Estimated by the planner: share of logs which match and the cost of
+  // evaluating the node for a single log.
+  double selectivity = 1.0;
+  double cost = 0.0;
+};
+
+// Parses a search query. The grammar is:
+//
+//   query   := or
+//   or      := and ("OR" and)*
+//   and     := not ("AND"? not)*
+//   not     := ("NOT" | "-") not | primary
+//   primary := "(" query ")" | key ":" value | word
+//
+// The keys are tag, subject, text, date & id. Dates can be given as
+// 2017, 2017-06 or 2017-06-24, ids as numbers; both also as ranges with
+// an optional start or end (2017-01..2017-06, ..2016, id:100..).
+// Values with spaces must be in double quotes.
+atl::Status ParseQuery(const std::string& text,
+                       std::unique_ptr<QueryNode>* query);
+
+// Evaluates the query against a log. The children are evaluated in their
+// order and short circuited. If rank_words is set, plain words (and their
+// negation) match every log because a ranked search ranks by them instead.
+bool Matches(const QueryNode& node, const Log& log, bool rank_words = false);
+
+// Returns the (positive) words & text values of the query.
+std::vector<std::string> QueryTexts(const QueryNode& node);
+
+std::string QueryNodeToString(const QueryNode& node);
+
+}  // namespace worklog
+
+#endif  // QUERY_H_
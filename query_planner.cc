@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "filter.h"
+#include "query_planner.h"
+#include "tag_tree.h"
+
+namespace worklog {
+
+namespace {
+using Kind = QueryNode::Kind;
+
+// Relative costs of evaluating a leaf for one log:
+const double kRangeCost = 1.0;
+const double kTagCost = 2.0;
+const double kSubjectCost = 10.0;
+const double kTextCost = 100.0;
+
+// Guess for substrings of the subject, there is no index for them:
+const double kSubjectSelectivity = 0.1;
+
+bool IsLeaf(const QueryNode& node) {
+  return node.kind != Kind::kAnd && node.kind != Kind::kOr &&
+         node.kind != Kind::kNot;
+}
+
+bool IsDriver(const QueryPlan& plan, const QueryNode* node) {
+  return std::find(plan.drivers.begin(), plan.drivers.end(), node) !=
+         plan.drivers.end();
+}
+
+// Evaluates the query without the drivers (which the candidates already
+// match).
+bool MatchesResidual(const QueryNode& query, const QueryPlan& plan,
+                     const Log& log) {
+  // A single driver or all children of an OR query:
+  if (IsDriver(plan, &query) || plan.drivers.size() > 1) {
+    return true;
+  }
+
+  if (query.kind != Kind::kAnd) {
+    return Matches(query, log);
+  }
+
+  for (const auto& child : query.children) {
+    if (!IsDriver(plan, child.get()) && !Matches(*child, log)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ExplainNode(const QueryNode& node, const QueryPlan& plan, int depth,
+                 std::ostringstream* out) {
+  *out << std::string(2 * depth, ' ') << QueryNodeToString(node)
+       << "  (selectivity " << std::setprecision(3) << node.selectivity
+       << ", cost " << node.cost << ")";
+  if (IsDriver(plan, &node)) {
+    *out << "  <- access path";
+  }
+  *out << "\n";
+
+  for (const auto& child : node.children) {
+    ExplainNode(*child, plan, depth + 1, out);
+  }
+}
+}  // namespace
+
+QueryPlanner::QueryPlanner(IndexSet* indexes) : indexes_(indexes) {
+  CollectStats();
+}
+
+void QueryPlanner::CollectStats() {
+  const Index& index = indexes_->index();
+  const ColumnIndex& columns = indexes_->columns();
+
+  // Counted by tag id over the columns, the names are only looked up once:
+  std::vector<std::size_t> counts(columns.num_tags(), 0);
+  for (std::size_t row = 0; row < columns.size(); row++) {
+    if (index.IsDeleted(columns.id(row))) {
+      continue;
+    }
+
+    num_logs_++;
+    for (auto tag = columns.tags_begin(row); tag != columns.tags_end(row);
+         ++tag) {
+      counts[*tag]++;
+    }
+  }
+
+  for (uint32_t tag = 0; tag < counts.size(); tag++) {
+    if (counts[tag] > 0) {
+      tag_counts_[columns.tag_name(tag)] = counts[tag];
+    }
+  }
+
+  if (columns.size() > 0) {
+    first_id_ = columns.id(0);
+    last_id_ = columns.id(columns.size() - 1);
+  }
+}
+
+double QueryPlanner::Overlap(uint64_t min, uint64_t max, uint64_t first,
+                             uint64_t last) {
+  uint64_t from = std::max(min, first);
+  uint64_t to = std::min(max, last);
+  if (from > to) {
+    return 0.0;
+  }
+
+  // +1 so a single value range isn't empty:
+  return (static_cast<double>(to - from) + 1.0) /
+         (static_cast<double>(last - first) + 1.0);
+}
+
+void QueryPlanner::EstimateLeaf(QueryNode* node) {
+  const double n = std::max<std::size_t>(num_logs_, 1);
+
+  switch (node->kind) {
+    case Kind::kTag: {
+      if (!IsTagPrefixPattern(node->value)) {
+        auto found = tag_counts_.find(node->value);
+        node->selectivity =
+            found == tag_counts_.end() ? 0.0 : found->second / n;
+      } else {
+        // The tags with the prefix are a range of the sorted counts. Logs
+        // with several of them are counted more than once:
+        const std::string prefix = TagPatternPrefix(node->value);
+        std::size_t count = 0;
+        for (auto tag = tag_counts_.lower_bound(prefix);
+             tag != tag_counts_.end() &&
+             tag->first.compare(0, prefix.size(), prefix) == 0;
+             ++tag) {
+          count += tag->second;
+        }
+        node->selectivity = count / n;
+      }
+      node->cost = kTagCost;
+      break;
+    }
+    case Kind::kSubject:
+      node->selectivity = kSubjectSelectivity;
+      node->cost = kSubjectCost;
+      break;
+    case Kind::kText:
+      node->selectivity =
+          indexes_->trigrams().EstimateMatches(node->value, num_logs_) / n;
+      node->cost = kTextCost;
+      break;
+    case Kind::kDate: {
+      // Exact (apart from deleted logs), two binary searches:
+      auto range = indexes_->time_index().Range(node->min, node->max);
+      node->selectivity = (range.second - range.first) / n;
+      node->cost = kRangeCost;
+      break;
+    }
+    case Kind::kId:
+      node->selectivity = Overlap(node->min, node->max, first_id_, last_id_);
+      node->cost = kRangeCost;
+      break;
+    default:
+      break;
+  }
+
+  node->selectivity = std::min(node->selectivity, 1.0);
+}
+
+void QueryPlanner::Estimate(QueryNode* node) {
+  if (IsLeaf(*node)) {
+    EstimateLeaf(node);
+    return;
+  }
+
+  for (auto& child : node->children) {
+    Estimate(child.get());
+  }
+
+  auto& children = node->children;
+  switch (node->kind) {
+    case Kind::kNot:
+      node->selectivity = 1.0 - children[0]->selectivity;
+      node->cost = children[0]->cost;
+      break;
+    case Kind::kAnd: {
+      // The classic ordering for short circuited conjunctions: ascending
+      // cost / (1 - selectivity), ie. the children which are cheap and
+      // reject most logs come first.
+      auto rank = [](const QueryNode& child) {
+        double rejected = 1.0 - child.selectivity;
+        return rejected <= 0.0 ? std::numeric_limits<double>::infinity()
+                               : child.cost / rejected;
+      };
+      std::stable_sort(children.begin(), children.end(),
+                       [&rank](const std::unique_ptr<QueryNode>& a,
+                               const std::unique_ptr<QueryNode>& b) {
+                         return rank(*a) < rank(*b);
+                       });
+
+      double reached = 1.0;
+      node->cost = 0.0;
+      for (const auto& child : children) {
+        node->cost += reached * child->cost;
+        reached *= child->selectivity;
+      }
+      node->selectivity = reached;
+      break;
+    }
+    case Kind::kOr: {
+      // Same for disjunctions with the accepted instead of the rejected
+      // share: ascending cost / selectivity.
+      auto rank = [](const QueryNode& child) {
+        return child.selectivity <= 0.0
+                   ? std::numeric_limits<double>::infinity()
+                   : child.cost / child.selectivity;
+      };
+      std::stable_sort(children.begin(), children.end(),
+                       [&rank](const std::unique_ptr<QueryNode>& a,
+                               const std::unique_ptr<QueryNode>& b) {
+                         return rank(*a) < rank(*b);
+                       });
+
+      double reached = 1.0;
+      node->cost = 0.0;
+      for (const auto& child : children) {
+        node->cost += reached * child->cost;
+        reached *= 1.0 - child->selectivity;
+      }
+      node->selectivity = 1.0 - reached;
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+QueryPlan QueryPlanner::Plan(QueryNode* query) {
+  Estimate(query);
+
+  QueryPlan plan;
+  plan.num_logs = num_logs_;
+  plan.estimated_candidates = num_logs_;
+
+  // Only a leaf which every match has to satisfy can drive the access:
+  std::vector<const QueryNode*> conjuncts;
+  if (query->kind == Kind::kAnd) {
+    for (const auto& child : query->children) {
+      conjuncts.push_back(child.get());
+    }
+  } else {
+    conjuncts.push_back(query);
+  }
+
+  for (const QueryNode* node : conjuncts) {
+    QueryPlan::Access access;
+    if (node->kind == Kind::kText && node->value.size() >= 3) {
+      access = QueryPlan::Access::kTrigrams;
+    } else if (node->kind == Kind::kId) {
+      access = QueryPlan::Access::kIdRange;
+    } else if (node->kind == Kind::kDate) {
+      access = QueryPlan::Access::kDateRange;
+    } else if (node->kind == Kind::kTag) {
+      access = QueryPlan::Access::kTags;
+    } else {
+      continue;
+    }
+
+    double candidates = node->selectivity * num_logs_;
+    if (candidates < plan.estimated_candidates) {
+      plan.access = access;
+      plan.drivers = {node};
+      plan.estimated_candidates = candidates;
+    }
+  }
+
+  // The date ranges of an OR query are runs in the listing order which are
+  // merged:
+  if (query->kind == Kind::kOr) {
+    double candidates = 0.0;
+    std::vector<const QueryNode*> drivers;
+    for (const auto& child : query->children) {
+      if (child->kind != Kind::kDate) {
+        drivers.clear();
+        break;
+      }
+      drivers.push_back(child.get());
+      candidates += child->selectivity * num_logs_;
+    }
+
+    if (!drivers.empty() && candidates < plan.estimated_candidates) {
+      plan.access = QueryPlan::Access::kDateRange;
+      plan.drivers = drivers;
+      plan.estimated_candidates = candidates;
+    }
+  }
+
+  return plan;
+}
+
+std::unique_ptr<LogIterator> QueryPlanner::Iterate(const QueryPlan& plan,
+                                                   const QueryNode& query,
+                                                   std::size_t end) {
+  const Index& index = indexes_->index();
+  const TimeIndex& times = indexes_->time_index();
+
+  std::unique_ptr<LogIterator> candidates;
+  if (plan.access == QueryPlan::Access::kDateRange) {
+    std::vector<std::unique_ptr<LogIterator>> runs;
+    for (const QueryNode* driver : plan.drivers) {
+      auto range = times.Range(driver->min, driver->max);
+      runs.push_back(IterateNewestFirst(index, times, range.first,
+                                        std::min(range.second, end)));
+    }
+    candidates = runs.size() == 1 ? std::move(runs[0])
+                                  : MergeNewestFirst(std::move(runs));
+  } else {
+    candidates = IterateNewestFirst(index, times, 0, end);
+  }
+
+  auto only_valid = OnlyValidFilter(indexes_->columns());
+  return FilterLogs(std::move(candidates),
+                    [only_valid, &query, &plan](const Log& log) {
+                      return only_valid(log) &&
+                             MatchesResidual(query, plan, log);
+                    });
+}
+
+std::vector<int> QueryPlanner::Execute(const QueryPlan& plan,
+                                       const QueryNode& query) {
+  std::vector<int> ids;
+
+  if (plan.ordered()) {
+    auto logs = Iterate(plan, query, indexes_->time_index().size());
+    while (const Log* log = logs->Next()) {
+      ids.push_back(log->id);
+    }
+    return ids;
+  }
+
+  const Index& index = indexes_->index();
+  auto only_valid = OnlyValidFilter(indexes_->columns());
+
+  auto check = [&](int id) {
+    auto found = index.entries().find(id);
+    if (found == index.entries().end() || index.IsDeleted(id)) {
+      return;
+    }
+
+    const Log& log = found->second.log;
+    if (only_valid(log) && MatchesResidual(query, plan, log)) {
+      ids.push_back(id);
+    }
+  };
+
+  const QueryNode* driver = plan.drivers[0];
+  if (plan.access == QueryPlan::Access::kTrigrams) {
+    for (int id : indexes_->trigrams().Search(index, driver->value)) {
+      check(id);
+    }
+  } else if (plan.access == QueryPlan::Access::kTags) {
+    // A prefix is expanded to the ids of its tags once, the rows are then
+    // matched by tag id:
+    const ColumnIndex& columns = indexes_->columns();
+    const std::vector<bool> tags = columns.MatchTags(driver->value);
+    for (std::size_t row = 0; row < columns.size(); row++) {
+      for (auto tag = columns.tags_begin(row); tag != columns.tags_end(row);
+           ++tag) {
+        if (tags[*tag]) {
+          check(columns.id(row));
+          break;
+        }
+      }
+    }
+  } else {
+    const auto& entries = index.entries();
+    uint64_t max_id =
+        std::min<uint64_t>(driver->max, std::numeric_limits<int>::max());
+    auto it = entries.lower_bound(
+        static_cast<int>(std::min<uint64_t>(driver->min, max_id)));
+    for (; it != entries.end() && static_cast<uint64_t>(it->first) <= max_id;
+         ++it) {
+      check(it->first);
+    }
+  }
+
+  return ids;
+}
+
+std::string QueryPlanner::Explain(const QueryPlan& plan,
+                                  const QueryNode& query) const {
+  std::ostringstream out;
+
+  out << "Access: ";
+  switch (plan.access) {
+    case QueryPlan::Access::kScan:
+      out << "scan of all logs";
+      break;
+    case QueryPlan::Access::kTrigrams:
+      out << "trigram index on " << QueryNodeToString(*plan.drivers[0]);
+      break;
+    case QueryPlan::Access::kIdRange:
+      out << "id range " << QueryNodeToString(*plan.drivers[0]);
+      break;
+    case QueryPlan::Access::kTags:
+      out << "tag ids of " << QueryNodeToString(*plan.drivers[0]);
+      break;
+    case QueryPlan::Access::kDateRange:
+      out << (plan.drivers.size() > 1 ? "merged time index ranges"
+                                      : "time index range");
+      for (const QueryNode* driver : plan.drivers) {
+        out << " " << QueryNodeToString(*driver);
+      }
+      break;
+  }
+  out << " (~" << static_cast<std::size_t>(plan.estimated_candidates + 0.5)
+      << " of " << plan.num_logs << " logs)\n";
+
+  out << "Estimated matches: ~"
+      << static_cast<std::size_t>(query.selectivity * plan.num_logs + 0.5)
+      << "\n";
+
+  ExplainNode(query, plan, 0, &out);
+  return out.str();
+}
+
+}  // namespace worklog
@@ -0,0 +1,86 @@
+#ifndef QUERY_PLANNER_H_
+#define QUERY_PLANNER_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "index_set.h"
+#include "log_iterator.h"
+#include "query.h"
+
+namespace worklog {
+
+struct QueryPlan {
+  // How the candidate logs are found before the rest of the query (the
+  // residual) is evaluated against them.
+  enum class Access {
+    kScan,       // every log, newest first (TimeIndex)
+    kTrigrams,   // the logs containing the text of the driver (TrigramIndex)
+    kIdRange,    // the logs in the id range of the driver
+    kDateRange,  // the logs in the date ranges of the drivers, newest first
+                 // (TimeIndex)
+    kTags,       // the logs with a tag matching the driver (ColumnIndex)
+  };
+
+  Access access = Access::kScan;
+
+  // The leaves the candidates are found by, none for a scan. They are not
+  // evaluated again. Several drivers are the children of an OR query whose
+  // ranges are merged.
+  std::vector<const QueryNode*> drivers;
+
+  // Whether the candidates come in the listing order (see Iterate).
+  bool ordered() const {
+    return access == Access::kScan || access == Access::kDateRange;
+  }
+
+  std::size_t num_logs = 0;
+  double estimated_candidates = 0.0;
+};
+
+// QueryPlanner estimates the selectivity & the cost of every node of a
+// query from statistics of the indexes, orders the children of AND & OR
+// nodes so the cheap & selective ones are evaluated first and picks an
+// access path for the logs.
+class QueryPlanner {
+ public:
+  explicit QueryPlanner(IndexSet* indexes);
+
+  // Annotates & reorders the query.
+  QueryPlan Plan(QueryNode* query);
+
+  // Yields the valid logs matching the planned query newest first, which
+  // are before the position end of the TimeIndex (see PageEnd). Only for
+  // ordered() plans, the logs are found as they are pulled.
+  std::unique_ptr<LogIterator> Iterate(const QueryPlan& plan,
+                                       const QueryNode& query,
+                                       std::size_t end);
+
+  // Returns the ids of the valid logs matching the planned query.
+  std::vector<int> Execute(const QueryPlan& plan, const QueryNode& query);
+
+  std::string Explain(const QueryPlan& plan, const QueryNode& query) const;
+
+ private:
+  void CollectStats();
+  void Estimate(QueryNode* node);
+  void EstimateLeaf(QueryNode* node);
+
+  // The share of [min, max] (inclusive) which overlaps [first, last].
+  static double Overlap(uint64_t min, uint64_t max, uint64_t first,
+                        uint64_t last);
+
+  IndexSet* indexes_;
+
+  std::size_t num_logs_ = 0;
+  std::map<std::string, std::size_t> tag_counts_;
+  int first_id_ = 0;
+  int last_id_ = 0;
+};
+
+}  // namespace worklog
+
+#endif  // QUERY_PLANNER_H_
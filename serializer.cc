@@ -12,66 +12,124 @@ std::string HumanSerializer::Serialize(const Log& log) {
   std::ostringstream text;
 
   text << "date=" << atl::FormatTime(log.created_at) << "\n";
-  text << "tags=" << atl::Join(log.tags, ", ") << "\n\n";
+  text << "tags=" << atl::Join(log.tags, ", ") << "\n";
+  for (const auto& field : log.metadata) {
+    text << field.first << "=" << field.second << "\n";
+  }
+  text << "\n";
   text << atl::TrimSpace(log.subject) << "\n\n";
   text << atl::TrimSpace(log.description) << "\n\n";
 
   return text.str();
 }
 
+namespace {
+// Same as atl::TrimSpace but without copying. Like atl::TrimSpace the text
+// is returned unchanged if it consists of spaces only.
+atl::StringView TrimSpaceView(atl::StringView text) {
+  const char* spaces = " \t\r\n";
+
+  auto begin = text.find_first_not_of(spaces);
+  if (begin == atl::StringView::npos) {
+    return text;
+  }
+
+  auto end = text.find_last_not_of(spaces);
+  return text.substr(begin, end - begin + 1);
+}
+
+// Calls fn with the parts of text between the delimiters exactly like
+// atl::Split (without ignore_empty) returns them, but without copying.
+template <typename Fn>
+void ForEachPart(atl::StringView text, char delim, Fn fn) {
+  std::size_t pos = 0;
+  while (pos < text.size()) {
+    auto n = text.find(delim, pos);
+    if (n == atl::StringView::npos) {
+      break;
+    }
+
+    fn(text.substr(pos, n - pos));
+    pos = n + 1;
+  }
+
+  if (pos < text.size()) {
+    fn(text.substr(pos));
+  }
+}
+}  // namespace
+
 Log HumanSerializer::Unserialize(const std::string& text) {
   Log log;
 
   log.created_at = 0;
   log.id = 0;
 
-  bool ignore_empty = false;
-
-  auto res = atl::Split(text, "\n", ignore_empty);
-  for (const auto& bit : res) {
-    if (IsTag(bit)) {
-      std::vector<std::string> tag = atl::Split(bit, "=");
+  // The lines & their parts are views into the text, parsing a log only
+  // allocates for the fields it fills in. Only the lines before the first
+  // blank line or the subject are fields, the text after them is kept as
+  // it is even if it contains a '=':
+  bool in_header = true;
+  atl::StringView content(text);
+  ForEachPart(content, '\n', [&](atl::StringView bit) {
+    in_header = in_header && bit.find('=') != atl::StringView::npos;
+    if (in_header) {
+      atl::StringView tag[2];
+      int num_parts = 0;
+      ForEachPart(bit, '=', [&](atl::StringView part) {
+        if (num_parts < 2) {
+          tag[num_parts] = part;
+        }
+        num_parts++;
+      });
 
-      if (tag.size() != 2) {
-        continue;
+      if (num_parts != 2) {
+        return;
       }
 
       // The tag's can come along like 'tag= xxx', '   tag   =    xxx'
       // thats why we TrimSpace it here:
-      const std::string& tag_name = atl::TrimSpace(tag[0]);
-      const std::string& tag_value = atl::TrimSpace(tag[1]);
+      atl::StringView tag_name = TrimSpaceView(tag[0]);
+      atl::StringView tag_value = TrimSpaceView(tag[1]);
 
-      if (tag_name == "" || tag_value == "") {
-        continue;
+      if (tag_name.empty() || tag_value.empty()) {
+        return;
       }
 
       if (tag_name == "tags") {
         // the tag is of type 'tags' which will contain multiple
         // comma separated values:
-        auto tags = atl::Split(tag_value, ",");
-        for (auto v : tags) {
-          log.tags.insert(atl::TrimSpace(v));
-        }
+        ForEachPart(tag_value, ',', [&](atl::StringView v) {
+          log.tags.insert(TrimSpaceView(v).to_string());
+        });
 
       } else if (tag_name == "date") {
         // the tag is of type 'date' which will contain a date
         // in the format: 2017-12-30
-        auto time = atl::ParseTime(tag_value);
+        auto time = atl::ParseTime(tag_value.to_string());
         if (!time.second) {
-          continue;
+          return;
         }
 
         log.created_at = atl::UnixTimestamp(time.first);
       } else {
-        // TODO(an): Unknkown tag - handle here
+        // Any other tag is a custom field (see Log::metadata):
+        log.metadata[tag_name.to_string()] = tag_value.to_string();
       }
     } else if (log.subject == "") {
-      log.subject = bit;
+      log.subject = bit.to_string();
     } else {
-      log.description += bit + "\n";
+      // The rest of the text is an upper bound for the description:
+      if (log.description.empty()) {
+        log.description.reserve(content.end() - bit.begin() + 1);
+      }
+
+      log.description.append(bit.data(), bit.size());
+      log.description += '\n';
     }
-  }
+  });
 
+  log.has_description = !log.description.empty();
   return log;
 }
 
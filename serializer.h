@@ -17,11 +17,6 @@ class HumanSerializer {
   //            because this will fail badly if there is no tag and the
   //            description or subject contains a '='.
   Log Unserialize(const std::string& text);
-
- private:
-  bool IsTag(const std::string& text) {
-    return text.find("=") != std::string::npos;
-  }
 };
 } // namespace worklog
 #endif  // SERIALIZER_H_
@@ -0,0 +1,678 @@
+#include <algorithm>
+#include <ctime>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "atl/arena.h"
+#include "atl/string.h"
+
+#include "civil_day.h"
+#include "stats.h"
+#include "term_counter.h"
+#include "time_sort.h"
+#include "tokenizer.h"
+
+namespace worklog {
+
+namespace {
+// Below this many logs the stats are computed by a single thread.
+constexpr std::size_t kMinParallelStatsSize = 1 << 18;
+
+// Counting terms takes much longer per log.
+constexpr std::size_t kMinParallelTermsSize = 1 << 12;
+
+// Common English words, sorted. They would top the terms of every group.
+const char* const kStopWords[] = {
+    "a",     "about", "after", "all",   "also",  "an",    "and",   "any",
+    "are",   "as",    "at",    "be",    "been",  "but",   "by",    "can",
+    "could", "did",   "do",    "does",  "for",   "from",  "had",   "has",
+    "have",  "he",    "her",   "his",   "how",   "i",     "if",    "in",
+    "into",  "is",    "it",    "its",   "just",  "may",   "me",    "more",
+    "my",    "no",    "not",   "of",    "on",    "one",   "or",    "other",
+    "our",   "out",   "she",   "so",    "some",  "than",  "that",  "the",
+    "their", "them",  "then",  "there", "these", "they",  "this",  "to",
+    "up",    "us",    "was",   "we",    "were",  "what",  "when",  "which",
+    "who",   "will",  "with",  "would", "you",   "your"};
+
+bool IsStopWord(atl::StringView word) {
+  return std::binary_search(
+      std::begin(kStopWords), std::end(kStopWords), word,
+      [](atl::StringView a, atl::StringView b) { return a < b; });
+}
+
+std::string PeriodLabel(const std::tm& t, TimeBucket bucket) {
+  const char* format = "all";
+  switch (bucket) {
+    case TimeBucket::kNone:
+      return "all";
+    case TimeBucket::kYear:
+      format = "%Y";
+      break;
+    case TimeBucket::kMonth:
+      format = "%Y-%m";
+      break;
+    case TimeBucket::kWeek:
+      format = "%G-W%V";
+      break;
+  }
+
+  char label[16];
+  std::size_t size = std::strftime(label, sizeof(label), format, &t);
+  return std::string(label, size);
+}
+
+struct RowKey {
+  uint64_t created_at;
+  int id;  // the row in the ColumnIndex, in id order like the logs
+};
+
+// The sorted rows [begin, end) share their created_at, their day & period
+// are computed once.
+struct Run {
+  std::size_t begin;
+  std::size_t end;
+  int64_t day;
+  uint32_t period;
+};
+
+// The stats of a group. The logs are added oldest first, so a streak only
+// grows at its end. Accumulators of consecutive chunks of days are merged,
+// that's what the streak at the start is kept for.
+struct Accumulator {
+  uint64_t count = 0;
+  uint64_t first = 0;
+  uint64_t last = 0;
+  int64_t first_day = 0;
+  int64_t last_day = 0;
+  uint32_t active_days = 0;
+  uint32_t prefix = 0;  // the streak starting at first_day
+  uint32_t suffix = 0;  // the streak ending at last_day
+  uint32_t longest = 0;
+
+  void Add(uint64_t created_at, int64_t day, uint64_t num_logs) {
+    if (count == 0) {
+      first = created_at;
+      first_day = last_day = day;
+      active_days = prefix = suffix = longest = 1;
+    } else if (day != last_day) {
+      bool next_day = day == last_day + 1;
+      if (next_day && prefix == active_days) {
+        prefix++;
+      }
+      suffix = next_day ? suffix + 1 : 1;
+      longest = std::max(longest, suffix);
+      active_days++;
+      last_day = day;
+    }
+
+    count += num_logs;
+    last = created_at;
+  }
+
+  // next holds the logs of the days after the ones of this accumulator.
+  void Merge(const Accumulator& next) {
+    if (next.count == 0) {
+      return;
+    }
+    if (count == 0) {
+      *this = next;
+      return;
+    }
+
+    bool adjacent = next.first_day == last_day + 1;
+    if (adjacent) {
+      longest = std::max(longest, suffix + next.prefix);
+    }
+    longest = std::max(longest, next.longest);
+
+    if (adjacent && prefix == active_days) {
+      prefix += next.prefix;
+    }
+    suffix = adjacent && next.suffix == next.active_days
+                 ? suffix + next.suffix
+                 : next.suffix;
+
+    count += next.count;
+    last = next.last;
+    last_day = next.last_day;
+    active_days += next.active_days;
+  }
+};
+
+// The sum, min & max of values. Merging doesn't depend on the order.
+struct ValueAccumulator {
+  uint64_t count = 0;
+  int64_t sum = 0;
+  int64_t min = std::numeric_limits<int64_t>::max();
+  int64_t max = std::numeric_limits<int64_t>::min();
+
+  void Add(int64_t value) {
+    count++;
+    sum += value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+
+  void Merge(const ValueAccumulator& other) {
+    count += other.count;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+  }
+
+  int64_t Result(AggregateOp op) const {
+    switch (op) {
+      case AggregateOp::kSum:
+        return sum;
+      case AggregateOp::kAvg:
+        return sum / static_cast<int64_t>(count);
+      case AggregateOp::kMin:
+        return min;
+      case AggregateOp::kMax:
+        return max;
+    }
+    return 0;
+  }
+};
+
+// The valid, not deleted rows sorted by time and the runs of them which
+// share their created_at.
+struct SortedRows {
+  std::vector<RowKey> rows;
+  std::vector<Run> runs;
+  std::vector<std::string> periods;  // oldest first
+};
+
+SortedRows SortRows(const Index& index, const ColumnIndex& columns,
+                    TimeBucket bucket, unsigned int num_threads) {
+  SortedRows sorted;
+  std::vector<RowKey>& rows = sorted.rows;
+  rows.reserve(columns.size());
+  for (std::size_t row = 0; row < columns.size(); row++) {
+    if (columns.valid(row) && !index.IsDeleted(columns.id(row))) {
+      rows.push_back({columns.created_at(row), static_cast<int>(row)});
+    }
+  }
+  SortByTime(&rows, num_threads);
+
+  // Logs share their created_at (the date) a lot, the conversions to local
+  // dates & period labels only happen once per distinct one:
+  std::vector<Run>& runs = sorted.runs;
+  std::vector<std::string>& periods = sorted.periods;
+  for (std::size_t pos = 0; pos < rows.size(); pos++) {
+    uint64_t created_at = rows[pos].created_at;
+    if (!runs.empty() && rows[runs.back().begin].created_at == created_at) {
+      runs.back().end = pos + 1;
+      continue;
+    }
+
+    std::time_t time = created_at;
+    std::tm t = {};
+    localtime_r(&time, &t);
+
+    std::string label = PeriodLabel(t, bucket);
+    if (periods.empty() || periods.back() != label) {
+      periods.push_back(label);
+    }
+
+    int64_t day = DaysFromCivil(t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    runs.push_back({pos, pos + 1, day,
+                    static_cast<uint32_t>(periods.size() - 1)});
+  }
+
+  return sorted;
+}
+
+// Splits the runs into at most num_threads chunks, one per thread. A chunk
+// doesn't split a day, so the accumulators of the chunks can be merged in
+// order. Returns the first run of every chunk followed by the number of
+// runs.
+std::vector<std::size_t> SplitIntoChunks(
+    const SortedRows& sorted, unsigned int num_threads,
+    std::size_t min_parallel_size = kMinParallelStatsSize) {
+  const std::vector<Run>& runs = sorted.runs;
+  const std::size_t num_rows = sorted.rows.size();
+  std::size_t num_chunks =
+      num_rows < min_parallel_size
+          ? 1
+          : std::min<std::size_t>(num_threads, runs.size());
+
+  std::vector<std::size_t> chunk_begins;
+  for (std::size_t chunk = 0; chunk < num_chunks; chunk++) {
+    std::size_t target = num_rows * chunk / num_chunks;
+    auto run = std::lower_bound(
+        runs.begin(), runs.end(), target,
+        [](const Run& run, std::size_t pos) { return run.end <= pos; });
+    while (run != runs.begin() && run != runs.end() &&
+           (run - 1)->day == run->day) {
+      ++run;
+    }
+
+    std::size_t begin = run - runs.begin();
+    if (chunk_begins.empty() || begin > chunk_begins.back()) {
+      chunk_begins.push_back(begin);
+    }
+  }
+  chunk_begins.push_back(runs.size());
+  return chunk_begins;
+}
+
+// Calls accumulate(chunk) for every chunk, the first one on this thread.
+template <typename Function>
+void RunChunks(std::size_t num_chunks, const Function& accumulate) {
+  std::vector<std::thread> threads;
+  for (std::size_t chunk = 1; chunk < num_chunks; chunk++) {
+    threads.emplace_back(accumulate, chunk);
+  }
+  if (num_chunks > 0) {
+    accumulate(0);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// What the rows are grouped by besides time: their tags, the value of an
+// enum field or nothing, then every row is in category 0.
+class Categories {
+ public:
+  Categories(const ColumnIndex& columns, const GroupBy& group_by)
+      : columns_(columns), tag_(group_by.tag), field_(!group_by.field.empty()) {
+    if (field_) {
+      key_ = columns.FindMetadataKey(group_by.field);
+    }
+  }
+
+  bool grouped() const { return tag_ || field_; }
+
+  std::size_t size() const {
+    if (tag_) {
+      return columns_.num_tags();
+    }
+    if (field_) {
+      return key_ ? columns_.num_enum_values() : 0;
+    }
+    return 1;
+  }
+
+  std::string name(std::size_t category) const {
+    if (tag_) {
+      return columns_.tag_name(category);
+    }
+    return field_ ? columns_.enum_value(category) : "";
+  }
+
+  template <typename Function>
+  void ForEach(std::size_t row, const Function& function) const {
+    if (tag_) {
+      for (auto tag = columns_.tags_begin(row); tag != columns_.tags_end(row);
+           ++tag) {
+        function(*tag);
+      }
+    } else if (field_) {
+      const MetadataCell* cell = key_ ? columns_.FindMetadata(row, *key_)
+                                      : nullptr;
+      if (cell != nullptr && cell->type == MetadataType::kEnum) {
+        function(cell->number);
+      }
+    } else {
+      function(0);
+    }
+  }
+
+ private:
+  const ColumnIndex& columns_;
+  const bool tag_;
+  const bool field_;
+  atl::Optional<uint32_t> key_;
+};
+
+// Orders the rows by group and then oldest period first. Grouped by a tag
+// or a field only, the rows with the largest value come first.
+template <typename Row, typename Value>
+void OrderRows(const GroupBy& group_by, std::vector<Row>* rows,
+               const Value& value) {
+  // The periods are oldest first already, within a group as well:
+  if (group_by.time == TimeBucket::kNone) {
+    std::sort(rows->begin(), rows->end(), [&](const Row& a, const Row& b) {
+      return value(a) > value(b) ||
+             (value(a) == value(b) && a.group < b.group);
+    });
+  } else {
+    std::stable_sort(
+        rows->begin(), rows->end(),
+        [](const Row& a, const Row& b) { return a.group < b.group; });
+  }
+}
+}  // namespace
+
+atl::StatusOr<GroupBy> ParseGroupBy(const std::string& text) {
+  GroupBy group_by;
+
+  for (const std::string& group : atl::Split(text, ",", true)) {
+    TimeBucket bucket = TimeBucket::kNone;
+    if (group == "year") {
+      bucket = TimeBucket::kYear;
+    } else if (group == "month") {
+      bucket = TimeBucket::kMonth;
+    } else if (group == "week") {
+      bucket = TimeBucket::kWeek;
+    } else {
+      if (group_by.tag || !group_by.field.empty()) {
+        return atl::Status(atl::error::INVALID_ARGUMENT,
+                           "Only one of tag & a field can be grouped by");
+      }
+      if (group == "tag") {
+        group_by.tag = true;
+      } else {
+        group_by.field = group;
+      }
+      continue;
+    }
+
+    if (group_by.time != TimeBucket::kNone) {
+      return atl::Status(atl::error::INVALID_ARGUMENT,
+                         "Only one of year, month & week can be grouped by");
+    }
+    group_by.time = bucket;
+  }
+
+  return group_by;
+}
+
+std::vector<StatsRow> ComputeStats(const Index& index,
+                                   const ColumnIndex& columns,
+                                   const GroupBy& group_by,
+                                   unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const SortedRows sorted =
+      SortRows(index, columns, group_by.time, num_threads);
+  const std::vector<std::size_t> chunk_begins =
+      SplitIntoChunks(sorted, num_threads);
+  const std::size_t num_chunks = chunk_begins.size() - 1;
+
+  // The groups are (category, period) pairs:
+  const Categories categories(columns, group_by);
+  const std::size_t num_periods = sorted.periods.size();
+  const std::size_t num_groups = categories.size() * num_periods;
+
+  std::vector<std::vector<Accumulator>> chunks(num_chunks);
+  RunChunks(num_chunks, [&](std::size_t chunk) {
+    std::vector<Accumulator>& groups = chunks[chunk];
+    groups.resize(num_groups);
+
+    for (std::size_t r = chunk_begins[chunk]; r < chunk_begins[chunk + 1];
+         r++) {
+      const Run& run = sorted.runs[r];
+      uint64_t created_at = sorted.rows[run.begin].created_at;
+
+      if (!categories.grouped()) {
+        groups[run.period].Add(created_at, run.day, run.end - run.begin);
+        continue;
+      }
+
+      for (std::size_t pos = run.begin; pos < run.end; pos++) {
+        categories.ForEach(sorted.rows[pos].id, [&](std::size_t category) {
+          groups[category * num_periods + run.period].Add(created_at,
+                                                          run.day, 1);
+        });
+      }
+    }
+  });
+
+  std::vector<Accumulator> groups(num_groups);
+  for (const auto& chunk : chunks) {
+    for (std::size_t group = 0; group < num_groups; group++) {
+      groups[group].Merge(chunk[group]);
+    }
+  }
+
+  std::vector<StatsRow> stats;
+  for (std::size_t group = 0; group < num_groups; group++) {
+    const Accumulator& acc = groups[group];
+    if (acc.count == 0) {
+      continue;
+    }
+
+    StatsRow row;
+    row.group = categories.name(group / num_periods);
+    row.period = sorted.periods[group % num_periods];
+    row.count = acc.count;
+    row.first = acc.first;
+    row.last = acc.last;
+    row.active_days = acc.active_days;
+    row.longest_streak = acc.longest;
+    stats.push_back(row);
+  }
+
+  if (categories.grouped()) {
+    OrderRows(group_by, &stats, [](const StatsRow& row) { return row.count; });
+  }
+  return stats;
+}
+
+atl::StatusOr<AggregateOp> ParseAggregateOp(const std::string& text) {
+  if (text == "sum") {
+    return AggregateOp::kSum;
+  } else if (text == "avg") {
+    return AggregateOp::kAvg;
+  } else if (text == "min") {
+    return AggregateOp::kMin;
+  } else if (text == "max") {
+    return AggregateOp::kMax;
+  }
+  return atl::Status(atl::error::INVALID_ARGUMENT,
+                     "Unknown aggregate: " + text +
+                         " (expected sum, avg, min or max)");
+}
+
+atl::StatusOr<AggregateResult> ComputeAggregate(const Index& index,
+                                                const ColumnIndex& columns,
+                                                AggregateOp op,
+                                                const std::string& field,
+                                                const GroupBy& group_by,
+                                                unsigned int num_threads) {
+  atl::Optional<uint32_t> key = columns.FindMetadataKey(field);
+  if (!key) {
+    return atl::Status(atl::error::NOT_FOUND, "Unknown field: " + field);
+  }
+
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const SortedRows sorted =
+      SortRows(index, columns, group_by.time, num_threads);
+  const std::vector<std::size_t> chunk_begins =
+      SplitIntoChunks(sorted, num_threads);
+  const std::size_t num_chunks = chunk_begins.size() - 1;
+
+  const Categories categories(columns, group_by);
+  const std::size_t num_periods = sorted.periods.size();
+  const std::size_t num_groups = categories.size() * num_periods;
+
+  // The type of the values is only known once all were seen, the durations
+  // & the integers are accumulated separately: the groups of a type are
+  // at [type * num_groups, (type + 1) * num_groups).
+  constexpr std::size_t kNumTypes = 3;
+  struct Chunk {
+    std::vector<ValueAccumulator> groups;
+    uint64_t type_counts[kNumTypes] = {};
+  };
+
+  std::vector<Chunk> chunks(num_chunks);
+  RunChunks(num_chunks, [&](std::size_t c) {
+    Chunk& chunk = chunks[c];
+    chunk.groups.resize(kNumTypes * num_groups);
+
+    for (std::size_t r = chunk_begins[c]; r < chunk_begins[c + 1]; r++) {
+      const Run& run = sorted.runs[r];
+      for (std::size_t pos = run.begin; pos < run.end; pos++) {
+        std::size_t row = sorted.rows[pos].id;
+        const MetadataCell* cell = columns.FindMetadata(row, *key);
+        if (cell == nullptr) {
+          continue;
+        }
+
+        std::size_t type = static_cast<std::size_t>(cell->type);
+        chunk.type_counts[type]++;
+        if (cell->type == MetadataType::kEnum) {
+          continue;
+        }
+
+        ValueAccumulator* groups = &chunk.groups[type * num_groups];
+        categories.ForEach(row, [&](std::size_t category) {
+          groups[category * num_periods + run.period].Add(cell->number);
+        });
+      }
+    }
+  });
+
+  uint64_t type_counts[kNumTypes] = {};
+  for (const auto& chunk : chunks) {
+    for (std::size_t type = 0; type < kNumTypes; type++) {
+      type_counts[type] += chunk.type_counts[type];
+    }
+  }
+
+  const uint64_t durations =
+      type_counts[static_cast<std::size_t>(MetadataType::kDuration)];
+  const uint64_t integers =
+      type_counts[static_cast<std::size_t>(MetadataType::kInteger)];
+  if (durations == 0 && integers == 0) {
+    return atl::Status(atl::error::INVALID_ARGUMENT,
+                       "The field " + field +
+                           " has no durations or integers to aggregate");
+  }
+
+  AggregateResult result;
+  result.type = durations >= integers ? MetadataType::kDuration
+                                      : MetadataType::kInteger;
+  result.skipped =
+      type_counts[static_cast<std::size_t>(MetadataType::kEnum)] +
+      std::min(durations, integers);
+
+  const std::size_t offset = static_cast<std::size_t>(result.type) * num_groups;
+  std::vector<ValueAccumulator> groups(num_groups);
+  for (const auto& chunk : chunks) {
+    for (std::size_t group = 0; group < num_groups; group++) {
+      groups[group].Merge(chunk.groups[offset + group]);
+    }
+  }
+
+  for (std::size_t group = 0; group < num_groups; group++) {
+    const ValueAccumulator& acc = groups[group];
+    if (acc.count == 0) {
+      continue;
+    }
+
+    AggregateRow row;
+    row.group = categories.name(group / num_periods);
+    row.period = sorted.periods[group % num_periods];
+    row.count = acc.count;
+    row.value = acc.Result(op);
+    result.rows.push_back(row);
+  }
+
+  if (categories.grouped()) {
+    OrderRows(group_by, &result.rows,
+              [](const AggregateRow& row) { return row.value; });
+  }
+  return result;
+}
+
+std::vector<TermsRow> ComputeTermStats(const Index& index,
+                                       const ColumnIndex& columns,
+                                       const GroupBy& group_by,
+                                       std::size_t limit,
+                                       unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const SortedRows sorted =
+      SortRows(index, columns, group_by.time, num_threads);
+  const std::vector<std::size_t> chunk_begins =
+      SplitIntoChunks(sorted, num_threads, kMinParallelTermsSize);
+  const std::size_t num_chunks = chunk_begins.size() - 1;
+
+  const Categories categories(columns, group_by);
+  const std::size_t num_periods = sorted.periods.size();
+  const std::size_t num_groups = categories.size() * num_periods;
+
+  struct Chunk {
+    atl::Arena arena;
+    std::vector<TermCounter> groups;
+    std::vector<uint64_t> counts;  // the logs per group
+  };
+
+  std::vector<std::unique_ptr<Chunk>> chunks(num_chunks);
+  RunChunks(num_chunks, [&](std::size_t c) {
+    chunks[c].reset(new Chunk());
+    Chunk& chunk = *chunks[c];
+    chunk.groups.assign(num_groups, TermCounter(&chunk.arena));
+    chunk.counts.assign(num_groups, 0);
+
+    // Reused for every log, the words point into the lower cased text:
+    std::string text;
+    std::vector<atl::StringView> words;
+    for (std::size_t r = chunk_begins[c]; r < chunk_begins[c + 1]; r++) {
+      const Run& run = sorted.runs[r];
+      for (std::size_t pos = run.begin; pos < run.end; pos++) {
+        std::size_t row = sorted.rows[pos].id;
+        auto found = index.entries().find(columns.id(row));
+        if (found == index.entries().end()) {
+          continue;
+        }
+
+        text.assign(found->second.log.description);
+        atl::ToLowerInPlace(&text[0], text.size());
+        words.clear();
+        ForEachWord(text, [&words](atl::StringView word) {
+          if (word.size() > 1 && !IsStopWord(word)) {
+            words.push_back(word);
+          }
+        });
+
+        categories.ForEach(row, [&](std::size_t category) {
+          std::size_t group = category * num_periods + run.period;
+          chunk.counts[group]++;
+          for (atl::StringView word : words) {
+            chunk.groups[group].Add(word);
+          }
+        });
+      }
+    }
+  });
+
+  atl::Arena arena;
+  std::vector<TermsRow> rows;
+  for (std::size_t group = 0; group < num_groups; group++) {
+    TermsRow row;
+    TermCounter terms(&arena);
+    for (const auto& chunk : chunks) {
+      row.count += chunk->counts[group];
+      terms.Merge(chunk->groups[group]);
+    }
+
+    if (row.count == 0) {
+      continue;
+    }
+
+    row.group = categories.name(group / num_periods);
+    row.period = sorted.periods[group % num_periods];
+    row.terms = terms.Top(limit);
+    rows.push_back(std::move(row));
+  }
+
+  if (categories.grouped()) {
+    OrderRows(group_by, &rows, [](const TermsRow& row) { return row.count; });
+  }
+  return rows;
+}
+
+}  // namespace worklog
@@ -0,0 +1,119 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "atl/statusor.h"
+
+#include "column_index.h"
+#include "index.h"
+#include "metadata.h"
+
+namespace worklog {
+
+// The time buckets logs can be grouped by. Weeks are ISO 8601 weeks.
+enum class TimeBucket { kNone, kYear, kMonth, kWeek };
+
+struct GroupBy {
+  TimeBucket time = TimeBucket::kNone;
+  bool tag = false;
+
+  // An enum field of the logs (see Log::metadata) like 'project', grouped
+  // by its values. Logs without it aren't in any group.
+  std::string field;
+};
+
+// Parses a comma separated list of 'year', 'month', 'week', 'tag' and
+// field names with at most one time bucket and one of tag or a field, ie.
+// "tag,month" or "project,week". An empty text groups nothing.
+atl::StatusOr<GroupBy> ParseGroupBy(const std::string& text);
+
+// The activity of a group: how many logs, the dates of the first & last
+// one, on how many days there were logs and the longest streak of
+// consecutive days with logs.
+struct StatsRow {
+  std::string group;   // the tag or field value, empty unless grouped by one
+  std::string period;  // ie. "2017", "2017-05" or "2017-W20"; "all" if
+                       // not grouped by time
+  uint64_t count = 0;
+  uint64_t first = 0;
+  uint64_t last = 0;
+  uint32_t active_days = 0;
+  uint32_t longest_streak = 0;
+};
+
+// Computes the stats of the valid, not deleted logs grouped by group_by.
+// Only the created_at, tag id & validity columns are read: the rows are
+// radix sorted by time once, every day is converted to a date once and
+// the groups are accumulated in a loop over the sorted rows. Large stores
+// are split into one chunk of days per thread (0 uses all cores) whose
+// results are merged.
+//
+// The rows come ordered by tag name and then oldest period first; grouped
+// by tag only, the most used tags come first.
+std::vector<StatsRow> ComputeStats(const Index& index,
+                                   const ColumnIndex& columns,
+                                   const GroupBy& group_by,
+                                   unsigned int num_threads = 0);
+
+enum class AggregateOp { kSum, kAvg, kMin, kMax };
+
+// Parses 'sum', 'avg', 'min' or 'max'.
+atl::StatusOr<AggregateOp> ParseAggregateOp(const std::string& text);
+
+struct AggregateRow {
+  std::string group;
+  std::string period;
+  uint64_t count = 0;  // the logs with a value
+  int64_t value = 0;   // averages are rounded down
+};
+
+struct AggregateResult {
+  // The type of the values: the one of most values of the field.
+  MetadataType type = MetadataType::kInteger;
+
+  // The values of another type, ie. '2' among durations. They are left out.
+  uint64_t skipped = 0;
+
+  std::vector<AggregateRow> rows;
+};
+
+// Computes op over the numeric values of a field of the valid, not deleted
+// logs grouped by group_by, ie. the sum of the durations per tag & month.
+// The same sorted rows & chunks as ComputeStats() are used, the rows come
+// in the same order too. Fails if the field has no duration or integer
+// values.
+atl::StatusOr<AggregateResult> ComputeAggregate(const Index& index,
+                                                const ColumnIndex& columns,
+                                                AggregateOp op,
+                                                const std::string& field,
+                                                const GroupBy& group_by,
+                                                unsigned int num_threads = 0);
+
+// The most frequent terms of the descriptions of a group.
+struct TermsRow {
+  std::string group;
+  std::string period;
+  uint64_t count = 0;  // the logs
+  std::vector<std::pair<std::string, uint64_t>> terms;
+};
+
+// Counts the words of the descriptions (lower cased, see ForEachWord) of
+// the valid, not deleted logs grouped by group_by and keeps the limit most
+// frequent ones per group. Single characters & common English words are
+// left out. Every chunk of days (see ComputeStats) is counted by its own
+// thread into TermCounters on its own arena, which are merged afterwards.
+// The index has to be loaded with the descriptions; the rows come in the
+// same order as the ones of ComputeStats().
+std::vector<TermsRow> ComputeTermStats(const Index& index,
+                                       const ColumnIndex& columns,
+                                       const GroupBy& group_by,
+                                       std::size_t limit,
+                                       unsigned int num_threads = 0);
+
+}  // namespace worklog
+
+#endif  // STATS_H_
@@ -1,22 +1,38 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "atl/file.h"
+#include "atl/lock.h"
 #include "atl/optional.h"
 #include "atl/status.h"
 #include "atl/statusor.h"
 #include "atl/string.h"
 
+#include "index_set.h"
 #include "serializer.h"
 #include "storage.h"
+#include "tombstone.h"
 #include "worklog.h"
 
 namespace worklog {
+std::string Storage::LogPath(int id) const {
+  return atl::JoinStr("/", config_.logs_dir, std::to_string(id));
+}
+
+bool Storage::IsDeleted(int id) {
+  Tombstones tombstones(config_);
+  tombstones.Load();
+  return tombstones.Contains(id);
+}
+
 atl::StatusOr<Log> Storage::LoadById(int id) {
-  std::string log_path =
-      atl::JoinStr("/", config_.logs_dir, std::to_string(id));
+  std::string log_path = LogPath(id);
 
-  if (!atl::FileExists(log_path)) {
+  if (!atl::FileExists(log_path) || IsDeleted(id)) {
     return atl::Status(atl::error::NOT_FOUND,
                        "The work log does not exist under: " + log_path);
   }
@@ -46,16 +62,28 @@ atl::Status Storage::Save(Log& log) {
   int next_id = next_id_value.value();
   log.id = next_id;
 
-  std::string log_path =
-      atl::JoinStr("/", config_.logs_dir, std::to_string(log.id));
+  {
+    atl::FileLock lock(config_.LockPath(), LogLockOffset(log.id),
+                       atl::FileLock::Mode::kExclusive);
+    if (!lock) {
+      return atl::Status(atl::error::UNAVAILABLE,
+                         "Failed to lock work log " + std::to_string(log.id));
+    }
 
-  if (atl::FileExists(log_path)) {
-    return atl::Status(atl::error::INTERNAL,
-                       "A worklog does already exist under: " + log_path);
-  }
+    std::string log_path = LogPath(log.id);
+
+    if (atl::FileExists(log_path)) {
+      return atl::Status(atl::error::INTERNAL,
+                         "A worklog does already exist under: " + log_path);
+    }
 
-  atl::FileWriteContent(log_path, hs_.Serialize(log));
+    atl::Status status = Write(log);
+    if (!status.ok()) {
+      return status;
+    }
+  }
 
+  UpdateIndexes(log.id);
   return atl::Status();
 }
 
@@ -65,15 +93,194 @@ atl::Status Storage::Update(const Log& log) {
                        "Worklog has no id, please use Save");
   }
 
-  std::string log_path =
-      atl::JoinStr("/", config_.logs_dir, std::to_string(log.id));
+  {
+    atl::FileLock lock(config_.LockPath(), LogLockOffset(log.id),
+                       atl::FileLock::Mode::kExclusive);
+    if (!lock) {
+      return atl::Status(atl::error::UNAVAILABLE,
+                         "Failed to lock work log " + std::to_string(log.id));
+    }
+
+    std::string log_path = LogPath(log.id);
+    if (!atl::FileExists(log_path) || IsDeleted(log.id)) {
+      return atl::Status(atl::error::INTERNAL,
+                         "A worklog does not yet exist under: " + log_path);
+    }
+
+    atl::Status status = Write(log);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  UpdateIndexes(log.id);
+  return atl::Status();
+}
+
+atl::Status Storage::Modify(int id, std::function<void(Log*)> modify) {
+  if (id <= 0) {
+    return atl::Status(atl::error::INVALID_ARGUMENT, "Invalid work log id");
+  }
+
+  {
+    atl::FileLock lock(config_.LockPath(), LogLockOffset(id),
+                       atl::FileLock::Mode::kExclusive);
+    if (!lock) {
+      return atl::Status(atl::error::UNAVAILABLE,
+                         "Failed to lock work log " + std::to_string(id));
+    }
+
+    atl::StatusOr<Log> loaded = LoadById(id);
+    if (!loaded.ok()) {
+      return loaded.status();
+    }
+
+    Log log = loaded.ValueOrDie();
+    modify(&log);
+    log.id = id;
+
+    atl::Status status = Write(log);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  UpdateIndexes(id);
+  return atl::Status();
+}
+
+atl::StatusOr<int> Storage::ModifyAll(const std::vector<int>& ids,
+                                      std::function<void(Log*)> modify,
+                                      unsigned int num_threads) {
+  if (ids.empty()) {
+    return 0;
+  }
+
+  // The tombstones are loaded once instead of once per log:
+  Tombstones tombstones(config_);
+  tombstones.Load();
+
+  std::atomic<std::size_t> next(0);
+  std::atomic<int> written(0);
+  std::mutex mutex;
+  int error_code = atl::error::OK;
+  std::string error_message;
+
+  auto modify_logs = [&]() {
+    // Each thread has its own serializer:
+    HumanSerializer hs;
+    for (std::size_t i = next++; i < ids.size(); i = next++) {
+      const int id = ids[i];
+      atl::FileLock lock(config_.LockPath(), LogLockOffset(id),
+                         atl::FileLock::Mode::kExclusive);
+      if (!lock) {
+        std::lock_guard<std::mutex> guard(mutex);
+        error_code = atl::error::UNAVAILABLE;
+        error_message = "Failed to lock work log " + std::to_string(id);
+        next = ids.size();
+        return;
+      }
+
+      atl::Optional<std::string> content =
+          tombstones.Contains(id) ? atl::Optional<std::string>()
+                                  : atl::FileReadContent(LogPath(id));
+      if (!content) {
+        continue;
+      }
+
+      Log log = hs.Unserialize(content.value());
+      modify(&log);
+      log.id = id;
+
+      if (!atl::FileWriteContentAtomic(LogPath(id), hs.Serialize(log))) {
+        std::lock_guard<std::mutex> guard(mutex);
+        error_code = atl::error::INTERNAL;
+        error_message = "Failed to write work log: " + LogPath(id);
+        next = ids.size();
+        return;
+      }
+      written++;
+    }
+  };
+
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min<std::size_t>(num_threads, ids.size());
+
+  std::vector<std::thread> threads;
+  for (unsigned int thread = 1; thread < num_threads; thread++) {
+    threads.emplace_back(modify_logs);
+  }
+  modify_logs();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // All the written logs are applied to the indexes at once, even after
+  // an error:
+  IndexSet indexes(config_);
+  indexes.Open(ids);
+
+  if (error_code != atl::error::OK) {
+    return atl::Status(error_code, error_message);
+  }
+  return written.load();
+}
+
+atl::Status Storage::Remove(int id) {
+  atl::FileLock lock(config_.LockPath(), LogLockOffset(id),
+                     atl::FileLock::Mode::kExclusive);
+  if (!lock) {
+    return atl::Status(atl::error::UNAVAILABLE,
+                       "Failed to lock work log " + std::to_string(id));
+  }
+
+  std::string log_path = LogPath(id);
+  if (!atl::FileExists(log_path) || IsDeleted(id)) {
+    return atl::Status(atl::error::NOT_FOUND,
+                       "The work log does not exist under: " + log_path);
+  }
+
+  Tombstones tombstones(config_);
+  return tombstones.Add(id);
+}
+
+atl::Status Storage::Undelete(int id) {
+  atl::FileLock lock(config_.LockPath(), LogLockOffset(id),
+                     atl::FileLock::Mode::kExclusive);
+  if (!lock) {
+    return atl::Status(atl::error::UNAVAILABLE,
+                       "Failed to lock work log " + std::to_string(id));
+  }
+
+  std::string log_path = LogPath(id);
   if (!atl::FileExists(log_path)) {
-    return atl::Status(atl::error::INTERNAL,
-                       "A worklog does not yet exist under: " + log_path);
+    return atl::Status(atl::error::NOT_FOUND,
+                       "The work log has already been compacted: " + log_path);
   }
 
-  atl::FileWriteContent(log_path, hs_.Serialize(log));
+  Tombstones tombstones(config_);
+  return tombstones.Remove(id);
+}
+
+atl::Status Storage::Write(const Log& log) {
+  // Written atomically, so unlocked readers never see a half written log:
+  std::string log_path = LogPath(log.id);
+  if (!atl::FileWriteContentAtomic(log_path, hs_.Serialize(log))) {
+    return atl::Status(atl::error::INTERNAL,
+                       "Failed to write work log: " + log_path);
+  }
 
   return atl::Status();
 }
+
+void Storage::UpdateIndexes(int id) {
+  // The index re-parses the log file, so it doesn't matter which of two
+  // concurrent writers of a log updates it last and the lock of the log
+  // isn't held meanwhile. Failing to update is no error because the
+  // indexes pick up the log on the next mtime sweep anyway:
+  IndexSet indexes(config_);
+  indexes.Open({id});
+}
 }  // namespace worklog
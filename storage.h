@@ -1,6 +1,10 @@
 #ifndef STORAGE_H_
 #define STORAGE_H_
 
+#include <functional>
+#include <string>
+#include <vector>
+
 #include "atl/status.h"
 #include "atl/statusor.h"
 
@@ -16,7 +20,34 @@ class Storage {
   atl::Status Save(Log& log);
   atl::Status Update(const Log& log);
 
+  // Loads, modifies and writes back a log while holding the log's lock, so
+  // concurrent modifications (ie. two 'tag add') don't get lost.
+  atl::Status Modify(int id, std::function<void(Log*)> modify);
+
+  // Modifies many logs like Modify() on num_threads threads (0 uses all
+  // cores), so modify must be thread safe. Only the files are written per
+  // log, the indexes are updated once at the end. Deleted & missing logs
+  // are skipped. Returns the number of written logs; after an error no
+  // further logs are started.
+  atl::StatusOr<int> ModifyAll(const std::vector<int>& ids,
+                               std::function<void(Log*)> modify,
+                               unsigned int num_threads = 0);
+
+  // Remove only marks the log as deleted (see Tombstones), so it can be
+  // brought back with Undelete until the next compaction.
+  atl::Status Remove(int id);
+  atl::Status Undelete(int id);
+
  private:
+  std::string LogPath(int id) const;
+  // Writes the file of the log, its lock has to be held.
+  atl::Status Write(const Log& log);
+
+  // Applies the written log to the indexes.
+  void UpdateIndexes(int id);
+
+  bool IsDeleted(int id);
+
   Config config_;
   HumanSerializer hs_;
 };
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tag_tree.h"
+
+namespace worklog {
+
+namespace {
+// Name order, but with '/' before every other character so the tags below
+// a tag directly follow it (lang, lang/cpp, lang/php, lang-tools).
+bool TreeOrder(const std::string& a, const std::string& b) {
+  std::size_t size = std::min(a.size(), b.size());
+  for (std::size_t i = 0; i < size; i++) {
+    if (a[i] != b[i]) {
+      if (a[i] == '/' || b[i] == '/') {
+        return a[i] == '/';
+      }
+      return static_cast<unsigned char>(a[i]) <
+             static_cast<unsigned char>(b[i]);
+    }
+  }
+  return a.size() < b.size();
+}
+}  // namespace
+
+bool IsTagPrefixPattern(const std::string& pattern) {
+  return !pattern.empty() && pattern.back() == '*';
+}
+
+std::string TagPatternPrefix(const std::string& pattern) {
+  return IsTagPrefixPattern(pattern) ? pattern.substr(0, pattern.size() - 1)
+                                     : pattern;
+}
+
+bool MatchesTagPattern(const std::string& tag, const std::string& pattern) {
+  if (!IsTagPrefixPattern(pattern)) {
+    return tag == pattern;
+  }
+
+  std::size_t size = pattern.size() - 1;
+  return tag.size() >= size && tag.compare(0, size, pattern, 0, size) == 0;
+}
+
+bool HasTagMatching(const std::set<std::string>& tags,
+                    const std::string& pattern) {
+  if (!IsTagPrefixPattern(pattern)) {
+    return tags.count(pattern) > 0;
+  }
+
+  // The first tag not before the prefix is the only candidate:
+  auto tag = tags.lower_bound(TagPatternPrefix(pattern));
+  return tag != tags.end() && MatchesTagPattern(*tag, pattern);
+}
+
+std::vector<TagTreeNode> ComputeTagTree(const Index& index,
+                                        const ColumnIndex& columns) {
+  std::vector<TagTreeNode> nodes;
+  std::unordered_map<std::string, uint32_t> node_ids;
+  auto intern = [&](const std::string& name, int depth) {
+    auto inserted = node_ids.emplace(name, nodes.size());
+    if (inserted.second) {
+      nodes.emplace_back();
+      nodes.back().name = name;
+      nodes.back().depth = depth;
+    }
+    return inserted.first->second;
+  };
+
+  // The nodes of the parents of a tag followed by its own one:
+  std::vector<std::vector<uint32_t>> paths(columns.num_tags());
+  for (uint32_t tag = 0; tag < columns.num_tags(); tag++) {
+    const std::string& name = columns.tag_name(tag);
+    int depth = 0;
+    for (std::size_t pos = name.find('/', 1); pos != std::string::npos;
+         pos = name.find('/', pos + 1)) {
+      paths[tag].push_back(intern(name.substr(0, pos), depth++));
+    }
+    paths[tag].push_back(intern(name, depth));
+  }
+
+  // A log with lang/php & lang/cpp counts once for lang, the row a node
+  // was last counted for tells:
+  std::vector<std::size_t> counted_row(nodes.size(), columns.size());
+  for (std::size_t row = 0; row < columns.size(); row++) {
+    if (!columns.valid(row) || index.IsDeleted(columns.id(row))) {
+      continue;
+    }
+
+    for (auto tag = columns.tags_begin(row); tag != columns.tags_end(row);
+         ++tag) {
+      const std::vector<uint32_t>& path = paths[*tag];
+      nodes[path.back()].count++;
+      for (uint32_t node : path) {
+        if (counted_row[node] != row) {
+          counted_row[node] = row;
+          nodes[node].total++;
+        }
+      }
+    }
+  }
+
+  nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                             [](const TagTreeNode& node) {
+                               return node.total == 0;
+                             }),
+              nodes.end());
+  std::sort(nodes.begin(), nodes.end(),
+            [](const TagTreeNode& a, const TagTreeNode& b) {
+              return TreeOrder(a.name, b.name);
+            });
+  return nodes;
+}
+
+}  // namespace worklog
@@ -0,0 +1,49 @@
+#ifndef TAG_TREE_H_
+#define TAG_TREE_H_
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "column_index.h"
+#include "index.h"
+
+namespace worklog {
+
+// Tags are hierarchical with '/' as the separator: lang/php is below lang.
+// A tag pattern ending with '*' matches every tag starting with the rest
+// of it, so lang/* matches lang/php & lang/cpp (not lang itself). Any
+// other pattern matches the tag of the same name.
+bool IsTagPrefixPattern(const std::string& pattern);
+
+// The pattern without the '*' of a prefix pattern.
+std::string TagPatternPrefix(const std::string& pattern);
+
+bool MatchesTagPattern(const std::string& tag, const std::string& pattern);
+
+// Whether any of the tags matches the pattern. A prefix pattern is a
+// lower_bound in the sorted tags instead of a look at all of them.
+bool HasTagMatching(const std::set<std::string>& tags,
+                    const std::string& pattern);
+
+// A tag of the hierarchy, the tags in use and all of their parents.
+struct TagTreeNode {
+  std::string name;  // the full name, ie. lang/php
+  int depth = 0;     // 0 for top level tags
+
+  uint64_t count = 0;  // the logs with the tag itself
+  uint64_t total = 0;  // the logs with the tag or any tag below it
+};
+
+// Rolls the counts of the valid, not deleted logs up the tag hierarchy,
+// each log counted once per node. Every tag id of the columns is mapped to
+// the ids of its node & its parents' nodes once, so the loop over the rows
+// only looks at ids. The nodes come depth first with the children in name
+// order.
+std::vector<TagTreeNode> ComputeTagTree(const Index& index,
+                                        const ColumnIndex& columns);
+
+}  // namespace worklog
+
+#endif  // TAG_TREE_H_
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "term_counter.h"
+
+namespace worklog {
+
+namespace {
+constexpr std::size_t kInitialSlots = 64;
+
+// FNV-1a, terms are short.
+uint64_t HashTerm(atl::StringView term) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char c : term) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+}  // namespace
+
+void TermCounter::Add(atl::StringView term, uint64_t count) {
+  Add(term, HashTerm(term), count);
+}
+
+void TermCounter::Add(atl::StringView term, uint64_t hash, uint64_t count) {
+  // At most half of the slots are used, so probing stays short:
+  if (2 * (size_ + 1) > slots_.size()) {
+    Grow();
+  }
+
+  const std::size_t mask = slots_.size() - 1;
+  for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+    Slot& slot = slots_[i];
+    if (slot.count == 0) {
+      slot.term = arena_->Copy(term);
+      slot.hash = hash;
+      slot.count = count;
+      size_++;
+      return;
+    }
+
+    if (slot.hash == hash && slot.term == term) {
+      slot.count += count;
+      return;
+    }
+  }
+}
+
+void TermCounter::Grow() {
+  std::vector<Slot> slots(
+      slots_.empty() ? kInitialSlots : 2 * slots_.size());
+  const std::size_t mask = slots.size() - 1;
+
+  // The terms stay in the arena, only the slots move:
+  for (const Slot& slot : slots_) {
+    if (slot.count == 0) {
+      continue;
+    }
+
+    std::size_t i = slot.hash & mask;
+    while (slots[i].count != 0) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = slot;
+  }
+  slots_.swap(slots);
+}
+
+void TermCounter::Merge(const TermCounter& other) {
+  for (const Slot& slot : other.slots_) {
+    if (slot.count > 0) {
+      Add(slot.term, slot.hash, slot.count);
+    }
+  }
+}
+
+std::vector<std::pair<std::string, uint64_t>> TermCounter::Top(
+    std::size_t limit) const {
+  std::vector<const Slot*> slots;
+  slots.reserve(size_);
+  for (const Slot& slot : slots_) {
+    if (slot.count > 0) {
+      slots.push_back(&slot);
+    }
+  }
+
+  limit = std::min(limit, slots.size());
+  std::partial_sort(slots.begin(), slots.begin() + limit, slots.end(),
+                    [](const Slot* a, const Slot* b) {
+                      return std::tie(b->count, a->term) <
+                             std::tie(a->count, b->term);
+                    });
+
+  std::vector<std::pair<std::string, uint64_t>> top;
+  for (std::size_t i = 0; i < limit; i++) {
+    top.emplace_back(slots[i]->term.to_string(), slots[i]->count);
+  }
+  return top;
+}
+
+}  // namespace worklog
@@ -0,0 +1,51 @@
+#ifndef TERM_COUNTER_H_
+#define TERM_COUNTER_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "atl/arena.h"
+#include "atl/string_view.h"
+
+namespace worklog {
+
+// TermCounter counts terms in an open addressing hash table (linear
+// probing, a power of two of slots). A term is copied into the arena the
+// first time it is seen, counting a known term doesn't allocate at all.
+// The arena can be shared by many counters (ie. of the groups counted by
+// one thread) and has to outlive them.
+class TermCounter {
+ public:
+  explicit TermCounter(atl::Arena* arena) : arena_(arena) {}
+
+  void Add(atl::StringView term, uint64_t count = 1);
+
+  // Adds the counts of other, its terms are copied into this arena.
+  void Merge(const TermCounter& other);
+
+  // The number of distinct terms.
+  std::size_t size() const { return size_; }
+
+  // The limit most frequent terms, by name for the same count.
+  std::vector<std::pair<std::string, uint64_t>> Top(std::size_t limit) const;
+
+ private:
+  struct Slot {
+    atl::StringView term;
+    uint64_t hash = 0;
+    uint64_t count = 0;  // 0 for an empty slot
+  };
+
+  void Add(atl::StringView term, uint64_t hash, uint64_t count);
+  void Grow();
+
+  atl::Arena* arena_;
+  std::vector<Slot> slots_;
+  std::size_t size_ = 0;
+};
+
+}  // namespace worklog
+
+#endif  // TERM_COUNTER_H_
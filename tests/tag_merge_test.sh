@@ -0,0 +1,53 @@
+#!/bin/sh
+# Checks that tag merge & tag rename apply every rename to the original tags
+# of a log, so a target below a source (ie. merge x x/y) isn't renamed
+# again. Usage: tag_merge_test.sh <path to the worklog binary>
+
+set -e
+
+WORKLOG=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+export EDITOR=true
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+cd "$DIR"
+"$WORKLOG" init
+
+# Writes log $1 with the tags $2.
+write_log() {
+  printf 'date=2017-06-0%s\ntags=%s\n\nSubject %s\n\nDescription\n\n' \
+    "$1" "$2" "$1" > ".worklog/logs/$1"
+}
+
+# Fails unless log $1 has exactly the tags $2.
+expect_tags() {
+  tags=$(grep '^tags=' ".worklog/logs/$1")
+  if [ "$tags" != "tags=$2" ]; then
+    echo "FAIL: log $1 has $tags, expected tags=$2"
+    exit 1
+  fi
+}
+
+write_log 1 "x"
+write_log 2 "x, x/y"
+write_log 3 "x/z, other"
+write_log 4 "x/y/w"
+echo 5 > .worklog/next_id
+
+"$WORKLOG" tag merge x x/y > "$DIR/out"
+expect_tags 1 "x/y"
+expect_tags 2 "x/y"
+expect_tags 3 "other, x/y/z"
+expect_tags 4 "x/y/w"
+
+if grep -q 'x/y/y' "$DIR/out"; then
+  echo "FAIL: renamed a target again:"
+  cat "$DIR/out"
+  exit 1
+fi
+
+# A rename into a tag below the source which isn't used yet:
+"$WORKLOG" tag rename other other/new > /dev/null
+expect_tags 3 "other/new, x/y/z"
+
+echo PASS
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "time_index.h"
+#include "time_sort.h"
+
+namespace worklog {
+
+namespace {
+// "WLTI"
+constexpr uint32_t kTimeIndexMagic = 0x49544c57;
+
+// Returns the timestamp the month starts at (local time, like the dates of
+// the logs). mktime normalizes month 12 to January of the next year.
+uint64_t MonthStart(int tm_year, int tm_mon) {
+  std::tm start = {};
+  start.tm_year = tm_year;
+  start.tm_mon = tm_mon;
+  start.tm_mday = 1;
+  start.tm_isdst = -1;
+
+  std::time_t time = std::mktime(&start);
+  return time < 0 ? 0 : static_cast<uint64_t>(time);
+}
+
+// Sets the year, month & start of the month of the timestamp and returns
+// the timestamp the next month starts at.
+uint64_t MonthOf(uint64_t timestamp, TimePeriod* month) {
+  std::time_t time = timestamp;
+  std::tm t = {};
+  localtime_r(&time, &t);
+
+  month->year = t.tm_year + 1900;
+  month->month = t.tm_mon + 1;
+  month->start = std::min(MonthStart(t.tm_year, t.tm_mon), timestamp);
+
+  uint64_t next = MonthStart(t.tm_year, t.tm_mon + 1);
+  return next <= timestamp ? timestamp + 1 : next;
+}
+}  // namespace
+
+TimeIndex::TimeIndex(const Config& config)
+    : DerivedIndex(config.TimeIndexPath(), kTimeIndexMagic) {}
+
+void TimeIndex::OnPut(const Log* old_log, const Log& log) {
+  if (old_log != nullptr) {
+    OnErase(*old_log);
+  }
+
+  Entry entry = {log.created_at, log.id};
+  if (!entries_.empty() && entry < entries_.back()) {
+    sorted_ = false;
+  }
+  entries_.push_back(entry);
+  months_valid_ = false;
+}
+
+void TimeIndex::OnErase(const Log& old_log) {
+  Entry entry = {old_log.created_at, old_log.id};
+
+  auto pos = sorted_
+                 ? std::lower_bound(entries_.begin(), entries_.end(), entry)
+                 : std::find_if(entries_.begin(), entries_.end(),
+                                [&entry](const Entry& other) {
+                                  return other.id == entry.id &&
+                                         other.created_at == entry.created_at;
+                                });
+  if (pos != entries_.end() && pos->id == entry.id &&
+      pos->created_at == entry.created_at) {
+    entries_.erase(pos);
+    months_valid_ = false;
+  }
+}
+
+void TimeIndex::Prepare() const {
+  if (!sorted_) {
+    SortByTime(&entries_);
+    sorted_ = true;
+  }
+
+  if (months_valid_) {
+    return;
+  }
+
+  // One binary search per month which has logs:
+  months_.clear();
+  auto it = entries_.begin();
+  while (it != entries_.end()) {
+    TimePeriod month = {0, 0, 0, 0, 0};
+    uint64_t next = MonthOf(it->created_at, &month);
+
+    auto end = std::lower_bound(it, entries_.end(), Entry{next, 0});
+    month.begin = it - entries_.begin();
+    month.end = end - entries_.begin();
+    months_.push_back(month);
+
+    it = end;
+  }
+
+  months_valid_ = true;
+}
+
+int TimeIndex::IdAt(std::size_t pos) const {
+  Prepare();
+  return entries_[pos].id;
+}
+
+std::size_t TimeIndex::Position(uint64_t created_at, int id) const {
+  Prepare();
+  return std::lower_bound(entries_.begin(), entries_.end(),
+                          Entry{created_at, id}) -
+         entries_.begin();
+}
+
+std::pair<std::size_t, std::size_t> TimeIndex::Range(uint64_t from,
+                                                     uint64_t to) const {
+  Prepare();
+
+  auto begin = std::lower_bound(entries_.begin(), entries_.end(),
+                                Entry{from, 0});
+  auto end = to <= from ? begin
+                        : std::lower_bound(begin, entries_.end(), Entry{to, 0});
+  return std::make_pair(begin - entries_.begin(), end - entries_.begin());
+}
+
+const std::vector<TimePeriod>& TimeIndex::Months() const {
+  Prepare();
+  return months_;
+}
+
+std::vector<TimePeriod> TimeIndex::Years() const {
+  std::vector<TimePeriod> years;
+  for (const auto& month : Months()) {
+    if (years.empty() || years.back().year != month.year) {
+      years.push_back({month.year, 0, month.start, month.begin, month.end});
+    } else {
+      years.back().end = month.end;
+    }
+  }
+  return years;
+}
+
+void TimeIndex::Clear() {
+  entries_.clear();
+  months_.clear();
+  sorted_ = true;
+  months_valid_ = true;
+}
+
+void TimeIndex::Encode(std::string* out) const {
+  Prepare();
+
+  // Sorted, so the timestamps are stored as small deltas:
+  atl::PutVarint64(out, entries_.size());
+  uint64_t prev_created_at = 0;
+  for (const auto& entry : entries_) {
+    atl::PutVarint64(out, entry.created_at - prev_created_at);
+    atl::PutVarint32(out, entry.id);
+    prev_created_at = entry.created_at;
+  }
+
+  atl::PutVarint64(out, months_.size());
+  for (const auto& month : months_) {
+    atl::PutVarint32(out, month.year);
+    atl::PutVarint32(out, month.month);
+    atl::PutVarint64(out, month.start);
+    atl::PutVarint64(out, month.begin);
+    atl::PutVarint64(out, month.end);
+  }
+}
+
+bool TimeIndex::Decode(atl::Decoder* in) {
+  uint64_t num_entries = 0;
+  if (!in->GetVarint64(&num_entries) || num_entries > in->remaining()) {
+    return false;
+  }
+
+  entries_.reserve(num_entries);
+  uint64_t created_at = 0;
+  for (uint64_t i = 0; i < num_entries; i++) {
+    uint64_t delta = 0;
+    uint32_t id = 0;
+    if (!in->GetVarint64(&delta) || !in->GetVarint32(&id)) {
+      return false;
+    }
+    created_at += delta;
+    entries_.push_back({created_at, static_cast<int>(id)});
+  }
+
+  uint64_t num_months = 0;
+  if (!in->GetVarint64(&num_months) || num_months > in->remaining()) {
+    return false;
+  }
+
+  months_.reserve(num_months);
+  for (uint64_t i = 0; i < num_months; i++) {
+    uint32_t year = 0;
+    uint32_t month = 0;
+    uint64_t start = 0;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    if (!in->GetVarint32(&year) || !in->GetVarint32(&month) ||
+        !in->GetVarint64(&start) || !in->GetVarint64(&begin) || !in->GetVarint64(&end) || begin > end ||
+        end > entries_.size()) {
+      return false;
+    }
+    months_.push_back({static_cast<int>(year), static_cast<int>(month), start,
+                       static_cast<std::size_t>(begin),
+                       static_cast<std::size_t>(end)});
+  }
+
+  sorted_ = true;
+  months_valid_ = true;
+  return true;
+}
+
+}  // namespace worklog
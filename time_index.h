@@ -0,0 +1,80 @@
+#ifndef TIME_INDEX_H_
+#define TIME_INDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "derived_index.h"
+#include "index.h"
+#include "worklog.h"
+
+namespace worklog {
+
+// A year or a month (month is 0 for a year) and the positions of its logs
+// in the TimeIndex, [begin, end). start is the timestamp the (first) month
+// with logs starts at.
+struct TimePeriod {
+  int year;
+  int month;
+  uint64_t start;
+  std::size_t begin;
+  std::size_t end;
+};
+
+// TimeIndex is the (created_at, id) column of all logs sorted by created_at
+// (and id), together with the boundaries of every month. Date ranges are
+// binary searches and their logs a contiguous range of the column.
+// Deleted logs are included, callers skip them (see Index::IsDeleted).
+class TimeIndex : public DerivedIndex {
+ public:
+  explicit TimeIndex(const Config& config);
+
+  void OnPut(const Log* old_log, const Log& log) override;
+  void OnErase(const Log& old_log) override;
+
+  LogFields fields() const override { return 0; }
+
+  std::size_t size() const { return entries_.size(); }
+  int IdAt(std::size_t pos) const;
+
+  // Returns the position of the first log at or after (created_at, id).
+  std::size_t Position(uint64_t created_at, int id) const;
+
+  // Returns the positions of the logs created in [from, to).
+  std::pair<std::size_t, std::size_t> Range(uint64_t from, uint64_t to) const;
+
+  // The months & years which have logs, oldest first.
+  const std::vector<TimePeriod>& Months() const;
+  std::vector<TimePeriod> Years() const;
+
+ protected:
+  void Clear() override;
+  void Encode(std::string* out) const override;
+  bool Decode(atl::Decoder* in) override;
+
+ private:
+  struct Entry {
+    uint64_t created_at;
+    int id;
+
+    bool operator<(const Entry& other) const {
+      return created_at < other.created_at ||
+             (created_at == other.created_at && id < other.id);
+    }
+  };
+
+  // Logs are appended and the column is sorted (and the months are
+  // recomputed) on the next read, so rebuilding isn't quadratic.
+  void Prepare() const;
+
+  mutable std::vector<Entry> entries_;
+  mutable std::vector<TimePeriod> months_;
+  mutable bool sorted_ = true;
+  mutable bool months_valid_ = true;
+};
+
+}  // namespace worklog
+
+#endif  // TIME_INDEX_H_
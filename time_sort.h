@@ -0,0 +1,131 @@
+#ifndef TIME_SORT_H_
+#define TIME_SORT_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace worklog {
+
+namespace internal {
+// The radix sort has one pass per byte of the key, the least significant
+// first: 4 for the id, 8 for created_at.
+constexpr int kTimeSortPasses = 12;
+
+// Smaller inputs are sorted with std::sort, larger ones are split into one
+// chunk per thread for counting and scattering.
+constexpr std::size_t kMinRadixSortSize = 1024;
+constexpr std::size_t kMinParallelSortSize = 1 << 18;
+
+template <typename T>
+uint8_t TimeSortDigit(const T& item, int pass) {
+  return pass < 4 ? static_cast<uint32_t>(item.id) >> (8 * pass) & 0xff
+                  : item.created_at >> (8 * (pass - 4)) & 0xff;
+}
+
+// Runs fn(chunk) for every chunk, all but the first on their own thread.
+template <typename Fn>
+void ForEachChunk(unsigned int num_chunks, Fn fn) {
+  std::vector<std::thread> threads;
+  for (unsigned int i = 1; i < num_chunks; i++) {
+    threads.emplace_back(fn, i);
+  }
+  fn(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+}  // namespace internal
+
+// Sorts the items ascending by (created_at, id), the order of the
+// TimeIndex, with an LSD radix sort. T needs a uint64_t created_at and a
+// non-negative int id. Instead of comparing and swapping the items, every
+// pass scatters them by one byte of the key into a second buffer, and the
+// bytes all items share (ie. the high bytes of the timestamps) are skipped.
+// The id makes the order deterministic for logs of the same day.
+//
+// Large inputs are counted & scattered by num_threads threads (0 uses all
+// cores), each of them owning a chunk of the input and its own range of
+// every bucket.
+template <typename T>
+void SortByTime(std::vector<T>* items, unsigned int num_threads = 0) {
+  using Histogram = std::array<std::size_t, 256>;
+  const std::size_t size = items->size();
+
+  if (size < internal::kMinRadixSortSize) {
+    std::sort(items->begin(), items->end(), [](const T& a, const T& b) {
+      return a.created_at < b.created_at ||
+             (a.created_at == b.created_at && a.id < b.id);
+    });
+    return;
+  }
+
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  unsigned int num_chunks =
+      size < internal::kMinParallelSortSize ? 1 : num_threads;
+  std::size_t chunk_size = (size + num_chunks - 1) / num_chunks;
+
+  std::vector<T> buffer(size);
+  std::vector<T>* from = items;
+  std::vector<T>* to = &buffer;
+
+  std::vector<Histogram> counts(num_chunks);
+  for (int pass = 0; pass < internal::kTimeSortPasses; pass++) {
+    internal::ForEachChunk(num_chunks, [&](unsigned int chunk) {
+      Histogram& count = counts[chunk];
+      count.fill(0);
+
+      std::size_t end = std::min(size, (chunk + 1) * chunk_size);
+      for (std::size_t i = chunk * chunk_size; i < end; i++) {
+        count[internal::TimeSortDigit((*from)[i], pass)]++;
+      }
+    });
+
+    // The offsets of the buckets, every chunk starts after the part of the
+    // previous chunks in each bucket, so the sort stays stable:
+    std::size_t offset = 0;
+    bool skip = false;
+    for (int digit = 0; digit < 256; digit++) {
+      std::size_t total = 0;
+      for (Histogram& count : counts) {
+        std::size_t chunk_count = count[digit];
+        count[digit] = offset + total;
+        total += chunk_count;
+      }
+
+      if (total == size) {
+        skip = true;
+        break;
+      }
+      offset += total;
+    }
+
+    if (skip) {
+      continue;
+    }
+
+    internal::ForEachChunk(num_chunks, [&](unsigned int chunk) {
+      Histogram& next = counts[chunk];
+
+      std::size_t end = std::min(size, (chunk + 1) * chunk_size);
+      for (std::size_t i = chunk * chunk_size; i < end; i++) {
+        const T& item = (*from)[i];
+        (*to)[next[internal::TimeSortDigit(item, pass)]++] = item;
+      }
+    });
+
+    std::swap(from, to);
+  }
+
+  if (from != items) {
+    items->swap(buffer);
+  }
+}
+
+}  // namespace worklog
+
+#endif  // TIME_SORT_H_
@@ -0,0 +1,21 @@
+#include <string>
+#include <vector>
+
+#include "atl/string.h"
+
+#include "tokenizer.h"
+
+namespace worklog {
+
+std::vector<std::string> Tokenize(const std::string& text) {
+  // Lower cased as a whole, then the words are copied out once:
+  const std::string lower = atl::ToLower(text);
+
+  std::vector<std::string> words;
+  ForEachWord(lower, [&words](atl::StringView word) {
+    words.push_back(word.to_string());
+  });
+  return words;
+}
+
+}  // namespace worklog
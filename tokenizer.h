@@ -0,0 +1,47 @@
+#ifndef TOKENIZER_H_
+#define TOKENIZER_H_
+
+#include <string>
+#include <vector>
+
+#include "atl/string_view.h"
+
+namespace worklog {
+
+// Words are runs of ASCII letters & digits, the bytes of UTF-8 sequences
+// are kept as part of the word. Anything else separates words.
+inline bool IsWordChar(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+// Calls fn with every word of the text as it is, the views point into the
+// text. Lower case the text first (see atl::ToLowerInPlace) for terms.
+template <typename Fn>
+void ForEachWord(atl::StringView text, Fn fn) {
+  const char* data = text.data();
+  const std::size_t size = text.size();
+
+  std::size_t pos = 0;
+  while (pos < size) {
+    while (pos < size && !IsWordChar(static_cast<unsigned char>(data[pos]))) {
+      pos++;
+    }
+
+    std::size_t begin = pos;
+    while (pos < size && IsWordChar(static_cast<unsigned char>(data[pos]))) {
+      pos++;
+    }
+
+    if (pos > begin) {
+      fn(text.substr(begin, pos - begin));
+    }
+  }
+}
+
+// Splits the text into lower cased words.
+std::vector<std::string> Tokenize(const std::string& text);
+
+}  // namespace worklog
+
+#endif  // TOKENIZER_H_
@@ -0,0 +1,184 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "atl/dir.h"
+#include "atl/file.h"
+#include "atl/lock.h"
+#include "atl/string.h"
+#include "atl/time.h"
+
+#include "index_set.h"
+#include "tombstone.h"
+
+namespace worklog {
+
+atl::Status Tombstones::Load() {
+  deleted_.clear();
+
+  if (!atl::FileExists(config_.TombstonesPath())) {
+    return atl::Status();
+  }
+
+  atl::Optional<std::string> content =
+      atl::FileReadContent(config_.TombstonesPath());
+  if (!content) {
+    return atl::Status(atl::error::INTERNAL,
+                       "Failed to read tombstones: " + config_.TombstonesPath());
+  }
+
+  // The file is appended without holding a lock for readers, so the last
+  // line might be incomplete; only lines with a newline are taken:
+  const std::string& text = content.value();
+  std::size_t pos = 0;
+  for (;;) {
+    std::size_t end = text.find('\n', pos);
+    if (end == std::string::npos) {
+      break;
+    }
+
+    std::istringstream line(text.substr(pos, end - pos));
+    pos = end + 1;
+
+    int id = 0;
+    uint64_t deleted_at = 0;
+    if (line >> id >> deleted_at && id > 0) {
+      deleted_[id] = deleted_at;
+    }
+  }
+
+  return atl::Status();
+}
+
+atl::Status Tombstones::Add(int id) {
+  atl::FileLock lock(config_.LockPath(), kTombstonesLockOffset,
+                     atl::FileLock::Mode::kExclusive);
+  if (!lock) {
+    return atl::Status(atl::error::UNAVAILABLE, "Failed to lock tombstones");
+  }
+
+  uint64_t now = atl::UnixTimestamp(atl::CurrentTime());
+
+  std::ofstream file(config_.TombstonesPath(), std::ios::app);
+  file << id << " " << now << "\n";
+  file.flush();
+  if (!file) {
+    return atl::Status(atl::error::INTERNAL,
+                       "Failed to write tombstones: " + config_.TombstonesPath());
+  }
+
+  deleted_[id] = now;
+  return atl::Status();
+}
+
+atl::Status Tombstones::Remove(int id) {
+  atl::FileLock lock(config_.LockPath(), kTombstonesLockOffset,
+                     atl::FileLock::Mode::kExclusive);
+  if (!lock) {
+    return atl::Status(atl::error::UNAVAILABLE, "Failed to lock tombstones");
+  }
+
+  atl::Status status = Load();
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (deleted_.erase(id) == 0) {
+    return atl::Status(atl::error::NOT_FOUND,
+                       "The work log " + std::to_string(id) + " is not deleted");
+  }
+
+  return Rewrite();
+}
+
+atl::Status Tombstones::Rewrite() {
+  std::ostringstream text;
+  for (const auto& entry : deleted_) {
+    text << entry.first << " " << entry.second << "\n";
+  }
+
+  if (!atl::FileWriteContentAtomic(config_.TombstonesPath(), text.str())) {
+    return atl::Status(atl::error::INTERNAL,
+                       "Failed to write tombstones: " + config_.TombstonesPath());
+  }
+
+  return atl::Status();
+}
+
+bool Tombstones::NeedsCompaction() const {
+  if (deleted_.empty()) {
+    return false;
+  }
+
+  std::size_t num_logs = 0;
+  atl::ListDir(config_.logs_dir, [&num_logs](const atl::DirEntry& file) {
+    if (file.type == atl::EntryType::kFile) {
+      num_logs++;
+    }
+    return true;
+  });
+
+  return num_logs == 0 ||
+         deleted_.size() > config_.max_garbage_ratio * num_logs;
+}
+
+atl::StatusOr<int> Tombstones::Compact(bool force) {
+  // Holding the tombstones lock for the whole compaction keeps 'rm' and
+  // 'undelete' out. No log lock is taken because 'rm' & 'undelete' take
+  // them before the tombstones lock (which would be a deadlock):
+  atl::FileLock lock(config_.LockPath(), kTombstonesLockOffset,
+                     atl::FileLock::Mode::kExclusive);
+  if (!lock) {
+    return atl::Status(atl::error::UNAVAILABLE, "Failed to lock tombstones");
+  }
+
+  atl::Status status = Load();
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (!force && !NeedsCompaction()) {
+    return 0;
+  }
+
+  // Only the tombstones of the logs which are gone are dropped, a log whose
+  // file couldn't be removed stays deleted instead of coming back:
+  int removed = 0;
+  std::string failed_path;
+  int failed_errno = 0;
+  for (auto it = deleted_.begin(); it != deleted_.end();) {
+    std::string log_path =
+        atl::JoinStr("/", config_.logs_dir, std::to_string(it->first));
+    if (std::remove(log_path.c_str()) == 0) {
+      removed++;
+    } else if (errno != ENOENT) {
+      failed_path = log_path;
+      failed_errno = errno;
+      ++it;
+      continue;
+    }
+    it = deleted_.erase(it);
+  }
+
+  atl::Status rewrite_status = Rewrite();
+  if (!rewrite_status.ok()) {
+    return rewrite_status;
+  }
+
+  // The dead entries are dropped from the indexes by the sweep:
+  IndexSet indexes(config_);
+  indexes.Open();
+
+  if (!deleted_.empty()) {
+    return atl::Status(atl::error::INTERNAL,
+                       "Failed to remove " + std::to_string(deleted_.size()) +
+                           " deleted log(s) (" + failed_path + ": " +
+                           std::strerror(failed_errno) + ")");
+  }
+  return removed;
+}
+
+}  // namespace worklog
@@ -0,0 +1,52 @@
+#ifndef TOMBSTONE_H_
+#define TOMBSTONE_H_
+
+#include <cstdint>
+#include <map>
+
+#include "atl/status.h"
+#include "atl/statusor.h"
+
+#include "worklog.h"
+
+namespace worklog {
+
+// Tombstones records the deleted logs in .worklog/tombstones. Deleting a
+// log only appends a line ('<id> <deleted_at>'), the log file itself stays
+// until the next compaction, so a delete can be undone.
+class Tombstones {
+ public:
+  explicit Tombstones(const Config& config) : config_(config) {}
+
+  // A missing tombstones file means nothing has been deleted.
+  atl::Status Load();
+
+  bool Contains(int id) const { return deleted_.count(id) > 0; }
+  std::size_t size() const { return deleted_.size(); }
+  const std::map<int, uint64_t>& deleted() const { return deleted_; }
+
+  atl::Status Add(int id);
+  atl::Status Remove(int id);
+
+  // Removes the files of the deleted logs and rewrites the tombstones &
+  // the index without them. Unless force is set, nothing happens as long
+  // as the deleted logs are below Config::max_garbage_ratio. Returns the
+  // number of removed logs. The logs whose files can't be removed keep
+  // their tombstones and make it fail.
+  atl::StatusOr<int> Compact(bool force);
+
+  // Returns true if the share of deleted logs is above max_garbage_ratio.
+  bool NeedsCompaction() const;
+
+ private:
+  atl::Status Rewrite();
+
+  Config config_;
+
+  // id -> deleted_at
+  std::map<int, uint64_t> deleted_;
+};
+
+}  // namespace worklog
+
+#endif  // TOMBSTONE_H_
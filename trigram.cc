@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "atl/string.h"
+
+#include "trigram.h"
+
+namespace worklog {
+
+namespace {
+// "WLTG"
+constexpr uint32_t kTrigramMagic = 0x47544c57;
+
+// Returns the distinct trigrams of the (already folded) text, sorted.
+std::vector<uint32_t> Trigrams(const std::string& text) {
+  std::vector<uint32_t> trigrams;
+  if (text.size() < 3) {
+    return trigrams;
+  }
+
+  trigrams.reserve(text.size() - 2);
+  for (std::size_t i = 0; i + 2 < text.size(); i++) {
+    trigrams.push_back(static_cast<unsigned char>(text[i]) << 16 |
+                       static_cast<unsigned char>(text[i + 1]) << 8 |
+                       static_cast<unsigned char>(text[i + 2]));
+  }
+
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                 trigrams.end());
+  return trigrams;
+}
+
+void InsertSorted(std::vector<int>* ids, int id) {
+  auto pos = std::lower_bound(ids->begin(), ids->end(), id);
+  if (pos == ids->end() || *pos != id) {
+    ids->insert(pos, id);
+  }
+}
+}  // namespace
+
+std::string FoldCase(const std::string& text) { return atl::ToLower(text); }
+
+std::string SearchableText(const Log& log) {
+  return FoldCase(log.subject + "\n" + log.description);
+}
+
+TrigramIndex::TrigramIndex(const Config& config)
+    : DerivedIndex(config.TrigramsPath(), kTrigramMagic) {}
+
+void TrigramIndex::OnPut(const Log* old_log, const Log& log) {
+  std::vector<uint32_t> trigrams = Trigrams(SearchableText(log));
+  std::vector<uint32_t> old_trigrams;
+  if (old_log != nullptr) {
+    old_trigrams = Trigrams(SearchableText(*old_log));
+  }
+
+  // Only the trigrams which went away or came along touch their posting
+  // lists, a log whose text stays the same (ie. a tag was changed) doesn't
+  // move its id in the long lists of the common trigrams:
+  std::vector<uint32_t> changed;
+  std::set_difference(old_trigrams.begin(), old_trigrams.end(),
+                      trigrams.begin(), trigrams.end(),
+                      std::back_inserter(changed));
+  for (uint32_t trigram : changed) {
+    Erase(trigram, log.id);
+  }
+
+  changed.clear();
+  std::set_difference(trigrams.begin(), trigrams.end(), old_trigrams.begin(),
+                      old_trigrams.end(), std::back_inserter(changed));
+  for (uint32_t trigram : changed) {
+    InsertSorted(&postings_[trigram], log.id);
+  }
+}
+
+void TrigramIndex::OnErase(const Log& old_log) {
+  for (uint32_t trigram : Trigrams(SearchableText(old_log))) {
+    Erase(trigram, old_log.id);
+  }
+}
+
+void TrigramIndex::Erase(uint32_t trigram, int id) {
+  auto found = postings_.find(trigram);
+  if (found == postings_.end()) {
+    return;
+  }
+
+  std::vector<int>& ids = found->second;
+  auto pos = std::lower_bound(ids.begin(), ids.end(), id);
+  if (pos != ids.end() && *pos == id) {
+    ids.erase(pos);
+  }
+
+  if (ids.empty()) {
+    postings_.erase(found);
+  }
+}
+
+std::vector<int> TrigramIndex::Search(const Index& index,
+                                      const std::string& text) const {
+  const std::string needle = FoldCase(text);
+
+  std::vector<int> candidates;
+  std::vector<uint32_t> trigrams = Trigrams(needle);
+
+  if (trigrams.empty()) {
+    // Too short for trigrams, every log is a candidate:
+    for (const auto& entry : index.entries()) {
+      candidates.push_back(entry.first);
+    }
+  } else {
+    std::vector<const std::vector<int>*> lists;
+    for (uint32_t trigram : trigrams) {
+      auto found = postings_.find(trigram);
+      if (found == postings_.end()) {
+        return {};
+      }
+      lists.push_back(&found->second);
+    }
+
+    // Intersecting the shortest lists first keeps the candidates small:
+    std::sort(lists.begin(), lists.end(),
+              [](const std::vector<int>* a, const std::vector<int>* b) {
+                return a->size() < b->size();
+              });
+
+    candidates = *lists[0];
+    for (std::size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+      std::vector<int> intersection;
+      std::set_intersection(candidates.begin(), candidates.end(),
+                            lists[i]->begin(), lists[i]->end(),
+                            std::back_inserter(intersection));
+      candidates.swap(intersection);
+    }
+  }
+
+  // The trigrams only tell that a log might contain the text (the
+  // trigrams could be at different positions), so the candidates are
+  // checked against the real text:
+  std::vector<int> ids;
+  for (int id : candidates) {
+    auto found = index.entries().find(id);
+    if (found == index.entries().end() || index.IsDeleted(id)) {
+      continue;
+    }
+
+    if (SearchableText(found->second.log).find(needle) != std::string::npos) {
+      ids.push_back(id);
+    }
+  }
+
+  return ids;
+}
+
+std::size_t TrigramIndex::EstimateMatches(const std::string& text,
+                                          std::size_t num_logs) const {
+  std::vector<uint32_t> trigrams = Trigrams(FoldCase(text));
+  if (trigrams.empty()) {
+    return num_logs;
+  }
+
+  std::size_t estimate = num_logs;
+  for (uint32_t trigram : trigrams) {
+    auto found = postings_.find(trigram);
+    if (found == postings_.end()) {
+      return 0;
+    }
+    estimate = std::min(estimate, found->second.size());
+  }
+
+  return estimate;
+}
+
+void TrigramIndex::Clear() { postings_.clear(); }
+
+void TrigramIndex::Encode(std::string* out) const {
+  // Sorted, so the same index always results in the same file:
+  std::vector<uint32_t> trigrams;
+  trigrams.reserve(postings_.size());
+  for (const auto& posting : postings_) {
+    trigrams.push_back(posting.first);
+  }
+  std::sort(trigrams.begin(), trigrams.end());
+
+  atl::PutVarint64(out, trigrams.size());
+  for (uint32_t trigram : trigrams) {
+    const std::vector<int>& ids = postings_.at(trigram);
+
+    atl::PutFixed32(out, trigram);
+    atl::PutVarint64(out, ids.size());
+
+    // The ids are sorted, so the deltas are small varints:
+    int prev_id = 0;
+    for (int id : ids) {
+      atl::PutVarint32(out, id - prev_id);
+      prev_id = id;
+    }
+  }
+}
+
+bool TrigramIndex::Decode(atl::Decoder* in) {
+  uint64_t num_trigrams = 0;
+  if (!in->GetVarint64(&num_trigrams)) {
+    return false;
+  }
+
+  postings_.reserve(num_trigrams);
+  for (uint64_t i = 0; i < num_trigrams; i++) {
+    uint32_t trigram = 0;
+    uint64_t num_ids = 0;
+    if (!in->GetFixed32(&trigram) || !in->GetVarint64(&num_ids) ||
+        num_ids > in->remaining()) {
+      return false;
+    }
+
+    std::vector<int>& ids = postings_[trigram];
+    ids.reserve(num_ids);
+
+    int prev_id = 0;
+    for (uint64_t j = 0; j < num_ids; j++) {
+      uint32_t delta = 0;
+      if (!in->GetVarint32(&delta)) {
+        return false;
+      }
+      prev_id += delta;
+      ids.push_back(prev_id);
+    }
+  }
+
+  return true;
+}
+
+}  // namespace worklog
@@ -0,0 +1,60 @@
+#ifndef TRIGRAM_H_
+#define TRIGRAM_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "derived_index.h"
+#include "index.h"
+#include "worklog.h"
+
+namespace worklog {
+
+// ASCII case folding, the text search is case insensitive.
+std::string FoldCase(const std::string& text);
+
+// The case folded text the text search runs on (subject & description).
+std::string SearchableText(const Log& log);
+
+// TrigramIndex maps every (case folded) trigram of the subject and the
+// description to the sorted ids of the logs containing it. A substring
+// search only has to check the logs which contain all trigrams of the
+// search text instead of every log.
+class TrigramIndex : public DerivedIndex {
+ public:
+  explicit TrigramIndex(const Config& config);
+
+  void OnPut(const Log* old_log, const Log& log) override;
+  void OnErase(const Log& old_log) override;
+
+  LogFields fields() const override {
+    return kFieldSubject | kFieldDescription;
+  }
+
+  // Returns the ids of the logs whose subject or description contain text
+  // (ASCII case insensitive), sorted by id. Deleted logs are skipped.
+  std::vector<int> Search(const Index& index, const std::string& text) const;
+
+  // Returns an upper bound of the logs containing text without checking
+  // any log: the length of the shortest posting list of its trigrams.
+  // Returns num_logs if the text is too short for trigrams.
+  std::size_t EstimateMatches(const std::string& text,
+                              std::size_t num_logs) const;
+
+ protected:
+  void Clear() override;
+  void Encode(std::string* out) const override;
+  bool Decode(atl::Decoder* in) override;
+
+ private:
+  // Removes the id from the posting list of the trigram.
+  void Erase(uint32_t trigram, int id);
+
+  std::unordered_map<uint32_t, std::vector<int>> postings_;
+};
+
+}  // namespace worklog
+
+#endif  // TRIGRAM_H_
@@ -2,6 +2,7 @@
 #include <vector>
 #include <iomanip>
 #include <algorithm>
+#include <cstdlib>
 
 #include "atl/status.h"
 #include "atl/optional.h"
@@ -41,44 +42,14 @@ int PostEditValidation(const std::string& content) {
 }
 
 atl::Optional<int> ExtractWorklogIdFromPath(const std::string& path) {
-  auto pos = path.rfind("/");
-  if (pos == std::string::npos) {
+  atl::StringView view(path);
+
+  auto pos = view.rfind('/');
+  if (pos == atl::StringView::npos) {
     return {};
   }
 
-  return std::stoi(path.substr(pos + 1));
-}
-
-std::vector<worklog::Log> IndexFromDir(const std::string& path) {
-  std::vector<worklog::Log> index;
-  worklog::HumanSerializer hs;
-
-  atl::WalkDir(path, [&index, &hs](const std::string& file) -> bool {
-    atl::Optional<int> worklog_id = ExtractWorklogIdFromPath(file);
-    if (!worklog_id) {
-      std::cerr << "Failed to extract work log from path: " << file << "\n";
-      return true;
-    }
-
-    auto content = atl::FileReadContent(file);
-    if (!content) {
-      std::cerr << "Error: Failed to read log: " << file << "\n";
-      return true;
-    }
-
-    auto log = hs.Unserialize(content.value());
-    log.id = worklog_id.value();
-
-    index.push_back(log);
-    return true;
-  });
-
-  // Sort by created_at DESC - newer entries are displayed first:
-  std::sort(index.begin(), index.end(), [](const worklog::Log& a, const worklog::Log& b) {
-    return a.created_at > b.created_at;
-  });
-
-  return index;
+  return atl::ParseInt(view.substr(pos + 1));
 }
 
 atl::Optional<int> NumberFromString(const std::string& number) {
@@ -112,3 +83,17 @@ worklog::Command::Action MustBeInWorkspace(worklog::Command::Action action) {
     return action(ctx);
   };
 }
+
+worklog::Command::Action MustHaveEditor(worklog::Command::Action action) {
+  return [action](const worklog::CommandContext& ctx) -> int {
+    if (getenv("EDITOR") == nullptr) {
+      std::cerr << "Error: Please set the environment variable "
+                << "$EDITOR to your favourite editor (ie. vim). "
+                << "(the value is currently empty!)\n";
+
+      return -1;
+    }
+
+    return action(ctx);
+  };
+}
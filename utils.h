@@ -8,8 +8,11 @@
 std::string Template();
 int PostEditValidation(const std::string& content);
 atl::Optional<int> ExtractWorklogIdFromPath(const std::string& path);
-std::vector<worklog::Log> IndexFromDir(const std::string& path);
 atl::Optional<int> NumberFromString(const std::string& number);
 void PrintWorklog(const worklog::Log& log);
 worklog::Command::Action MustBeInWorkspace(worklog::Command::Action action);
+
+// Only the commands which launch the editor need $EDITOR, the others (ie.
+// complete, which shells call) work without it.
+worklog::Command::Action MustHaveEditor(worklog::Command::Action action);
 #endif  // UTILS_H_
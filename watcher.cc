@@ -0,0 +1,144 @@
+#include <chrono>
+#include <string>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include "atl/string.h"
+#include "atl/string_view.h"
+
+#include "watcher.h"
+
+namespace worklog {
+
+#ifdef __linux__
+
+namespace {
+constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                                IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB;
+
+// Reads all pending events from fd into changes. Returns false on error.
+bool DrainEvents(int fd, Changes* changes) {
+  alignas(struct inotify_event) char buffer[64 * 1024];
+
+  for (;;) {
+    ssize_t nread = read(fd, buffer, sizeof(buffer));
+    if (nread < 0) {
+      return errno == EAGAIN || errno == EINTR;
+    }
+
+    if (nread == 0) {
+      return true;
+    }
+
+    for (char* ptr = buffer; ptr < buffer + nread;) {
+      auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        changes->overflow = true;
+        continue;
+      }
+
+      if (event->len == 0 || (event->mask & IN_ISDIR)) {
+        continue;
+      }
+
+      // Editor swap & backup files (ie. '.42.swp', '42~') are ignored
+      // because they are no valid ids:
+      atl::Optional<int> id = atl::ParseInt(atl::StringView(event->name));
+      if (id) {
+        changes->ids.insert(id.value());
+      }
+    }
+  }
+}
+
+// Waits until fd is readable. A negative timeout blocks forever. Returns
+// 1 if readable, 0 on timeout and -1 on error.
+int WaitReadable(int fd, int timeout_ms) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+
+  for (;;) {
+    int res = poll(&pfd, 1, timeout_ms);
+    if (res < 0 && errno == EINTR) {
+      continue;
+    }
+    return res;
+  }
+}
+}  // namespace
+
+Watcher::~Watcher() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+atl::Status Watcher::Start() {
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd_ < 0) {
+    return atl::Status(atl::error::INTERNAL, "Failed to initialize inotify");
+  }
+
+  if (inotify_add_watch(fd_, config_.logs_dir.c_str(), kWatchMask) < 0) {
+    return atl::Status(atl::error::INTERNAL,
+                       "Failed to watch directory: " + config_.logs_dir);
+  }
+
+  return atl::Status();
+}
+
+atl::StatusOr<Changes> Watcher::Wait(std::chrono::milliseconds quiet_period) {
+  if (fd_ < 0) {
+    return atl::Status(atl::error::FAILED_PRECONDITION,
+                       "Watcher has not been started");
+  }
+
+  Changes changes;
+
+  int timeout_ms = -1;
+  for (;;) {
+    int res = WaitReadable(fd_, timeout_ms);
+    if (res < 0) {
+      return atl::Status(atl::error::INTERNAL, "Failed to poll inotify");
+    }
+
+    if (res == 0) {
+      // Nothing happened within the quiet period, the burst is over:
+      return changes;
+    }
+
+    if (!DrainEvents(fd_, &changes)) {
+      return atl::Status(atl::error::INTERNAL, "Failed to read inotify events");
+    }
+
+    if (!changes.ids.empty() || changes.overflow) {
+      timeout_ms = static_cast<int>(quiet_period.count());
+    }
+  }
+}
+
+#else
+
+Watcher::~Watcher() {}
+
+atl::Status Watcher::Start() {
+  return atl::Status(atl::error::UNIMPLEMENTED,
+                     "Watching is only supported under linux");
+}
+
+atl::StatusOr<Changes> Watcher::Wait(std::chrono::milliseconds quiet_period) {
+  return atl::Status(atl::error::UNIMPLEMENTED,
+                     "Watching is only supported under linux");
+}
+
+#endif  // __linux__
+
+}  // namespace worklog
@@ -0,0 +1,50 @@
+#ifndef WATCHER_H_
+#define WATCHER_H_
+
+#include <chrono>
+#include <set>
+
+#include "atl/status.h"
+#include "atl/statusor.h"
+
+#include "worklog.h"
+
+namespace worklog {
+
+// Changes is a coalesced batch of file system events on the logs dir.
+struct Changes {
+  // ids of the logs which have been created, modified or deleted
+  std::set<int> ids;
+
+  // The kernel event queue overflowed, so events have been lost and
+  // the caller must fall back to a full mtime sweep (Index::Sweep).
+  bool overflow = false;
+};
+
+// Watcher reports changes of the logs dir which have been done outside of
+// the worklog tool (ie. 'vim .worklog/logs/42' or a 'git pull'). It is
+// based on inotify and therefore only available under linux.
+class Watcher {
+ public:
+  explicit Watcher(const Config& config) : config_(config) {}
+  ~Watcher();
+
+  Watcher(const Watcher&) = delete;
+  Watcher& operator=(const Watcher&) = delete;
+
+  atl::Status Start();
+
+  // Blocks until at least one event arrives and then keeps collecting
+  // events until no new one arrived for quiet_period, so a burst of
+  // events (ie. an editor writing a swap file & renaming it) results in
+  // a single batch.
+  atl::StatusOr<Changes> Wait(std::chrono::milliseconds quiet_period);
+
+ private:
+  Config config_;
+  int fd_ = -1;
+};
+
+}  // namespace worklog
+
+#endif  // WATCHER_H_
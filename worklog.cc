@@ -4,6 +4,7 @@
 #include <string>
 
 #include "atl/file.h"
+#include "atl/lock.h"
 #include "atl/optional.h"
 #include "atl/string.h"
 #include "atl/time.h"
@@ -17,8 +18,48 @@ std::string Config::NextIdPath() const {
   return atl::JoinStr("/", meta_dir, next_id);
 }
 
+std::string Config::IndexPath() const {
+  return atl::JoinStr("/", meta_dir, index);
+}
+
+std::string Config::LockPath() const {
+  return atl::JoinStr("/", meta_dir, lock);
+}
+
+std::string Config::TombstonesPath() const {
+  return atl::JoinStr("/", meta_dir, tombstones);
+}
+
+std::string Config::TrigramsPath() const {
+  return atl::JoinStr("/", meta_dir, trigrams);
+}
+
+std::string Config::InvertedIndexPath() const {
+  return atl::JoinStr("/", meta_dir, inverted_index);
+}
+
+std::string Config::TimeIndexPath() const {
+  return atl::JoinStr("/", meta_dir, time_index);
+}
+
+std::string Config::ColumnIndexPath() const {
+  return atl::JoinStr("/", meta_dir, column_index);
+}
+
+std::string Config::AggregatesPath() const {
+  return atl::JoinStr("/", meta_dir, aggregates);
+}
+
+std::string Config::CompletionsPath() const {
+  return atl::JoinStr("/", meta_dir, completions);
+}
+
+std::string Config::SignaturesPath() const {
+  return atl::JoinStr("/", meta_dir, signatures);
+}
+
 atl::Status Validate(const Log& log) {
-  if (log.subject == "" || log.description == "") {
+  if (log.subject == "" || (log.description == "" && !log.has_description)) {
     return atl::Status(atl::error::INTERNAL, "Subject or description is empty.");
   }
 
@@ -76,6 +117,13 @@ atl::Optional<int> NextId(const Config& conf) {
   // FIXME(an): Better rrror handling?
   std::string next_id_file = conf.NextIdPath();
 
+  // Without the lock two concurrent 'new' commands could get the same id:
+  atl::FileLock lock(conf.LockPath(), kNextIdLockOffset,
+                     atl::FileLock::Mode::kExclusive);
+  if (!lock) {
+    return {};
+  }
+
   if (!atl::FileExists(next_id_file)) {
     // When no next_id file has been found then we return '1' and save
     // '2' to next_id file, so it will work properly for the next time.
@@ -89,7 +137,7 @@ atl::Optional<int> NextId(const Config& conf) {
   }
 
   int id = std::atoi(content.value().c_str());
-  atl::FileWriteContent(next_id_file, std::to_string(id + 1));
+  atl::FileWriteContentAtomic(next_id_file, std::to_string(id + 1));
 
   return id;
 }
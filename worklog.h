@@ -1,6 +1,8 @@
 #ifndef WORKLOG_H_
 #define WORKLOG_H_
 
+#include <cstdint>
+#include <map>
 #include <set>
 #include <string>
 
@@ -15,16 +17,84 @@ struct Log {
   std::string description;
   uint64_t created_at;
   std::set<std::string> tags;
+
+  // The custom header fields (key=value lines besides date & tags), ie.
+  // duration=1h30m. Their values are typed by ParseMetadataValue.
+  std::map<std::string, std::string> metadata;
+
+  // Also set if the description hasn't been loaded (see LogFields).
+  bool has_description = false;
 };
 
+// The fields of a log. Commands only load the fields they need from the
+// index (see Index::Load), the id & created_at are always loaded.
+enum LogField : uint32_t {
+  kFieldTags = 1 << 0,
+  kFieldSubject = 1 << 1,
+  kFieldHasDescription = 1 << 2,
+  kFieldDescription = 1 << 3,
+  kFieldMetadata = 1 << 4,
+};
+using LogFields = uint32_t;
+
+constexpr LogFields kAllFields = kFieldTags | kFieldSubject |
+                                 kFieldHasDescription | kFieldDescription |
+                                 kFieldMetadata;
+
+// Everything but the description, enough for listing & validating logs.
+constexpr LogFields kHeaderFields = kAllFields & ~kFieldDescription;
+
 struct Config {
   std::string meta_dir = ".worklog";
   std::string logs_dir = ".worklog/logs";
 
   std::string next_id = "next_id";
   std::string NextIdPath() const;
+
+  std::string index = "index";
+  std::string IndexPath() const;
+
+  std::string lock = "lock";
+  std::string LockPath() const;
+
+  std::string tombstones = "tombstones";
+  std::string TombstonesPath() const;
+
+  std::string trigrams = "trigrams";
+  std::string TrigramsPath() const;
+
+  std::string inverted_index = "inverted_index";
+  std::string InvertedIndexPath() const;
+
+  std::string time_index = "time_index";
+  std::string TimeIndexPath() const;
+
+  std::string column_index = "columns";
+  std::string ColumnIndexPath() const;
+
+  std::string aggregates = "aggregates";
+  std::string AggregatesPath() const;
+
+  std::string completions = "completions";
+  std::string CompletionsPath() const;
+
+  std::string signatures = "signatures";
+  std::string SignaturesPath() const;
+
+  // Deleted logs are compacted once they make up more than this share of
+  // all log files.
+  double max_garbage_ratio = 0.25;
 };
 
+// Writers coordinate through byte range locks on Config::LockPath(), one
+// byte per resource (see atl::FileLock), so writers of different logs never
+// block each other. Readers don't lock at all: logs and the index are
+// replaced atomically, so a reader always sees a complete snapshot.
+constexpr int64_t kNextIdLockOffset = 0;
+constexpr int64_t kIndexLockOffset = 1;
+constexpr int64_t kTombstonesLockOffset = 2;
+inline int64_t LogLockOffset(int id) { return 16 + static_cast<int64_t>(id); }
+
 atl::Status Validate(const Log& log);
 bool LaunchEditor(const std::string& file);
 atl::Optional<std::string> ContentFromEditor(const std::string& file);
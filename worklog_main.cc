@@ -1,11 +1,17 @@
 #include <algorithm>
+#include <chrono>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <set>
 #include <sstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include <unistd.h>  // fork
+
 #include "atl/colors.h"
 #include "atl/file.h"
 #include "atl/status.h"
@@ -13,13 +19,26 @@
 #include "atl/string.h"
 #include "atl/time.h"
 
+#include "activity.h"
+#include "civil_day.h"
 #include "command.h"
+#include "cooccurrence.h"
 #include "filter.h"
+#include "fsck.h"
+#include "index_set.h"
+#include "log_iterator.h"
+#include "page.h"
+#include "query.h"
+#include "query_planner.h"
 #include "serializer.h"
+#include "stats.h"
+#include "tag_tree.h"
 #include "utils.h"
+#include "watcher.h"
 #include "worklog.h"
 
 #include "storage.h"
+#include "tombstone.h"
 
 int CommandNewWorklog(const worklog::CommandContext& ctx) {
   atl::TempFile tmp_file;
@@ -178,67 +197,377 @@ int CommandDeleteWorklog(const worklog::CommandContext& ctx) {
     return -1;
   }
 
-  std::string log_path =
-      atl::JoinStr("/", ctx.config.logs_dir, std::to_string(id));
+  worklog::Storage store(ctx.config);
+  atl::Status status = store.Remove(id);
+  if (!status.ok() && status.error_code() != atl::error::NOT_FOUND) {
+    std::cerr << "Error: Failed to remove log with id: " << id << ". "
+              << status.error_message() << "\n";
+    return -1;
+  }
 
-  if (!atl::FileExists(log_path)) {
-    return 0;
+  worklog::Tombstones tombstones(ctx.config);
+  tombstones.Load();
+  if (tombstones.NeedsCompaction()) {
+    // Compacting in a child process, so 'rm' returns right away:
+    if (fork() == 0) {
+      tombstones.Compact(false);
+      _exit(0);
+    }
+  }
+
+  return 0;
+}
+
+int CommandUndeleteWorklog(const worklog::CommandContext& ctx) {
+  if (ctx.args.size() < 3) {
+    std::cerr << "Error: Please specify a work log id\n";
+    return -1;
+  }
+
+  const std::string& worklog_id = ctx.args[2];
+
+  atl::Optional<int> id = NumberFromString(worklog_id);
+  if (!id) {
+    std::cerr << "Error: Failed to convert worklog id to numeric value: "
+              << worklog_id << "\n";
+
+    return -1;
+  }
+
+  worklog::Storage store(ctx.config);
+  atl::Status status = store.Undelete(id.value());
+  if (!status.ok()) {
+    std::cerr << "Error: Failed to undelete log with id: " << worklog_id
+              << ". " << status.error_message() << "\n";
+    return -1;
   }
 
-  atl::Remove(log_path);
+  return 0;
+}
 
+int CommandCompact(const worklog::CommandContext& ctx) {
+  worklog::Tombstones tombstones(ctx.config);
+  atl::StatusOr<int> removed = tombstones.Compact(true);
+  if (!removed.ok()) {
+    std::cerr << "Error: Failed to compact: "
+              << removed.status().error_message() << "\n";
+    return -1;
+  }
+
+  std::cout << "Removed " << removed.ValueOrDie() << " deleted log(s)\n";
   return 0;
 }
 
 int CommandListBroken(const worklog::CommandContext& ctx) {
-  auto index = IndexFromDir(ctx.config.logs_dir);
-  worklog::ApplyFilter(worklog::OnlyInvalidFilter(), &index);
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
+  }
 
-  for (const auto& log : index) {
-    PrintWorklog(log);
+  const worklog::TimeIndex& times = indexes.time_index();
+  auto logs = worklog::FilterLogs(
+      worklog::IterateNewestFirst(indexes.index(), times, 0, times.size()),
+      worklog::OnlyInvalidFilter(indexes.columns()));
+
+  while (const worklog::Log* log = logs->Next()) {
+    PrintWorklog(*log);
+  }
+
+  return 0;
+}
+
+int CommandFsck(const worklog::CommandContext& ctx) {
+  std::vector<worklog::FsckIssue> issues = worklog::Fsck(ctx.config);
+
+  int num_errors = 0;
+  for (const auto& issue : issues) {
+    if (issue.id > 0) {
+      std::cout << std::setw(10) << std::left << issue.id;
+    } else {
+      std::cout << std::setw(10) << std::left << "-";
+    }
+
+    if (issue.IsError()) {
+      num_errors++;
+      std::cout << atl::console::fg::red;
+    }
+
+    std::cout << std::setw(12) << std::left
+              << worklog::FsckIssueKindName(issue.kind)
+              << atl::console::fg::reset << issue.message << "\n";
+  }
+
+  if (num_errors > 0) {
+    std::cerr << num_errors << " error(s) found\n";
+    return -1;
   }
 
   return 0;
 }
 
+// Takes the paging flags out of the args after the command name.
+bool ParsePageArgs(const worklog::CommandContext& ctx,
+                   std::vector<std::string>* args,
+                   worklog::PageOptions* page) {
+  args->assign(ctx.args.begin() + 2, ctx.args.end());
+
+  atl::Status status = worklog::ParsePageOptions(args, page);
+  if (!status.ok()) {
+    std::cerr << "Error: " << status.error_message() << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+// Goes to stderr, so the logs can be piped on their own.
+void PrintNextPage(const atl::Optional<worklog::Cursor>& next) {
+  if (next) {
+    std::cerr << "More logs: --after " << worklog::FormatCursor(*next)
+              << "\n";
+  }
+}
+
 int CommandListAll(const worklog::CommandContext& ctx) {
-  auto index = IndexFromDir(ctx.config.logs_dir);
-  worklog::ApplyFilter(worklog::OnlyValidFilter(), &index);
+  std::vector<std::string> args;
+  worklog::PageOptions page;
+  if (!ParsePageArgs(ctx, &args, &page)) {
+    return -1;
+  }
 
-  for (const auto& log : index) {
-    PrintWorklog(log);
+  // Listings never show the descriptions, they are not even read:
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
   }
 
+  // Printed while walking the time index, nothing is collected or sorted:
+  const worklog::TimeIndex& times = indexes.time_index();
+  auto logs = worklog::FilterLogs(
+      worklog::IterateNewestFirst(indexes.index(), times, 0,
+                                  worklog::PageEnd(times, page)),
+      worklog::OnlyValidFilter(indexes.columns()));
+
+  PrintNextPage(worklog::WalkPage(logs.get(), page, PrintWorklog));
   return 0;
 }
 
 int SubCommandTagsListAll(const worklog::CommandContext& ctx) {
-  auto index = IndexFromDir(ctx.config.logs_dir);
-  worklog::ApplyFilter(worklog::OnlyValidFilter(), &index);
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
+  }
+
+  // The counts are maintained by the aggregates, only the tags are sorted:
+  const worklog::Aggregates& aggregates = indexes.aggregates();
+  std::vector<uint32_t> tags;
+  for (uint32_t tag = 0; tag < aggregates.num_tags(); tag++) {
+    if (aggregates.tag(tag).count > 0) {
+      tags.push_back(tag);
+    }
+  }
 
-  std::vector<std::string> tags;
-  std::unordered_map<std::string, int> counts;
+  std::sort(tags.begin(), tags.end(), [&aggregates](uint32_t a, uint32_t b) {
+    uint64_t count_a = aggregates.tag(a).count;
+    uint64_t count_b = aggregates.tag(b).count;
+    return count_a > count_b ||
+           (count_a == count_b &&
+            aggregates.tag_name(a) < aggregates.tag_name(b));
+  });
+
+  for (uint32_t tag : tags) {
+    std::cout << aggregates.tag(tag).count << " " << aggregates.tag_name(tag)
+              << " " << atl::FormatTime(aggregates.tag(tag).last_used)
+              << "\n";
+  }
 
-  for (const auto& log : index) {
-    for (const auto& tag : log.tags) {
-      auto found = counts.find(tag);
-      if (found == counts.end()) {
-        tags.push_back(tag);
-      }
+  return 0;
+}
+
+int SubCommandTagsTree(const worklog::CommandContext& ctx) {
+  // Only the subtree of a tag if one is given:
+  const std::string root = ctx.args.size() > 3 ? ctx.args[3] : "";
+
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
+  }
+
+  for (const auto& node :
+       worklog::ComputeTagTree(indexes.index(), indexes.columns())) {
+    if (!root.empty() && node.name != root &&
+        !worklog::MatchesTagPattern(node.name, root + "/*")) {
+      continue;
+    }
 
-      counts[tag]++;
+    std::size_t slash = node.name.rfind('/');
+    std::cout << std::setw(8) << std::left << node.total
+              << std::string(2 * node.depth, ' ')
+              << (slash == std::string::npos || slash == 0
+                      ? node.name
+                      : node.name.substr(slash + 1));
+    if (node.count > 0 && node.count < node.total) {
+      std::cout << " (" << node.count << " tagged " << node.name << ")";
     }
+    std::cout << "\n";
   }
 
-  std::sort(tags.begin(), tags.end(),
-            [&counts](const std::string& a, const std::string& b) {
-              return counts[a] > counts[b];
+  return 0;
+}
+
+int SubCommandTagsRelated(const worklog::CommandContext& ctx) {
+  const std::string& name = ctx.args[3];
+
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
+  }
+
+  const worklog::Aggregates& aggregates = indexes.aggregates();
+  atl::Optional<uint32_t> tag = aggregates.FindTag(name);
+  if (!tag || aggregates.tag(*tag).count == 0) {
+    std::cerr << "Error: Unknown tag: " << name << "\n";
+    return -1;
+  }
+
+  // The tags sharing a log with it, by the number of shared logs:
+  std::vector<std::pair<uint64_t, uint32_t>> related;
+  aggregates.cooccurrence().ForEachPair(
+      [&](uint32_t a, uint32_t b, uint64_t count) {
+        if (a == *tag || b == *tag) {
+          related.emplace_back(count, a == *tag ? b : a);
+        }
+      });
+
+  std::sort(related.begin(), related.end(),
+            [&aggregates](const std::pair<uint64_t, uint32_t>& a,
+                          const std::pair<uint64_t, uint32_t>& b) {
+              return a.first > b.first ||
+                     (a.first == b.first && aggregates.tag_name(a.second) <
+                                                aggregates.tag_name(b.second));
             });
 
-  for (const auto& tag : tags) {
-    std::cout << counts[tag] << " " << tag << "\n";
+  // The share is of the logs with the given tag:
+  uint64_t num_logs = aggregates.tag(*tag).count;
+  for (const auto& other : related) {
+    std::cout << other.first << " " << aggregates.tag_name(other.second)
+              << " " << (other.first * 100 / num_logs) << "%\n";
+  }
+
+  return 0;
+}
+
+// Replaces the tags from (and the tags below them, ie. lang/php for lang)
+// with to in all logs. The logs are found by tag id in the columns and
+// rewritten by a batch which updates the indexes once. If to is below a
+// tag from (ie. merge x x/y) it keeps its name, as do the tags below it.
+int RewriteTags(const worklog::CommandContext& ctx,
+                const std::vector<std::string>& from, const std::string& to,
+                bool into_existing) {
+  std::map<std::string, std::string> renames;
+  std::vector<int> ids;
+  {
+    worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+    atl::Status status = indexes.Open();
+    if (!status.ok()) {
+      std::cerr << "Warning: " << status.error_message() << "\n";
+    }
+
+    // The tags of the logs which aren't deleted, invalid ones included:
+    const worklog::ColumnIndex& columns = indexes.columns();
+    std::vector<bool> used(columns.num_tags(), false);
+    for (std::size_t row = 0; row < columns.size(); row++) {
+      if (!indexes.index().IsDeleted(columns.id(row))) {
+        for (auto tag = columns.tags_begin(row); tag != columns.tags_end(row);
+             ++tag) {
+          used[*tag] = true;
+        }
+      }
+    }
+
+    auto in_use = [&columns, &used](const std::string& name) {
+      atl::Optional<uint32_t> tag = columns.FindTag(name);
+      return tag && used[*tag];
+    };
+
+    std::vector<bool> renamed(columns.num_tags(), false);
+    for (const auto& name : from) {
+      if (name == to) {
+        continue;
+      }
+
+      std::vector<uint32_t> tags = columns.FindTagsWithPrefix(name + "/");
+      if (auto tag = columns.FindTag(name)) {
+        tags.push_back(*tag);
+      }
+
+      for (uint32_t tag : tags) {
+        const std::string& old_name = columns.tag_name(tag);
+        if (!in_use(old_name) || old_name == to ||
+            atl::StringView(old_name).starts_with(to + "/")) {
+          continue;
+        }
+
+        std::string new_name = to + old_name.substr(name.size());
+        if (!into_existing && in_use(new_name)) {
+          std::cerr << "Error: The tag " << new_name << " already exists, "
+                    << "use: " << ctx.args[0] << " tag merge " << old_name
+                    << " " << new_name << "\n";
+          return -1;
+        }
+
+        renames[old_name] = new_name;
+        renamed[tag] = true;
+      }
+    }
+
+    if (renames.empty()) {
+      std::cerr << "Error: Unknown tag: " << atl::Join(from, ", ") << "\n";
+      return -1;
+    }
+
+    for (std::size_t row = 0; row < columns.size(); row++) {
+      if (indexes.index().IsDeleted(columns.id(row))) {
+        continue;
+      }
+
+      for (auto tag = columns.tags_begin(row); tag != columns.tags_end(row);
+           ++tag) {
+        if (renamed[*tag]) {
+          ids.push_back(columns.id(row));
+          break;
+        }
+      }
+    }
+  }
+
+  worklog::Storage store(ctx.config);
+  atl::StatusOr<int> written = store.ModifyAll(
+      ids, [&renames](worklog::Log* log) {
+        // All renames apply to the original tags, a target is never
+        // renamed again:
+        std::set<std::string> tags;
+        for (const auto& tag : log->tags) {
+          auto rename = renames.find(tag);
+          tags.insert(rename == renames.end() ? tag : rename->second);
+        }
+        log->tags.swap(tags);
+      });
+  if (!written.ok()) {
+    std::cerr << "Error: Failed to update the logs: "
+              << written.status().error_message() << "\n";
+    return -1;
   }
 
+  for (const auto& rename : renames) {
+    std::cout << rename.first << " -> " << rename.second << "\n";
+  }
+  std::cout << "Updated " << written.ValueOrDie() << " log(s)\n";
   return 0;
 }
 
@@ -256,18 +585,8 @@ int SubCommandTagsRemove(const worklog::CommandContext& ctx) {
     return -1;
   }
 
-  atl::StatusOr<worklog::Log> status = store.LoadById(id.value());
-  if (!status.ok()) {
-    std::cerr << "Error: Failed to load worklog by id " << worklog_id << ". "
-              << status.status().error_message() << "\n";
-    return -1;
-  }
-
-  auto log = status.ValueOrDie();
-
-  log.tags.erase(tag);
-
-  atl::Status updateStatus = store.Update(log);
+  atl::Status updateStatus = store.Modify(
+      id.value(), [&tag](worklog::Log* log) { log->tags.erase(tag); });
   if (!updateStatus.ok()) {
     std::cerr << "Error: Failed to update log with id: " << worklog_id << ". "
               << updateStatus.error_message() << "\n";
@@ -291,18 +610,8 @@ int SubCommandTagsAdd(const worklog::CommandContext& ctx) {
     return -1;
   }
 
-  atl::StatusOr<worklog::Log> status = store.LoadById(id.value());
-  if (!status.ok()) {
-    std::cerr << "Error: Failed to load worklog by id " << worklog_id << ". "
-              << status.status().error_message() << "\n";
-    return -1;
-  }
-
-  auto log = status.ValueOrDie();
-
-  log.tags.insert(tag);
-
-  atl::Status updateStatus = store.Update(log);
+  atl::Status updateStatus = store.Modify(
+      id.value(), [&tag](worklog::Log* log) { log->tags.insert(tag); });
   if (!updateStatus.ok()) {
     std::cerr << "Error: Failed to update log with id: " << worklog_id << ". "
               << updateStatus.error_message() << "\n";
@@ -322,13 +631,44 @@ int CommandTags(const worklog::CommandContext& ctx) {
               << ctx.args[0] << " tag remove php <id>     "
               << "removes php tag from worklog\n"
               << ctx.args[0] << " tag list                "
-              << "lists all available tags\n";
+              << "lists all available tags\n"
+              << ctx.args[0] << " tag tree [lang]         "
+              << "lists the tags as a tree, counting the tags below\n"
+              << ctx.args[0] << " tag related php         "
+              << "lists the tags used together with php\n"
+              << ctx.args[0] << " tag rename js ecmascript "
+              << "renames a tag (and the tags below it) in all logs\n"
+              << ctx.args[0] << " tag merge js es6 javascript "
+              << "merges tags into the last one in all logs\n";
 
     return -1;
   }
 
   if (ctx.args[2] == "list" || ctx.args[2] == "all") {
     return SubCommandTagsListAll(ctx);
+  } else if (ctx.args[2] == "tree") {
+    return SubCommandTagsTree(ctx);
+  } else if (ctx.args[2] == "rename" || ctx.args[2] == "merge") {
+    const bool merge = ctx.args[2] == "merge";
+    if (ctx.args.size() < 5 || (!merge && ctx.args.size() > 5)) {
+      std::cerr << "Please specify the " << (merge ? "tags" : "tag")
+                << " and the new name.\n"
+                << "Enter: " << ctx.args[0] << " tag for further help\n";
+
+      return -1;
+    }
+
+    std::vector<std::string> from(ctx.args.begin() + 3, ctx.args.end() - 1);
+    return RewriteTags(ctx, from, ctx.args.back(), merge);
+  } else if (ctx.args[2] == "related") {
+    if (ctx.args.size() < 4) {
+      std::cerr << "Please specify a tag.\n"
+                << "Enter: " << ctx.args[0] << " tag for further help\n";
+
+      return -1;
+    }
+
+    return SubCommandTagsRelated(ctx);
   } else if (ctx.args[2] == "add") {
     if (ctx.args.size() < 5) {
       std::cerr << "Please specify a tag and worklog id.\n"
@@ -351,30 +691,439 @@ int CommandTags(const worklog::CommandContext& ctx) {
   }
 
   return 0;
-  auto index = IndexFromDir(ctx.config.logs_dir);
-  worklog::ApplyFilter(worklog::OnlyValidFilter(), &index);
 }
 
 int CommandYearly(const worklog::CommandContext& ctx) {
-  auto index = IndexFromDir(ctx.config.logs_dir);
-  worklog::ApplyFilter(worklog::OnlyValidFilter(), &index);
-
-  int prev_year = 0;
-  for (const auto& log : index) {
-    int year = std::stoi(atl::FormatTime(log.created_at, "%Y"));
-    if (prev_year != year) {
-      if (prev_year != 0) {
+  std::vector<std::string> args;
+  worklog::PageOptions page;
+  if (!ParsePageArgs(ctx, &args, &page)) {
+    return -1;
+  }
+
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
+  }
+
+  // The logs come newest first, so the year only moves backwards through
+  // the precomputed years of the time index:
+  std::vector<worklog::TimePeriod> years = indexes.time_index().Years();
+  auto year = years.rbegin();
+  int printed_year = 0;
+
+  auto print = [&](const worklog::Log& log) {
+    while (year + 1 != years.rend() && log.created_at < year->start) {
+      ++year;
+    }
+
+    if (year->year != printed_year) {
+      if (printed_year != 0) {
         std::cout << "\n";
       }
 
-      std::cout << atl::console::style::bold << atl::console::fg::cyan << year
-                << ":" << atl::console::fg::reset << atl::console::style::reset
-                << "\n";
+      std::cout << atl::console::style::bold << atl::console::fg::cyan
+                << year->year << ":" << atl::console::fg::reset
+                << atl::console::style::reset << "\n";
 
-      prev_year = year;
+      printed_year = year->year;
     }
 
     PrintWorklog(log);
+  };
+
+  const worklog::TimeIndex& times = indexes.time_index();
+  auto logs = worklog::FilterLogs(
+      worklog::IterateNewestFirst(indexes.index(), times, 0,
+                                  worklog::PageEnd(times, page)),
+      worklog::OnlyValidFilter(indexes.columns()));
+
+  PrintNextPage(worklog::WalkPage(logs.get(), page, print));
+  return 0;
+}
+
+int CommandHeatmap(const worklog::CommandContext& ctx) {
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
+  }
+
+  // The logs per day are maintained by the aggregates:
+  const std::map<int64_t, uint64_t>& days = indexes.aggregates().days();
+  if (days.empty()) {
+    std::cout << "No logs\n";
+    return 0;
+  }
+
+  // The year of the newest log by default:
+  int64_t year = worklog::CivilFromDays(days.rbegin()->first).year;
+  if (ctx.args.size() > 2) {
+    atl::Optional<int> number = atl::ParseInt(ctx.args[2]);
+    if (ctx.args.size() > 3 || !number) {
+      std::cerr << "Error: Expected a year, ie.: " << ctx.args[0]
+                << " heatmap 2017\n";
+      return -1;
+    }
+    year = number.value();
+  }
+
+  std::cout << worklog::RenderHeatmap(days, year);
+  return 0;
+}
+
+int SubCommandStatsAggregates(const worklog::CommandContext& ctx) {
+  const std::string& action = ctx.args[2];
+
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
+  }
+
+  worklog::Aggregates& aggregates = indexes.aggregates();
+  if (action == "cooccurrence") {
+    // Every pair of tags used together, the most frequent first:
+    std::vector<std::pair<uint64_t, std::pair<uint32_t, uint32_t>>> pairs;
+    aggregates.cooccurrence().ForEachPair(
+        [&pairs](uint32_t a, uint32_t b, uint64_t count) {
+          pairs.push_back({count, {a, b}});
+        });
+
+    std::sort(pairs.begin(), pairs.end(),
+              [](const std::pair<uint64_t, std::pair<uint32_t, uint32_t>>& a,
+                 const std::pair<uint64_t, std::pair<uint32_t, uint32_t>>& b) {
+                return a.first > b.first ||
+                       (a.first == b.first && a.second < b.second);
+              });
+
+    for (const auto& pair : pairs) {
+      std::cout << std::setw(8) << std::left << pair.first
+                << aggregates.tag_name(pair.second.first) << " & "
+                << aggregates.tag_name(pair.second.second) << "\n";
+    }
+    return 0;
+  }
+
+  if (action == "totals") {
+    for (const auto& year : aggregates.years()) {
+      std::cout << std::setw(10) << std::left << year.first << year.second
+                << "\n";
+    }
+    std::cout << std::setw(10) << std::left << "all"
+              << aggregates.num_logs() << "\n";
+    return 0;
+  }
+
+  // Both recompute the aggregates from the index, a rebuild replaces the
+  // maintained ones with them:
+  worklog::Aggregates expected(ctx.config);
+  expected.Rebuild(indexes.index());
+  expected.Sync(indexes.index());
+
+  if (action == "rebuild") {
+    atl::Status save_status = expected.Save(indexes.index().generation());
+    if (!save_status.ok()) {
+      std::cerr << "Error: " << save_status.error_message() << "\n";
+      return -1;
+    }
+
+    std::cout << "Rebuilt the aggregates of " << expected.num_logs()
+              << " log(s)\n";
+    return 0;
+  }
+
+  std::vector<std::string> diffs = aggregates.Diff(expected);
+
+  // The co-occurrences are recounted from the columns instead:
+  const worklog::ColumnIndex& columns = indexes.columns();
+  for (const auto& diff : aggregates.Diff(
+           columns, worklog::ComputeCooccurrence(indexes.index(), columns))) {
+    diffs.push_back(diff);
+  }
+  for (const auto& diff : diffs) {
+    std::cout << diff << "\n";
+  }
+
+  if (!diffs.empty()) {
+    std::cerr << "The aggregates are out of date, run: " << ctx.args[0]
+              << " stats rebuild\n";
+    return 1;
+  }
+
+  std::cout << "The aggregates of " << aggregates.num_logs()
+            << " log(s) are up to date\n";
+  return 0;
+}
+
+int SubCommandStatsTerms(const worklog::CommandContext& ctx) {
+  // 'stats terms by tag --limit 5', the limit is the terms per group:
+  std::vector<std::string> args(ctx.args.begin() + 3, ctx.args.end());
+  worklog::PageOptions page;
+  atl::Status status = worklog::ParsePageOptions(&args, &page);
+  if (!status.ok()) {
+    std::cerr << "Error: " << status.error_message() << "\n";
+    return -1;
+  }
+
+  if (!args.empty() && args[0] == "by") {
+    args.erase(args.begin());
+  }
+
+  if (args.size() > 1) {
+    std::cerr << "Error: Expected a single group list, ie. " << ctx.args[0]
+              << " stats terms by tag\n";
+    return -1;
+  }
+
+  atl::StatusOr<worklog::GroupBy> group_by =
+      worklog::ParseGroupBy(args.empty() ? "" : args[0]);
+  if (!group_by.ok()) {
+    std::cerr << "Error: " << group_by.status().error_message() << "\n";
+    return -1;
+  }
+
+  // The terms come from the descriptions:
+  worklog::IndexSet indexes(ctx.config, worklog::kAllFields);
+  atl::Status open_status = indexes.Open();
+  if (!open_status.ok()) {
+    std::cerr << "Warning: " << open_status.error_message() << "\n";
+  }
+
+  const std::string& group_field = group_by.ValueOrDie().field;
+  if (!group_field.empty() &&
+      !indexes.columns().FindMetadataKey(group_field)) {
+    std::cerr << "Error: Unknown group: " << group_field
+              << " (expected year, month, week, tag or a field)\n";
+    return -1;
+  }
+
+  const bool by_group = group_by.ValueOrDie().tag || !group_field.empty();
+  const std::size_t limit =
+      page.limit == worklog::PageOptions::kNoLimit ? 10 : page.limit;
+
+  std::vector<worklog::TermsRow> rows = worklog::ComputeTermStats(
+      indexes.index(), indexes.columns(), group_by.ValueOrDie(), limit);
+
+  if (by_group) {
+    std::cout << std::setw(21) << std::left
+              << (group_field.empty() ? "tag" : group_field);
+  }
+  std::cout << std::setw(10) << std::left << "period" << std::setw(8)
+            << "logs"
+            << "terms\n";
+
+  for (const auto& row : rows) {
+    if (by_group) {
+      std::cout << std::setw(21) << std::left
+                << atl::CreateSnippet(row.group, 20);
+    }
+    std::cout << std::setw(10) << std::left << row.period << std::setw(8)
+              << row.count;
+    for (std::size_t i = 0; i < row.terms.size(); i++) {
+      std::cout << (i > 0 ? ", " : "") << row.terms[i].first << " ("
+                << row.terms[i].second << ")";
+    }
+    std::cout << "\n";
+  }
+
+  return 0;
+}
+
+int SubCommandStatsRollup(const worklog::CommandContext& ctx) {
+  // 'stats rollup week --window 4 --limit 12', the limit keeps the last
+  // periods:
+  std::vector<std::string> args(ctx.args.begin() + 3, ctx.args.end());
+  worklog::PageOptions page;
+  atl::Status status = worklog::ParsePageOptions(&args, &page);
+  if (!status.ok()) {
+    std::cerr << "Error: " << status.error_message() << "\n";
+    return -1;
+  }
+
+  std::size_t window = 7;
+  auto flag = std::find(args.begin(), args.end(), "--window");
+  if (flag != args.end()) {
+    atl::Optional<int> number;
+    if (flag + 1 != args.end()) {
+      number = atl::ParseInt(*(flag + 1));
+    }
+    if (!number || number.value() < 1) {
+      std::cerr << "Error: --window expects a number of periods\n";
+      return -1;
+    }
+    window = number.value();
+    args.erase(flag, flag + 2);
+  }
+
+  if (args.size() != 1) {
+    std::cerr << "Error: Expected a period, ie. " << ctx.args[0]
+              << " stats rollup week\n";
+    return -1;
+  }
+
+  atl::StatusOr<worklog::RollupPeriod> period =
+      worklog::ParseRollupPeriod(args[0]);
+  if (!period.ok()) {
+    std::cerr << "Error: " << period.status().error_message() << "\n";
+    return -1;
+  }
+
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status open_status = indexes.Open();
+  if (!open_status.ok()) {
+    std::cerr << "Warning: " << open_status.error_message() << "\n";
+  }
+
+  std::vector<worklog::RollupRow> rows = worklog::ComputeRollup(
+      indexes.aggregates().days(), period.ValueOrDie(), window);
+
+  std::size_t begin =
+      page.limit < rows.size() ? rows.size() - page.limit : 0;
+  std::cout << std::setw(12) << std::left << "period" << std::setw(8)
+            << "logs"
+            << "average of " << window << "\n";
+  for (std::size_t i = begin; i < rows.size(); i++) {
+    std::cout << std::setw(12) << std::left << rows[i].period << std::setw(8)
+              << rows[i].count << std::fixed << std::setprecision(2)
+              << rows[i].average << "\n";
+  }
+
+  return 0;
+}
+
+int CommandStats(const worklog::CommandContext& ctx) {
+  // 'stats yearly' is the yearly report, the args are shifted for it:
+  if (ctx.args.size() > 2 && ctx.args[2] == "yearly") {
+    worklog::CommandContext yearly = ctx;
+    yearly.args.erase(yearly.args.begin() + 1);
+    return CommandYearly(yearly);
+  }
+
+  if (ctx.args.size() > 2 &&
+      (ctx.args[2] == "totals" || ctx.args[2] == "cooccurrence" ||
+       ctx.args[2] == "verify" ||
+       ctx.args[2] == "rebuild")) {
+    return SubCommandStatsAggregates(ctx);
+  }
+
+  if (ctx.args.size() > 2 && ctx.args[2] == "terms") {
+    return SubCommandStatsTerms(ctx);
+  }
+
+  if (ctx.args.size() > 2 && ctx.args[2] == "rollup") {
+    return SubCommandStatsRollup(ctx);
+  }
+
+  std::vector<std::string> args(ctx.args.begin() + 2, ctx.args.end());
+
+  // 'stats sum duration by tag,month' aggregates a field:
+  worklog::AggregateOp op = worklog::AggregateOp::kSum;
+  std::string field;
+  atl::StatusOr<worklog::AggregateOp> parsed_op =
+      worklog::ParseAggregateOp(args.empty() ? "" : args[0]);
+  if (parsed_op.ok()) {
+    if (args.size() < 2) {
+      std::cerr << "Error: Expected a field, ie. " << ctx.args[0]
+                << " stats " << args[0] << " duration by tag\n";
+      return -1;
+    }
+    op = parsed_op.ValueOrDie();
+    field = args[1];
+    args.erase(args.begin(), args.begin() + 2);
+  }
+
+  if (!args.empty() && args[0] == "by") {
+    args.erase(args.begin());
+  }
+
+  if (args.size() > 1) {
+    std::cerr << "Error: Expected a single group list, ie. "
+              << ctx.args[0] << " stats tag,month\n";
+    return -1;
+  }
+
+  atl::StatusOr<worklog::GroupBy> group_by =
+      worklog::ParseGroupBy(args.empty() ? "" : args[0]);
+  if (!group_by.ok()) {
+    std::cerr << "Error: " << group_by.status().error_message() << "\n";
+    return -1;
+  }
+
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
+  }
+
+  const std::string& group_field = group_by.ValueOrDie().field;
+  if (!group_field.empty() &&
+      !indexes.columns().FindMetadataKey(group_field)) {
+    std::cerr << "Error: Unknown group: " << group_field
+              << " (expected year, month, week, tag or a field)\n";
+    return -1;
+  }
+
+  const bool by_group = group_by.ValueOrDie().tag || !group_field.empty();
+  const std::string group_name = group_field.empty() ? "tag" : group_field;
+
+  if (!field.empty()) {
+    atl::StatusOr<worklog::AggregateResult> result = worklog::ComputeAggregate(
+        indexes.index(), indexes.columns(), op, field,
+        group_by.ValueOrDie());
+    if (!result.ok()) {
+      std::cerr << "Error: " << result.status().error_message() << "\n";
+      return -1;
+    }
+
+    const worklog::AggregateResult& aggregate = result.ValueOrDie();
+    if (aggregate.skipped > 0) {
+      std::cerr << "Warning: Skipped " << aggregate.skipped << " value(s) of "
+                << field << " which aren't "
+                << worklog::MetadataTypeName(aggregate.type) << "s\n";
+    }
+
+    if (by_group) {
+      std::cout << std::setw(21) << std::left << group_name;
+    }
+    std::cout << std::setw(10) << std::left << "period" << std::setw(8)
+              << "logs" << ctx.args[2] << " " << field << "\n";
+
+    for (const auto& row : aggregate.rows) {
+      if (by_group) {
+        std::cout << std::setw(21) << std::left
+                  << atl::CreateSnippet(row.group, 20);
+      }
+      std::cout << std::setw(10) << std::left << row.period << std::setw(8)
+                << row.count
+                << (aggregate.type == worklog::MetadataType::kDuration
+                        ? worklog::FormatDuration(row.value)
+                        : std::to_string(row.value))
+                << "\n";
+    }
+    return 0;
+  }
+
+  std::vector<worklog::StatsRow> rows = worklog::ComputeStats(
+      indexes.index(), indexes.columns(), group_by.ValueOrDie());
+
+  if (by_group) {
+    std::cout << std::setw(21) << std::left << group_name;
+  }
+  std::cout << std::setw(10) << std::left << "period" << std::setw(8)
+            << "logs" << std::setw(12) << "first" << std::setw(12) << "last"
+            << std::setw(6) << "days"
+            << "streak\n";
+
+  for (const auto& row : rows) {
+    if (by_group) {
+      std::cout << std::setw(21) << std::left
+                << atl::CreateSnippet(row.group, 20);
+    }
+    std::cout << std::setw(10) << std::left << row.period << std::setw(8)
+              << row.count << std::setw(12) << atl::FormatTime(row.first)
+              << std::setw(12) << atl::FormatTime(row.last) << std::setw(6)
+              << row.active_days << row.longest_streak << "\n";
   }
 
   return 0;
@@ -387,28 +1136,270 @@ int CommandSearch(const worklog::CommandContext& ctx) {
     return 1;
   }
 
-  // Concat the args so we have a string for the ParseFilter
-  int first_tag_idx = 2;
+  std::vector<std::string> args;
+  worklog::PageOptions page;
+  if (!ParsePageArgs(ctx, &args, &page)) {
+    return -1;
+  }
+
+  bool ranked = false;
+  bool explain = false;
+
+  // Concat the args so we have a string for the ParseQuery
   std::ostringstream text;
-  for (unsigned int i = first_tag_idx; i < ctx.args.size(); i++) {
-    text << ctx.args[i] << " ";
+  for (const std::string& arg : args) {
+    if (arg == "--ranked") {
+      ranked = true;
+      continue;
+    }
+
+    if (arg == "--explain") {
+      explain = true;
+      continue;
+    }
+
+    text << arg << " ";
   }
 
-  const worklog::Filter& filter = worklog::ParseFilter(text.str());
-  std::vector<worklog::Log> index = IndexFromDir(ctx.config.logs_dir);
+  std::unique_ptr<worklog::QueryNode> query;
+  atl::Status status = worklog::ParseQuery(text.str(), &query);
+  if (!status.ok()) {
+    std::cerr << "Error: " << status.error_message() << "\n";
+    return -1;
+  }
+
+  // The descriptions are only needed to search or rank the text:
+  bool has_text = ranked || !worklog::QueryTexts(*query).empty();
+  worklog::IndexSet indexes(ctx.config, has_text ? worklog::kAllFields
+                                                 : worklog::kHeaderFields);
+  atl::Status open_status = indexes.Open();
+  if (!open_status.ok()) {
+    std::cerr << "Warning: " << open_status.error_message() << "\n";
+  }
+
+  if (ranked) {
+    if (page.after) {
+      std::cerr << "Error: --after can't be used with --ranked, use --offset "
+                   "instead\n";
+      return -1;
+    }
+
+    const std::size_t limit =
+        page.limit == worklog::PageOptions::kNoLimit ? 10 : page.limit;
+
+    // Ranked by the text & the plain words; the rest of the query only
+    // restricts the candidates:
+    std::vector<std::string> terms;
+    for (const auto& query_text : worklog::QueryTexts(*query)) {
+      for (auto& term : worklog::Tokenize(query_text)) {
+        terms.push_back(term);
+      }
+    }
+
+    const worklog::Index& logs = indexes.index();
+    auto only_valid = worklog::OnlyValidFilter(indexes.columns());
+
+    auto results = indexes.inverted_index().TopK(
+        terms, page.offset + limit, [&logs, &only_valid, &query](int id) -> bool {
+          auto found = logs.entries().find(id);
+          return found != logs.entries().end() && !logs.IsDeleted(id) &&
+                 only_valid(found->second.log) &&
+                 worklog::Matches(*query, found->second.log, true);
+        });
+
+    for (std::size_t i = page.offset; i < results.size(); i++) {
+      PrintWorklog(logs.entries().at(results[i].id).log);
+    }
+
+    return 0;
+  }
 
-  worklog::ApplyFilter(worklog::OnlyValidFilter(), &index);
+  worklog::QueryPlanner planner(&indexes);
+  worklog::QueryPlan plan = planner.Plan(query.get());
 
-  if (filter.tags.size() > 0 || filter.tags_negative.size() > 0) {
-    worklog::ApplyFilter(worklog::TagsFilter(filter), &index);
+  if (explain) {
+    std::cout << planner.Explain(plan, *query);
+    return 0;
   }
 
-  if (filter.subject.length() > 0) {
-    worklog::ApplyFilter(worklog::SubjectFilter(filter), &index);
+  if (plan.ordered()) {
+    // Found newest first, so printed as they are found until the page is
+    // full:
+    auto logs = planner.Iterate(plan, *query,
+                                worklog::PageEnd(indexes.time_index(), page));
+    PrintNextPage(worklog::WalkPage(logs.get(), page, PrintWorklog));
+    return 0;
   }
 
-  for (const auto& log : index) {
-    PrintWorklog(log);
+  const worklog::Index& index = indexes.index();
+
+  atl::Optional<worklog::Cursor> next;
+  for (int id :
+       worklog::SelectPage(index, indexes.columns(),
+                           planner.Execute(plan, *query), page, &next)) {
+    PrintWorklog(index.entries().at(id).log);
+  }
+
+  PrintNextPage(next);
+  return 0;
+}
+
+int CommandDupes(const worklog::CommandContext& ctx) {
+  std::vector<std::string> args;
+  worklog::PageOptions page;
+  if (!ParsePageArgs(ctx, &args, &page)) {
+    return -1;
+  }
+
+  if (page.after) {
+    std::cerr << "Error: --after can't be used with dupes, use --offset "
+                 "instead\n";
+    return -1;
+  }
+
+  // The minimum similarity in percent:
+  int min_similarity = 80;
+  if (!args.empty()) {
+    atl::Optional<int> number = atl::ParseInt(args[0]);
+    if (args.size() > 1 || !number || number.value() < 1 ||
+        number.value() > 100) {
+      std::cerr << "Error: Expected the minimum similarity in percent "
+                << "(1-100), ie.: " << ctx.args[0] << " dupes 90\n";
+      return -1;
+    }
+    min_similarity = number.value();
+  }
+
+  worklog::IndexSet indexes(ctx.config, worklog::kHeaderFields);
+  atl::Status status = indexes.Open();
+  if (!status.ok()) {
+    std::cerr << "Warning: " << status.error_message() << "\n";
+  }
+
+  // Only the logs which changed since the last time are hashed (the
+  // signatures are rebuilt with the descriptions if they are outdated,
+  // which reloads the index, so it is taken afterwards):
+  std::vector<worklog::DuplicateGroup> groups =
+      indexes.signatures().FindDuplicates(indexes.index(),
+                                          min_similarity / 100.0);
+  const worklog::Index& index = indexes.index();
+
+  std::size_t begin = std::min(page.offset, groups.size());
+  std::size_t end = begin + std::min(page.limit, groups.size() - begin);
+  for (std::size_t i = begin; i < end; i++) {
+    const worklog::DuplicateGroup& group = groups[i];
+    double similarity = *std::min_element(group.similarities.begin() + 1,
+                                          group.similarities.end());
+    std::cout << group.ids.size() << " logs, "
+              << static_cast<int>(similarity * 100) << "% or more like "
+              << group.ids[0] << ":\n";
+
+    for (int id : group.ids) {
+      PrintWorklog(index.entries().at(id).log);
+    }
+    std::cout << "\n";
+  }
+
+  return 0;
+}
+
+int CommandComplete(const worklog::CommandContext& ctx,
+                    const worklog::CommandParser& cp) {
+  // Enough for a shell to show, the rest is narrowed down by typing:
+  constexpr std::size_t kMaxCompletions = 100;
+
+  if (ctx.args.size() < 3 || ctx.args.size() > 4) {
+    std::cerr << "Error: Expected a context and a prefix, ie. " << ctx.args[0]
+              << " complete tag la\n";
+    return -1;
+  }
+
+  atl::StatusOr<worklog::CompletionContext> context =
+      worklog::ParseCompletionContext(ctx.args[2]);
+  if (!context.ok()) {
+    std::cerr << "Error: " << context.status().error_message() << "\n";
+    return -1;
+  }
+
+  const std::string prefix = ctx.args.size() > 3 ? ctx.args[3] : "";
+  if (context.ValueOrDie() == worklog::CompletionContext::kCommand) {
+    for (const auto& name : cp.names()) {
+      if (atl::StringView(name).starts_with(prefix)) {
+        std::cout << name << "\n";
+      }
+    }
+    return 0;
+  }
+
+  if (!worklog::IsInWorklogSpace(ctx.config)) {
+    return 0;
+  }
+
+  // Answered from the completions file alone. Only if there is none yet or
+  // logs changed since it has been saved it is caught up with the log
+  // index first, which the log files aren't read for (no mtime sweep):
+  auto print_completions = [&]() {
+    auto candidates = worklog::CompletionIndex::Complete(
+        ctx.config, context.ValueOrDie(), prefix, kMaxCompletions);
+    if (!candidates.ok()) {
+      return false;
+    }
+    for (const auto& candidate : candidates.ValueOrDie()) {
+      std::cout << candidate << "\n";
+    }
+    return true;
+  };
+
+  if (!print_completions()) {
+    worklog::IndexSet indexes(ctx.config,
+                              worklog::kFieldTags | worklog::kFieldSubject);
+    indexes.Load();
+    indexes.completions();
+    print_completions();
+  }
+  return 0;
+}
+
+int CommandWatch(const worklog::CommandContext& ctx) {
+  // Waiting a bit after the last event, so an editor which writes a
+  // swap file, renames and chmods results in one index update:
+  const std::chrono::milliseconds quiet_period(200);
+
+  worklog::Watcher watcher(ctx.config);
+  atl::Status status = watcher.Start();
+  if (!status.ok()) {
+    std::cerr << "Error: " << status.error_message() << "\n";
+    return -1;
+  }
+
+  // The sweep happens after the watch has been added, so no change can
+  // slip through in between:
+  worklog::IndexSet indexes(ctx.config);
+  atl::Status open_status = indexes.Open();
+  if (!open_status.ok()) {
+    std::cerr << "Warning: " << open_status.error_message() << "\n";
+  }
+
+  for (;;) {
+    atl::StatusOr<worklog::Changes> changes = watcher.Wait(quiet_period);
+    if (!changes.ok()) {
+      std::cerr << "Error: " << changes.status().error_message() << "\n";
+      return -1;
+    }
+
+    std::vector<int> ids;
+    if (changes.ValueOrDie().overflow) {
+      std::cerr << "Event queue overflowed, sweeping the logs dir\n";
+      ids = indexes.index().Sweep();
+    } else {
+      const auto& changed = changes.ValueOrDie().ids;
+      ids.assign(changed.begin(), changed.end());
+    }
+
+    atl::Status apply_status = indexes.Apply(ids);
+    if (!apply_status.ok()) {
+      std::cerr << "Error: " << apply_status.error_message() << "\n";
+    }
   }
 
   return 0;
@@ -461,30 +1452,68 @@ worklog::CommandParser MakeCommandParser() {
   CommandParser cp;
   cp.Add(Command("init", "initializes a worklog space", &CommandInitWorklog));
   cp.Add(Command("new", "add a new work log",
-                 MustBeInWorkspace(&CommandNewWorklog)));
+                 MustBeInWorkspace(MustHaveEditor(&CommandNewWorklog))));
   cp.Add(Command("edit",
                  "edit a work log. An additional id parameter is required.",
-                 MustBeInWorkspace(&CommandEditWorklog)));
+                 MustBeInWorkspace(MustHaveEditor(&CommandEditWorklog))));
   cp.Add(Command("view",
                  "view a work log. An additional id parameter is required.",
                  MustBeInWorkspace(&CommandViewWorklog)));
   cp.Add(Command("rm",
                  "removes a work log. An additional id parameter is required.",
                  MustBeInWorkspace(&CommandDeleteWorklog)));
-  cp.Add(Command("list", "lists all logs", MustBeInWorkspace(&CommandListAll)));
+  cp.Add(Command("undelete",
+                 "restores a removed work log. An additional id parameter is "
+                 "required.",
+                 MustBeInWorkspace(&CommandUndeleteWorklog)));
+  cp.Add(Command("compact",
+                 "permanently removes the deleted work logs",
+                 MustBeInWorkspace(&CommandCompact)));
+  cp.Add(Command("list",
+                 "lists all logs. Paging: [--limit N] [--offset N] "
+                 "[--after <cursor>] (also for search & yearly)",
+                 MustBeInWorkspace(&CommandListAll)));
   cp.Add(Command("broken", "lists all invalid logs",
                  MustBeInWorkspace(&CommandListBroken)));
 
-  cp.Add(Command("tag", "add, remove or list tags",
+  cp.Add(Command("fsck",
+                 "verifies the checksums of all logs, the index and next_id",
+                 MustBeInWorkspace(&CommandFsck)));
+
+  cp.Add(Command("tag", "add, remove, rename, merge, list tags (as a tree) or list "
+                 "the related tags",
                  MustBeInWorkspace(&CommandTags)));
 
   cp.Add(Command("search",
-                 "search the work logs by a filter: tag:php -tag:javascript",
+                 "search the work logs by a query: tag:php (text:\"lock "
+                 "contention\" OR subject:mutex) -tag:javascript date:2017 "
+                 "id:10..20. With --ranked [--limit 10] the best matches for "
+                 "the words come first, --explain shows the query plan",
                  MustBeInWorkspace(&CommandSearch)));
 
-  // TODO(an): make it 'stats yearly':
+  cp.Add(Command("stats",
+                 "activity per group: stats [by] year|month|week|tag|<field> "
+                 "or a combination like tag,month (logs, first & last date, "
+                 "active days, longest streak). stats sum|avg|min|max "
+                 "<field> [by groups] aggregates a field like duration=1h30m. "
+                 "stats terms [by groups] [--limit N] the most frequent "
+                 "words of the descriptions. stats rollup "
+                 "day|week|month|year [--window N] [--limit N] the logs per "
+                 "period with a moving average. stats yearly is the yearly "
+                 "report, stats totals the logs per year, stats "
+                 "cooccurrence the tags used together. stats verify & "
+                 "stats rebuild check & rebuild the maintained counts",
+                 MustBeInWorkspace(&CommandStats)));
   cp.Add(Command("yearly", "shows a breakdown report by year",
                  MustBeInWorkspace(&CommandYearly)));
+  cp.Add(Command("heatmap",
+                 "shows the logs per day of a year as a calendar: heatmap "
+                 "[year, default the last one]",
+                 MustBeInWorkspace(&CommandHeatmap)));
+  cp.Add(Command("watch",
+                 "keeps the index up to date while logs are edited outside "
+                 "of worklog (runs in the foreground)",
+                 MustBeInWorkspace(&CommandWatch)));
   cp.Add(Command("rep",
                  "repeats a command. Example: ./tool rep 1,3,7 view "
                  "[\"separator string\"] (shows 1, 3 & 7 in a loop)",
@@ -492,6 +1521,18 @@ worklog::CommandParser MakeCommandParser() {
                    return CommandRepeat(ctx, cp);
                  }));
 
+  cp.Add(Command("dupes",
+                 "lists the groups of logs with near duplicate descriptions: "
+                 "dupes [min similarity in %, default 80] [--limit N]",
+                 MustBeInWorkspace(&CommandDupes)));
+
+  cp.Add(Command("complete",
+                 "shell completion: complete command|tag|id|word <prefix> "
+                 "prints the candidates without loading the logs",
+                 [&cp](const worklog::CommandContext& ctx) -> int {
+                   return CommandComplete(ctx, cp);
+                 }));
+
   cp.Add(Command("help", "shows this help",
                  [&cp](const worklog::CommandContext& ctx) -> int {
                    cp.PrintHelp();
@@ -520,14 +1561,6 @@ int ParseAndExecute(const std::vector<std::string>& args) {
 }
 
 int main(int argc, char** argv) {
-  if (getenv("EDITOR") == nullptr) {
-    std::cerr << "Error: Please set the environment variable "
-              << "$EDITOR to your favourite editor (ie. vim). "
-              << "(the value is currently empty!)\n";
-
-    return -1;
-  }
-  
   std::vector<std::string> args(argv, argv + argc);
   return ParseAndExecute(args);
 }